@@ -21,6 +21,7 @@
 
 #include "trackProj.h"
 #include "GrbTrack.h"
+#include "ObfPerfMonitor.h"
 #include "OnboardFilterTds/FilterStatus.h"
 #include "OnboardFilterTds/Obf_TFC_prjs.h"
 
@@ -75,6 +76,9 @@ public:
     // This defines the method called for end of event processing
     virtual void eoeProcessing(EDS_fwIxb* ixb);
 
+    // Events without calorimeter data get no logs, without unpacking
+    virtual void eoeBypassed(EDS_fwIxb* ixb);
+
     // This for end of run processing
     virtual void eorProcessing();
 
@@ -85,10 +89,24 @@ private:
 
     //****** This section for defining JO parameters
     // This is somewhat useless but if set will be passed to the CDM utility to print info
+    /// If set, time the unpack and log loop and report per call numbers at end of run
+    BooleanProperty   m_timeKernels;
+    /// If set, only run for events OnboardFilter accepts (when it rejects events)
+    BooleanProperty   m_acceptedOnly;
+    /// Only run for a 1 in N subset of the events (see ObfSampler.h)
+    IntegerProperty   m_sampleRate;
+    /// If set, events without calorimeter data skip the unpack and log loop
+    BooleanProperty   m_routeByClass;
 
     //****** This section contains various useful member variables
     /// Pointer to the Gaudi data provider service
     IDataProviderSvc* m_dataSvc;
+
+    // Kernel timing when TimeKernels is set
+    ObfKernelStats    m_calUnpackStats;
+    ObfKernelStats    m_logLoopStats;
+
+    unsigned long long m_nBypassed;
 };
 
 //static ToolFactory<CalOutputTool> s_factory;
@@ -99,13 +117,20 @@ DECLARE_TOOL_FACTORY(CalOutputTool);
 CalOutputTool::CalOutputTool(const std::string& type, 
                                  const std::string& name, 
                                  const IInterface* parent) :
-                                 AlgTool(type, name, parent)
+                                 AlgTool(type, name, parent),
+                                 m_calUnpackStats("EDR_calUnpack"),
+                                 m_logLoopStats("CalOutputTool log loop"),
+                                 m_nBypassed(0)
 {
     //Declare the additional interface
     declareInterface<IFilterTool>(this);
 
     // declare properties with setProperties calls
     //declareProperty("FillTowerHits",   m_towerHits = true);
+    declareProperty("TimeKernels",     m_timeKernels = false);
+    declareProperty("AcceptedEventsOnly", m_acceptedOnly = true);
+    declareProperty("SampleRate",      m_sampleRate = 1);
+    declareProperty("RouteByEventClass", m_routeByClass = true);
 
     return;
 }
@@ -135,7 +160,9 @@ StatusCode CalOutputTool::initialize()
         ObfInterface* obf = ObfInterface::instance();
 
         // Register this as an output routine
-        obf->setEovOutputCallBack(this);
+        obf->setEovOutputCallBack(this, m_acceptedOnly.value());
+        obf->setSampleRate(this, name(), m_sampleRate.value());
+        if (m_routeByClass) obf->setEventClassNeeds(this, ObfInterface::CalEvent);
     }
     catch(ObfInterface::ObfException& obfException)
     {
@@ -178,11 +205,15 @@ void CalOutputTool::eoeProcessing(EDS_fwIxb* ixb)
     const  ECR_cal *constants = evt->calCal;
     EDR_cal        *cal       = evt->cal;
 
+    if (m_timeKernels) m_calUnpackStats.start();
     EDR_calUnpack (cal, dir, evt->calCal);
+    if (m_timeKernels) m_calUnpackStats.stop();
 
     // A place for data
     LogInfo logData[16*8*12];    // 16 towers * 8 layers * 12 logs
 
+    if (m_timeKernels) m_logLoopStats.start();
+
     int twrMap     = EDR_CAL_TWRMAP_JUSTIFY (cal->twrMap);
     int numLogsHit = 0;
 
@@ -262,16 +293,45 @@ void CalOutputTool::eoeProcessing(EDS_fwIxb* ixb)
         }
     }
 
+    if (m_timeKernels) m_logLoopStats.stop();
+
     // Fill in to the TDS output object
     filterStatus->setLogData(numLogsHit, logData);
 
     return;
 }
 
+void CalOutputTool::eoeBypassed(EDS_fwIxb* ixb)
+{
+    SmartDataPtr<OnboardFilterTds::FilterStatus> filterStatus(m_dataSvc,"/Event/Filter/FilterStatus");
+
+    if (!filterStatus)
+    {
+        throw std::runtime_error("CalOutputTool cannot find FilterStatus in the TDS");
+    }
+
+    m_nBypassed++;
+
+    LogInfo logData[1];
+
+    filterStatus->setLogData(0, logData);
+
+    return;
+}
+
 // This for end of run processing
 void CalOutputTool::eorProcessing()
 {
     MsgStream log(msgSvc(), name());
 
+    if (m_nBypassed) log << MSG::INFO << m_nBypassed << " events without calorimeter data bypassed" << endreq;
+
+    if (m_timeKernels)
+    {
+        log << MSG::INFO << "Kernel timing over " << m_logLoopStats.getCalls() << " events" << endreq;
+        log << MSG::INFO << m_calUnpackStats.summary(m_calUnpackStats.getCalls()) << endreq;
+        log << MSG::INFO << m_logLoopStats.summary(m_logLoopStats.getCalls())     << endreq;
+    }
+
     return;
 }
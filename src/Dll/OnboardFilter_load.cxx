@@ -21,4 +21,7 @@ DECLARE_FACTORY_ENTRIES(OnboardFilter) {
     DECLARE_TOOL(TkrOutputTool);
     DECLARE_TOOL(CalOutputTool);
     DECLARE_TOOL(GemOutputTool);
+    DECLARE_ALGORITHM(SyntheticEbfAlg);
+    DECLARE_ALGORITHM(ObfReleaseCompareAlg);
+    DECLARE_ALGORITHM(ObfBatchFilterAlg);
 } 
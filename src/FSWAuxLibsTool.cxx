@@ -130,12 +130,19 @@ StatusCode FSWAuxLibsTool::initialize()
         std::string calPedFile = m_FileName_Pedestals;
         std::string calPedPath = m_PathName_Pedestals;         // + "/" + calPedFile;
 
+        std::string calGainFile = m_FileName_Gains;
+        std::string calGainPath = m_PathName_Gains;            // + "/" + calGainFile;
+
+        // Read all three in parallel, they are then loaded one by one below
+        std::vector<std::pair<std::string, std::string> > libraries;
+        libraries.push_back(std::make_pair(calPedFile,    calPedPath));
+        libraries.push_back(std::make_pair(calGainFile,   calGainPath));
+        libraries.push_back(std::make_pair(std::string("geo_db_data"), std::string("$(OBFGGF_DBBINDIR)/geo_db_data")));
+        obf->prefetchLibraries(libraries);
+
         log << MSG::INFO << "Loading CAL pedestal file: " << calPedFile << ", path: " << calPedPath << endreq;
 
         obf->loadLibrary(calPedFile, calPedPath);
-    
-        std::string calGainFile = m_FileName_Gains;
-        std::string calGainPath = m_PathName_Gains;            // + "/" + calGainFile;
 
         log << MSG::INFO << "Loading CAL gain file: " << calGainFile << ", path: " << calGainPath << endreq;
 
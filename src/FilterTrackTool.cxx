@@ -20,6 +20,7 @@
 
 // Interface to EDS package here
 #include "ObfInterface.h"
+#include "ObfPerfMonitor.h"
 
 // FSW includes go here
 #include "EFC/EFC_edsFw.h"
@@ -111,6 +112,9 @@ public:
     // This defines the method called for end of event processing
     virtual void eoeProcessing(EDS_fwIxb* ixb);
 
+    // Events without tracker data only get an empty track
+    virtual void eoeBypassed(EDS_fwIxb* ixb);
+
     // This for end of run processing
     virtual void eorProcessing();
 
@@ -158,6 +162,14 @@ private:
     //****** This section for defining JO parameters
     // This is somewhat useless but if set will be passed to the CDM utility to print info
     //BooleanProperty   m_towerHits;
+    /// If set, time the projection kernels and report per call numbers at end of run
+    BooleanProperty   m_timeKernels;
+    /// If set, only run for events OnboardFilter accepts (when it rejects events)
+    BooleanProperty   m_acceptedOnly;
+    /// Only run for a 1 in N subset of the events (see ObfSampler.h)
+    IntegerProperty   m_sampleRate;
+    /// If set, events without tracker data skip the projection classification
+    BooleanProperty   m_routeByClass;
 
     // Local geometry variables
     unsigned int      m_strip_pitch;  /*!< Tracker strip pitch, in mm            */
@@ -170,6 +182,12 @@ private:
 
     // Geometry database from FSW
     const TFC_geometryTkr* m_tkrGeo;
+
+    // Kernel timing when TimeKernels is set
+    unsigned long long m_nEvents;
+    unsigned long long m_nBypassed;
+    ObfKernelStats     m_classifyStats;
+    ObfKernelStats     m_prjsSelectStats;
 };
 
 //static ToolFactory<FilterTrackTool> s_factory;
@@ -180,13 +198,21 @@ DECLARE_TOOL_FACTORY(FilterTrackTool);
 FilterTrackTool::FilterTrackTool(const std::string& type, 
                                  const std::string& name, 
                                  const IInterface* parent) :
-                                 AlgTool(type, name, parent)
+                                 AlgTool(type, name, parent),
+                                 m_nEvents(0),
+                                 m_nBypassed(0),
+                                 m_classifyStats("projections_classify"),
+                                 m_prjsSelectStats("prjsSelect")
 {
     //Declare the additional interface
     declareInterface<IFilterTool>(this);
 
     // declare properties with setProperties calls
     //declareProperty("FillTowerHits",   m_towerHits = true);
+    declareProperty("TimeKernels",     m_timeKernels = false);
+    declareProperty("AcceptedEventsOnly", m_acceptedOnly = true);
+    declareProperty("SampleRate",      m_sampleRate = 1);
+    declareProperty("RouteByEventClass", m_routeByClass = true);
 
     m_strip_pitch = 228; // From TKR_STRIP_PITCH = TKR_STRIP_PITCH_MM * 1000 + 0.5
     m_dz_scale    = 2 * 2048;
@@ -234,7 +260,9 @@ StatusCode FilterTrackTool::initialize()
         m_tkrGeo = &geom->tkr;
 
         // Register this as an output routine
-        obf->setEovOutputCallBack(this);
+        obf->setEovOutputCallBack(this, m_acceptedOnly.value());
+        obf->setSampleRate(this, name(), m_sampleRate.value());
+        if (m_routeByClass) obf->setEventClassNeeds(this, ObfInterface::TkrEvent);
     }
     catch(ObfInterface::ObfException& obfException)
     {
@@ -270,6 +298,8 @@ void FilterTrackTool::eoeProcessing(EDS_fwIxb* ixb)
     // Get the projections 
     TFC_prjs *projections = (TFC_prjs *)ixb->blk.ptrs[EFC_EDS_FW_OBJ_K_TFC_PRJS];
 
+    m_nEvents++;
+
     // use the trackProj class to do the real work here... but only if data...
     if (projections->curCnt > 0) 
     {
@@ -277,7 +307,9 @@ void FilterTrackTool::eoeProcessing(EDS_fwIxb* ixb)
         // The following code was modelled on that in the function grb_process which
         // can be found in the GRBP_server.c module in the GRBP package. 
         //
+        if (m_timeKernels) m_classifyStats.start();
         unsigned int   topLayerMask = projections_classify (projections); //, dir, tkr);
+        if (m_timeKernels) m_classifyStats.stop();
 
         if ( (topLayerMask & 0xffff0000) & (topLayerMask << 16) )
         {
@@ -290,9 +322,11 @@ void FilterTrackTool::eoeProcessing(EDS_fwIxb* ixb)
             */
         
             /* Find the X best projections */
+            if (m_timeKernels) m_prjsSelectStats.start();
             prjsSelect (&grbp_prjs[0], 
                         topLayerMask & 0xffff0000, 
                         projections->top[0]);        
+            if (m_timeKernels) m_prjsSelectStats.stop();
 
             int nx  = grbp_prjs[0].cnt;
             int dxi = dcos_prepare (grbp_prjs[0].prjs, nx, m_dxy_scale);
@@ -310,9 +344,11 @@ void FilterTrackTool::eoeProcessing(EDS_fwIxb* ixb)
             float zx   = point.z();
 
             /* Find the Y best projections */
+            if (m_timeKernels) m_prjsSelectStats.start();
             prjsSelect (&grbp_prjs[1],
                         topLayerMask <<  16, 
                         projections->top[1]);
+            if (m_timeKernels) m_prjsSelectStats.stop();
             int ny  = grbp_prjs[1].cnt;
             int dyi = dcos_prepare (grbp_prjs[1].prjs, ny, m_dxy_scale);
             int dzi = m_dz_scale;
@@ -341,11 +377,29 @@ void FilterTrackTool::eoeProcessing(EDS_fwIxb* ixb)
     return;
 }
 
+void FilterTrackTool::eoeBypassed(EDS_fwIxb* ixb)
+{
+    m_dataSvc->registerObject("/Event/Filter/ObfFilterTrack", new OnboardFilterTds::ObfFilterTrack());
+
+    m_nBypassed++;
+
+    return;
+}
+
 // This for end of run processing
 void FilterTrackTool::eorProcessing()
 {
     MsgStream log(msgSvc(), name());
 
+    if (m_nBypassed) log << MSG::INFO << m_nBypassed << " events without tracker data bypassed" << endreq;
+
+    if (m_timeKernels)
+    {
+        log << MSG::INFO << "Kernel timing over " << m_nEvents << " events" << endreq;
+        log << MSG::INFO << m_classifyStats.summary(m_nEvents)   << endreq;
+        log << MSG::INFO << m_prjsSelectStats.summary(m_nEvents) << endreq;
+    }
+
     return;
 }
 
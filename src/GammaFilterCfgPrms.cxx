@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
 
 #include "GammaFilterCfgPrms.h"
 
@@ -25,8 +26,8 @@ void GammaFilterCfgPrms::setCfgPrms(void* cfgPrms)
     
     if (m_Acd_TopSideEmax       != 0xFFFFFFFF) prms->prms.acd.topSideEmax       = m_Acd_TopSideEmax;
     if (m_Acd_TopSideFilterEmax != 0xFFFFFFFF) prms->prms.acd.topSideFilterEmax = m_Acd_TopSideFilterEmax;
-    if (m_Acd_SplashEmax        != 0xFFFFFFFF) prms->prms.acd.splashEmax        = m_Acd_TopSideFilterEmax;
-    if (m_Acd_SplashCount       != 0xFFFFFFFF) prms->prms.acd.splashCount       = m_Acd_TopSideFilterEmax;
+    if (m_Acd_SplashEmax        != 0xFFFFFFFF) prms->prms.acd.splashEmax        = m_Acd_SplashEmax;
+    if (m_Acd_SplashCount       != 0xFFFFFFFF) prms->prms.acd.splashCount       = m_Acd_SplashCount;
 
     if (m_Atf_Emax              != 0xFFFFFFFF) prms->prms.atf.emax              = m_Atf_Emax;
 
@@ -45,3 +46,44 @@ void GammaFilterCfgPrms::setCfgPrms(void* cfgPrms)
     if (m_Tkr_TwoTkrEmax        != 0xFFFFFFFF)   prms->prms.tkr.twoTkrEmax      = m_Tkr_TwoTkrEmax;
     if (m_Tkr_SkirtEmax         != 0xFFFFFFFF)   prms->prms.tkr.skirtEmax       = m_Tkr_SkirtEmax;
 }
+
+void* GammaFilterCfgPrms::cloneCfgPrms(void* cfgPrms)
+{
+    GFC*     gfc  = (GFC*)cfgPrms;
+    GFC_cfg* copy = (GFC_cfg*)malloc(sizeof(GFC_cfg));
+
+    memcpy(copy, gfc->cfg, sizeof(GFC_cfg));
+
+    gfc->cfg = copy;
+
+    return copy;
+}
+
+void GammaFilterCfgPrms::useCfgPrms(void* cfgPrms, void* cfg)
+{
+    ((GFC*)cfgPrms)->cfg = (GFC_cfg*)cfg;
+}
+
+bool GammaFilterCfgPrms::setParameter(const std::string& name, unsigned int prm)
+{
+    if      (name == "Acd_TopSideEmax")       set_Acd_TopSideEmax(prm);
+    else if (name == "Acd_TopSideFilterEmax") set_Acd_TopSideFilterEmax(prm);
+    else if (name == "Acd_SplashEmax")        set_Acd_SplashEmax(prm);
+    else if (name == "Acd_SplashCount")       set_Acd_SplashCount(prm);
+    else if (name == "Atf_Emax")              set_Atf_Emax(prm);
+    else if (name == "Zbottom_Emin")          set_Zbottom_Emin(prm);
+    else if (name == "Cal_Epass")             set_Cal_Epass(prm);
+    else if (name == "Cal_Emin")              set_Cal_Emin(prm);
+    else if (name == "Cal_Emax")              set_Cal_Emax(prm);
+    else if (name == "Cal_Layer0RatioLo")     set_Cal_Layer0RatioLo(prm);
+    else if (name == "Cal_Layer0RatioHi")     set_Cal_Layer0RatioHi(prm);
+    else if (name == "Tkr_Row2Emax")          set_Tkr_Row2Emax(prm);
+    else if (name == "Tkr_Row01Emax")         set_Tkr_Row01Emax(prm);
+    else if (name == "Tkr_TopEmax")           set_Tkr_TopEmax(prm);
+    else if (name == "Tkr_ZeroTkrEmin")       set_Tkr_ZeroTkrEmin(prm);
+    else if (name == "Tkr_TwoTkrEmax")        set_Tkr_TwoTkrEmax(prm);
+    else if (name == "Tkr_SkirtEmax")         set_Tkr_SkirtEmax(prm);
+    else return false;
+
+    return true;
+}
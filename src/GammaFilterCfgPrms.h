@@ -14,6 +14,8 @@
 
 #include "IFilterCfgPrms.h"
 
+#include <string>
+
 class GammaFilterCfgPrms : virtual public IFilterCfgPrms
 {
 public:
@@ -32,17 +34,29 @@ public:
                           , m_Tkr_Row01Emax(0xFFFFFFFF)
                           , m_Tkr_TopEmax(0xFFFFFFFF)
                           , m_Tkr_ZeroTkrEmin(0xFFFFFFFF)
-                          , m_Tkr_TwoTkrEmax(0xFFFFFFFF) {}
+                          , m_Tkr_TwoTkrEmax(0xFFFFFFFF)
+                          , m_Tkr_SkirtEmax(0xFFFFFFFF) {}
     virtual ~GammaFilterCfgPrms() {}
 
     // This defines the method called for end of event processing
     virtual void setCfgPrms(void* cfgPrms);
 
+    // Give a filter parameter block its own private copy of the GFC_cfg it points to, so 
+    // that setCfgPrms will not modify the configuration shared with other filter contexts.
+    // Returns the copy, which the caller must free once the context is released or reselected
+    void* cloneCfgPrms(void* cfgPrms);
+
+    // Point a filter parameter block at a GFC_cfg made earlier by cloneCfgPrms
+    static void useCfgPrms(void* cfgPrms, void* cfg);
+
+    // Set a parameter by name (e.g. "Cal_Epass"), returns false if the name is not known
+    bool setParameter(const std::string& name, unsigned int prm);
+
     // Set the parameters (done via job options file)
     void set_Acd_TopSideEmax       (unsigned int prm) {m_Acd_TopSideEmax       = prm;}
     void set_Acd_TopSideFilterEmax (unsigned int prm) {m_Acd_TopSideFilterEmax = prm;}
-    void set_Acd_SplashEmax        (unsigned int prm) {m_Acd_TopSideFilterEmax = prm;}
-    void set_Acd_SplashCount       (unsigned int prm) {m_Acd_TopSideFilterEmax = prm;}
+    void set_Acd_SplashEmax        (unsigned int prm) {m_Acd_SplashEmax        = prm;}
+    void set_Acd_SplashCount       (unsigned int prm) {m_Acd_SplashCount       = prm;}
     void set_Atf_Emax              (unsigned int prm) {m_Atf_Emax              = prm;}
     void set_Zbottom_Emin          (unsigned int prm) {m_Zbottom_Emin          = prm;}
     void set_Cal_Epass             (unsigned int prm) {m_Cal_Epass             = prm;}
@@ -81,4 +95,4 @@ private:
     unsigned int m_Tkr_SkirtEmax;
 };
 
-#endif // __ObfInterface_H
+#endif // __GammaCfgPrms_H
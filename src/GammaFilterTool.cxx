@@ -24,6 +24,8 @@
 
 // Interface to EDS package here
 #include "ObfInterface.h"
+#include "ObfWarmStart.h"
+#include "ObfMootConfigCache.h"
 #include "GammaFilterCfgPrms.h"
 
 // FSW includes go here
@@ -63,6 +65,9 @@
 #include <map>
 #include <stdexcept>
 #include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <iomanip>
 
 /** @class GammaFilterTool
     @brief Manages the Gamma Filter
@@ -101,6 +106,18 @@ private:
     // Private function to load FSW libraries
     bool loadLibrary (std::string libraryName, std::string libraryPath="", int verbosity=0);
 
+    // Work out ahead of time everything each mode needs, so that setMode only selects
+    void prepareModes();
+
+    // Emulate the veto after the fact when running all stages
+    void applyVetoMask(unsigned int& statusWord, unsigned char& sb);
+
+    // Set up the shadow filters for the parameter sweep
+    StatusCode setupSweep(const EFC_DB_Schema& master);
+
+    // Set the mode of the shadow filters, with each sweep point's parameters
+    void setSweepMode(unsigned int mode);
+
     //****** This section for defining JO parameters
     // This is somewhat useless but if set will be passed to the CDM utility to print info
     IntegerProperty   m_verbosity;
@@ -108,6 +125,9 @@ private:
     // Which filter configuration to run
     StringProperty    m_configToRun;
 
+    // Run on 1 in this many events (see ObfSampler.h)
+    IntegerProperty   m_sampleRate;
+
     // Configuring the Gamma Filter
     unsigned int      m_gamBitsToIgnore; // This sets a mask of gamma filter veto bits to ignore
     bool              m_runAllStages;    // Run all stages of filter for diagnostics...
@@ -143,6 +163,31 @@ private:
     unsigned int      m_Tkr_TwoTkrEmax;
     unsigned int      m_Tkr_SkirtEmax;
 
+    // Parameter sweep, each entry is a list of Name=value pairs applied to one shadow filter
+    StringArrayProperty m_sweepConfigs;
+    StringProperty      m_sweepOutputFile;
+
+    // Sweep points, one shadow filter each
+    std::vector<GammaFilterCfgPrms> m_sweepPrms;
+    std::vector<int>                m_sweepIdx;      // Shadow filter index
+    std::vector<void*>              m_sweepCfgs;     // Private GFC_cfg copy for each shadow and mode
+    std::vector<int>                m_sweepPassed;   // Number of events passed by each sweep point
+    int                             m_sweepEvents;
+    int                             m_primaryPassed;
+    std::ofstream                   m_sweepFile;
+
+    // Configuration associated with each mode
+    unsigned int      m_modeToConfig[EFC_DB_MODE_K_CNT];
+
+    // Sampler settings for each mode, from prepareModes
+    unsigned int      m_modeEnabled[EFC_DB_MODE_K_CNT];  // Enabled classes to run with
+    unsigned int      m_modeVetoMask[EFC_DB_MODE_K_CNT]; // Veto mask the filter wanted to use
+
+    // Target mask, parameter block and sampler of the filter, looked up once
+    unsigned int      m_target;
+    void*             m_filterPrm;
+    EFC_sampler*      m_sampler;
+
     // Filter ID returned from EDS_fw after initialization
     int               m_handlerId;
 
@@ -175,6 +220,11 @@ GammaFilterTool::GammaFilterTool(const std::string& type,
                                  AlgTool(type, name, parent)
                                , m_filterVetoMask(0)
                                , m_gamBitsOriginal(0)
+                               , m_sweepEvents(0)
+                               , m_primaryPassed(0)
+                               , m_target(0)
+                               , m_filterPrm(0)
+                               , m_sampler(0)
                                , m_curConfig(0)
                                , m_curMode(EFC_DB_MODE_K_NORMAL)
                                , m_filterLibs(0)
@@ -225,16 +275,33 @@ GammaFilterTool::GammaFilterTool(const std::string& type,
     declareProperty("Tkr_TwoTkrEmax",        m_Tkr_TwoTkrEmax        = 0xFFFFFFFF);
     declareProperty("Tkr_SkirtEmax",         m_Tkr_SkirtEmax         = 0xFFFFFFFF);
 
+    // Parameter: SweepConfigs
+    // Runs each event through an extra copy of the filter per entry, with the listed parameters
+    // changed, e.g. "Cal_Epass=1000, Tkr_SkirtEmax=50". Values may be given in hex (0x...)
+    declareProperty("SweepConfigs",          m_sweepConfigs);
+    // Parameter: SweepOutputFile
+    // If set, one line per event with the status word of the filter and of each sweep point
+    declareProperty("SweepOutputFile",       m_sweepOutputFile       = "");
+    // Parameter: SampleRate
+    // Run the filter on a 1 in N subset of the events only, for when it is not active
+    declareProperty("SampleRate",            m_sampleRate            = 1);
+
     declareProperty("verbosity",             m_verbosity             = 0);
 
     // zero our counters
     memset(m_statusBits, 0, 32*sizeof(int));    
+    memset(m_modeToConfig, 0, EFC_DB_MODE_K_CNT*sizeof(unsigned int));
+    memset(m_modeEnabled,  0, EFC_DB_MODE_K_CNT*sizeof(unsigned int));
+    memset(m_modeVetoMask, 0, EFC_DB_MODE_K_CNT*sizeof(unsigned int));
 
     return;
 }
 //------------------------------------------------------------------------
 GammaFilterTool::~GammaFilterTool()
 {
+    // The shadow filters themselves are released by ObfInterface
+    for(std::vector<void*>::iterator cfgIter = m_sweepCfgs.begin(); cfgIter != m_sweepCfgs.end(); cfgIter++)
+        free(*cfgIter);
 }
 
 StatusCode GammaFilterTool::initialize()
@@ -324,26 +391,26 @@ StatusCode GammaFilterTool::initialize()
         // Bit mask for this filter
         unsigned int target = obf->getFilterTargetMask(master.filter.id);
 
+        m_target    = target;
+        m_filterPrm = obf->getFilterPrm(master.filter.id, EFC_OBJECT_K_FILTER_PRM);
+        m_sampler   = (EFC_sampler*)obf->getFilterPrm(master.filter.id, EFC_OBJECT_K_SAMPLER);
+
         // Are we using moot and is this an active filter?
         bool activeFilter = false;
 
+        // A warm start already has the configurations Moot gave each mode
+        const std::vector<int>* warmConfigs = 0;
+        if (m_mootSvc && obf->warmStart()) warmConfigs = obf->warmStart()->modeConfigs(m_filterLibs->FilterSchema());
+
         // If we have moot we need to get the list of active filters and see if we are one of them
-        if (m_mootSvc)
+        if (m_mootSvc && !warmConfigs)
         {
-            std::vector<CalibData::MootFilterCfg> filterCfgVec;
-            unsigned int filterCnt = m_mootSvc->getActiveFilters(filterCfgVec);
-            
-            // Loop through the returned list of active filters
-            for(std::vector<CalibData::MootFilterCfg>::const_iterator filterIter = filterCfgVec.begin();
-                filterIter != filterCfgVec.end(); filterIter++)
+            const ObfMootConfigCache::ActiveFilter* mootFilter = ObfMootConfigCache::instance()->findActive(m_mootSvc, m_filterLibs->FilterSchema());
+
+            if (mootFilter)
             {
-                // Are we active?
-                if (filterIter->getSchemaId() == m_filterLibs->FilterSchema())
-                {
-                    activeFilter = true;
-                    log << MSG::INFO << "Moot has filter " <<  filterIter->getName() << " as active" << endreq;
-                    break;
-                }
+                activeFilter = true;
+                log << MSG::INFO << "Moot has filter " <<  mootFilter->m_name << " as active" << endreq;
             }
         }
 
@@ -353,31 +420,47 @@ StatusCode GammaFilterTool::initialize()
             // Default is the configuration from the master configuration file
             unsigned int configuration = m_filterLibs->getMasterConfiguration().filter.mode2cfg[modeIdx];
 
+            // Use the warm start if we have one
+            if (warmConfigs && modeIdx < (int)warmConfigs->size() && (*warmConfigs)[modeIdx] >= 0)
+            {
+                configuration = (*warmConfigs)[modeIdx];
+            }
             // If MootSvc configured and filter is active then attempt to retrieve the information from moot
-            if (activeFilter)
+            else if (activeFilter)
             {
-                std::string filterName = "";
-                CalibData::MootFilterCfg* mootCfg = m_mootSvc->getActiveFilter(modeIdx, m_handlerId, filterName);
+                const ObfMootConfigCache::ModeConfig& mootCfg = ObfMootConfigCache::instance()->modeConfig(m_mootSvc, m_handlerId, modeIdx);
 
                 // Returned configuration for this handler and mode 
-                if (mootCfg)
+                if (mootCfg.m_instanceId >= 0)
                 {
-                    configuration = mootCfg->getInstanceId();
-                    log << MSG::INFO << "Moot: mode " << modeIdx << " associated with configuration:\n" << mootCfg->getSrcPath() << endreq;
+                    configuration = mootCfg.m_instanceId;
+                    log << MSG::INFO << "Moot: mode " << modeIdx << " associated with configuration:\n" << mootCfg.m_srcPath << endreq;
                 }
             }
 
             obf->associateConfigToMode(target, modeIdx, configuration);
+
+            m_modeToConfig[modeIdx] = configuration;
         }
 
         // Enable the filter
         obf->enableDisableFilter(target, target);
 
+        // Set up any parameter sweep
+        if (setupSweep(master).isFailure()) return StatusCode::FAILURE;
+
+        // Patch the configuration and work out the sampler settings of every mode
+        prepareModes();
+
         // Use set mode to do the rest here
         setMode(m_curMode);
 
         // Set the Gamma Filter output routine
         obf->setEovOutputCallBack(this);
+        obf->setSampleRate(this, name(), m_sampleRate.value(), m_target);
+
+        // We change the veto bits before they reach the TDS
+        if (m_runAllStages || m_gamBitsToIgnore) obf->setResultAdjusted(master.filter.id);
     }
     catch(ObfInterface::ObfException& obfException)
     {
@@ -391,6 +474,8 @@ StatusCode GammaFilterTool::initialize()
 StatusCode GammaFilterTool::finalize ()
 {
     StatusCode  status = StatusCode::SUCCESS;
+
+    if (m_sweepFile.is_open()) m_sweepFile.close();
     
     return status;
 }
@@ -401,80 +486,199 @@ void GammaFilterTool::setMode(unsigned int mode)
     // Output what we are doing...
     MsgStream log(msgSvc(), name());
 
-    std::string modeDesc[] = {"EFC_DB_MODE_K_NORMAL",
-                              "EFC_DB_MODE_K_TOO",
-                              "EFC_DB_MODE_K_ARR",
-                              "EFC_DB_MODE_K_RSVD3",
-                              "EFC_DB_MODE_K_RSVD4",
-                              "EFC_DB_MODE_K_RSVD5",
-                              "EFC_DB_MODE_K_RSVD6",
-                              "EFC_DB_MODE_K_RSVD7" };
+    static const char* modeDesc[] = {"EFC_DB_MODE_K_NORMAL",
+                                     "EFC_DB_MODE_K_TOO",
+                                     "EFC_DB_MODE_K_ARR",
+                                     "EFC_DB_MODE_K_RSVD3",
+                                     "EFC_DB_MODE_K_RSVD4",
+                                     "EFC_DB_MODE_K_RSVD5",
+                                     "EFC_DB_MODE_K_RSVD6",
+                                     "EFC_DB_MODE_K_RSVD7" };
 
     log << MSG::INFO << "Received request to change mode from " << modeDesc[m_curMode] << " to " << modeDesc[mode] << endreq;
 
-    // Get ObfInterface pointer
-    ObfInterface* obf = ObfInterface::instance();
+    // Set the mode to run, its configuration was already patched by prepareModes
+    ObfInterface::instance()->selectFiltermode(m_target, mode);
+
+    // If we are disabling vetoes, or if we are trying to run all stages of filter, then modify here
+    if (m_sampler && (m_runAllStages || m_gamBitsToIgnore)) m_sampler->classes.enabled.all = m_modeEnabled[mode];
+
+    // If running all stages we'll need the veto mask to apply it in the end
+    if (m_runAllStages) m_filterVetoMask = m_modeVetoMask[mode];
 
-    // Schema id
-    unsigned short int masterId = m_filterLibs->getMasterConfiguration().filter.id;
+    // Bring the sweep along
+    setSweepMode(mode);
+
+    // And, of course, reset the mode
+    m_curMode = mode;
 
-    // Bit mask for this filter
-    unsigned int target = obf->getFilterTargetMask(masterId);
+    return;
+}
 
-    // Set the default mode to run
-    obf->selectFiltermode(target, mode);
+void GammaFilterTool::prepareModes()
+{
+    ObfInterface* obf = ObfInterface::instance();
 
     // Set up the object allowing one to change gamma filter parameters
     // But only if running outside of Moot
-    if (!m_mootSvc)
+    GammaFilterCfgPrms gamParms;
+    gamParms.set_Acd_TopSideEmax(m_Acd_TopSideEmax);
+    gamParms.set_Acd_TopSideFilterEmax(m_Acd_TopSideFilterEmax);
+    gamParms.set_Acd_SplashEmax(m_Acd_SplashEmax);
+    gamParms.set_Acd_SplashCount(m_Acd_SplashCount);
+    gamParms.set_Atf_Emax(m_Atf_Emax);
+    gamParms.set_Zbottom_Emin(m_Zbottom_Emin);
+    gamParms.set_Cal_Epass(m_Cal_Epass);
+    gamParms.set_Cal_Emin(m_Cal_Emin);
+    gamParms.set_Cal_Emax(m_Cal_Emax);
+    gamParms.set_Cal_Layer0RatioLo(m_Cal_Layer0RatioLo);
+    gamParms.set_Cal_Layer0RatioHi(m_Cal_Layer0RatioHi);
+    gamParms.set_Tkr_Row2Emax(m_Tkr_Row2Emax);
+    gamParms.set_Tkr_Row01Emax(m_Tkr_Row01Emax);
+    gamParms.set_Tkr_TopEmax(m_Tkr_TopEmax);
+    gamParms.set_Tkr_ZeroTkrEmin(m_Tkr_ZeroTkrEmin);
+    gamParms.set_Tkr_TwoTkrEmax(m_Tkr_TwoTkrEmax);
+    gamParms.set_Tkr_SkirtEmax(m_Tkr_SkirtEmax);
+
+    for(unsigned int mode = 0; mode < EFC_DB_MODE_K_CNT; mode++)
     {
-        GammaFilterCfgPrms gamParms;
-        gamParms.set_Acd_TopSideEmax(m_Acd_TopSideEmax);
-        gamParms.set_Acd_TopSideFilterEmax(m_Acd_TopSideFilterEmax);
-        gamParms.set_Acd_SplashEmax(m_Acd_TopSideFilterEmax);
-        gamParms.set_Acd_SplashCount(m_Acd_TopSideFilterEmax);
-        gamParms.set_Atf_Emax(m_Atf_Emax);
-        gamParms.set_Zbottom_Emin(m_Zbottom_Emin);
-        gamParms.set_Cal_Epass(m_Cal_Epass);
-        gamParms.set_Cal_Emin(m_Cal_Emin);
-        gamParms.set_Cal_Emax(m_Cal_Emax);
-        gamParms.set_Cal_Layer0RatioLo(m_Cal_Layer0RatioLo);
-        gamParms.set_Cal_Layer0RatioHi(m_Cal_Layer0RatioHi);
-        gamParms.set_Tkr_Row2Emax(m_Tkr_Row2Emax);
-        gamParms.set_Tkr_Row01Emax(m_Tkr_Row01Emax);
-        gamParms.set_Tkr_TopEmax(m_Tkr_TopEmax);
-        gamParms.set_Tkr_ZeroTkrEmin(m_Tkr_ZeroTkrEmin);
-        gamParms.set_Tkr_TwoTkrEmax(m_Tkr_TwoTkrEmax);
-        gamParms.set_Tkr_SkirtEmax(m_Tkr_SkirtEmax);
-
-        // Get the Gamma Filter parameter block
-        void* gammaCfgPrms = obf->getFilterPrm(masterId, EFC_OBJECT_K_FILTER_PRM);
+        obf->selectFiltermode(m_target, mode);
 
         // This will modify any configuration parameters that are not 0xFFFFFFFF
-        gamParms.setCfgPrms(gammaCfgPrms);
+        // (modes sharing a configuration simply get the same values again)
+        if (!m_mootSvc && m_filterPrm) gamParms.setCfgPrms(m_filterPrm);
+
+        // What the filter wants to use as a veto mask, and the classes to run with
+        if (m_sampler)
+        {
+            m_modeVetoMask[mode] = m_sampler->classes.enabled.vetoes;
+            m_modeEnabled[mode]  = m_sampler->classes.enabled.all;
+
+            // If running all stages set the filter's veto mask to zero so it won't reject events
+            if      (m_runAllStages)    m_modeEnabled[mode] &= ~m_modeVetoMask[mode];
+            // Otherwise, modify the bits to ignore in the filter's veto mask
+            else if (m_gamBitsToIgnore) m_modeEnabled[mode] &= ~m_gamBitsToIgnore;
+        }
+
+        // Each sweep point gets a private copy of this mode's configuration with its own parameters
+        for(unsigned int idx = 0; idx < m_sweepIdx.size(); idx++)
+        {
+            obf->selectShadowFilterMode(m_sweepIdx[idx], mode, m_modeToConfig[mode]);
+
+            void* gammaCfgPrms = obf->getShadowFilterPrm(m_sweepIdx[idx], EFC_OBJECT_K_FILTER_PRM);
+
+            m_sweepCfgs[idx * EFC_DB_MODE_K_CNT + mode] = m_sweepPrms[idx].cloneCfgPrms(gammaCfgPrms);
+
+            m_sweepPrms[idx].setCfgPrms(gammaCfgPrms);
+        }
     }
 
-    // If we are disabling vetoes, or if we are trying to run all stages of filter, then modify here
-    if (m_runAllStages || m_gamBitsToIgnore)
+    return;
+}
+
+StatusCode GammaFilterTool::setupSweep(const EFC_DB_Schema& master)
+{
+    const std::vector<std::string>& sweepConfigs = m_sweepConfigs;
+
+    if (sweepConfigs.empty()) return StatusCode::SUCCESS;
+
+    MsgStream log(msgSvc(), name());
+
+    ObfInterface* obf = ObfInterface::instance();
+
+    for(std::vector<std::string>::const_iterator sweepIter = sweepConfigs.begin(); sweepIter != sweepConfigs.end(); sweepIter++)
     {
-        // Modify the veto mask is requested (this means we are running "pass through" mode)
-        EFC_sampler* sampler = (EFC_sampler*)obf->getFilterPrm(masterId, EFC_OBJECT_K_SAMPLER);
+        GammaFilterCfgPrms gamParms;
 
-        // If running all stages of the filter then get the veto mask (since we'll need to apply it in the end)
-        if (m_runAllStages)
+        // Parse the Name=value list, entries separated by commas or blanks
+        std::string settings = *sweepIter;
+        for(std::string::iterator charIter = settings.begin(); charIter != settings.end(); charIter++)
+            if (*charIter == ',') *charIter = ' ';
+
+        std::istringstream settingStream(settings);
+        std::string        setting;
+
+        while(settingStream >> setting)
         {
-            // What did the filter want to use as a veto mask?
-            m_filterVetoMask = sampler->classes.enabled.vetoes;
+            std::string::size_type equals = setting.find('=');
+            char*                  end    = 0;
+            unsigned int           value  = 0;
+
+            if (equals != std::string::npos) value = strtoul(setting.c_str() + equals + 1, &end, 0);
 
-            // Set the filter's veto mask to zero so it won't reject events
-            sampler->classes.enabled.all &= ~m_filterVetoMask;
+            if (equals == std::string::npos || !end || *end != 0 || !gamParms.setParameter(setting.substr(0, equals), value))
+            {
+                log << MSG::ERROR << "Bad SweepConfigs setting \"" << setting << "\" in \"" << *sweepIter << "\"" << endreq;
+                return StatusCode::FAILURE;
+            }
         }
-        // Otherwise, modify the bits to ignore in the filter's veto mask
-        else sampler->classes.enabled.all &= ~m_gamBitsToIgnore;
+
+        m_sweepPrms.push_back(gamParms);
+        m_sweepIdx.push_back(obf->setupShadowFilter(&master, m_handlerId, m_curMode, m_modeToConfig[m_curMode]));
+        m_sweepCfgs.insert(m_sweepCfgs.end(), EFC_DB_MODE_K_CNT, (void*)0);
+        m_sweepPassed.push_back(0);
+
+        log << MSG::INFO << "Sweep point " << m_sweepPrms.size() - 1 << ": " << *sweepIter << endreq;
     }
 
-    // And, of course, reset the mode
-    m_curMode = mode;
+    // Output table?
+    if (m_sweepOutputFile.value() != "")
+    {
+        std::string fileName = m_sweepOutputFile.value();
+        facilities::Util::expandEnvVar(&fileName);
+
+        m_sweepFile.open(fileName.c_str());
+
+        if (!m_sweepFile.is_open())
+        {
+            log << MSG::ERROR << "Unable to open sweep output file " << fileName << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        m_sweepFile << "# Gamma Filter status words, column 0 is the filter as configured, then one per sweep point\n";
+        for(unsigned int idx = 0; idx < sweepConfigs.size(); idx++)
+            m_sweepFile << "#   " << idx + 1 << ": " << sweepConfigs[idx] << "\n";
+        m_sweepFile << "# run event status0";
+        for(unsigned int idx = 0; idx < sweepConfigs.size(); idx++) m_sweepFile << " status" << idx + 1;
+        m_sweepFile << "\n";
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+void GammaFilterTool::setSweepMode(unsigned int mode)
+{
+    ObfInterface* obf = ObfInterface::instance();
+
+    for(unsigned int idx = 0; idx < m_sweepIdx.size(); idx++)
+    {
+        // Reselecting the mode points the shadow back at the (shared) configuration
+        obf->selectShadowFilterMode(m_sweepIdx[idx], mode, m_modeToConfig[mode]);
+
+        // So point it at this sweep point's copy for the mode
+        void* gammaCfgPrms = obf->getShadowFilterPrm(m_sweepIdx[idx], EFC_OBJECT_K_FILTER_PRM);
+
+        GammaFilterCfgPrms::useCfgPrms(gammaCfgPrms, m_sweepCfgs[idx * EFC_DB_MODE_K_CNT + mode]);
+
+        EFC_sampler* sampler = (EFC_sampler*)obf->getShadowFilterPrm(m_sweepIdx[idx], EFC_OBJECT_K_SAMPLER);
+
+        if (sampler && (m_runAllStages || m_gamBitsToIgnore)) sampler->classes.enabled.all = m_modeEnabled[mode];
+    }
+
+    return;
+}
+
+void GammaFilterTool::applyVetoMask(unsigned int& statusWord, unsigned char& sb)
+{
+    // Remove any undesired veto bits from the "old school" status word **** 
+    unsigned int oldStatusWord = ~m_gamBitsToIgnore & statusWord;
+
+    // If any unmasked veto bits are set then set the general event vetoed bit 
+    if (oldStatusWord & m_filterVetoMask)
+    {
+        statusWord |= GFC_V3_STATUS_M_VETOED;
+        sb         |= EDS_RSD_SB_M_VETOED;
+    }
 
     return;
 }
@@ -541,6 +745,40 @@ void GammaFilterTool::eoeProcessing(EDS_fwIxb* ixb)
     // Accumulate the status bit hits
     for(int ib = 0; ib < 32; ib++) if (statusWord & 1 << ib) m_statusBits[ib]++;
 
+    // Collect the results of the sweep points
+    if (!m_sweepIdx.empty())
+    {
+        ObfInterface* obf = ObfInterface::instance();
+
+        m_sweepEvents++;
+        if (!(sb & EDS_RSD_SB_M_VETOED)) m_primaryPassed++;
+
+        if (m_sweepFile.is_open())
+        {
+            SmartDataPtr<Event::EventHeader> header(m_dataSvc, EventModel::EventHeader);
+
+            m_sweepFile << (header ? header->run() : 0) << " " << (header ? header->event() : 0) 
+                        << std::hex << std::setfill('0') << " " << std::setw(8) << statusWord;
+        }
+
+        for(unsigned int idx = 0; idx < m_sweepIdx.size(); idx++)
+        {
+            unsigned char sweepSb     = 0;
+            unsigned int  sweepStatus = 0xFFFFFFFF;   // Did not run
+
+            if (obf->getShadowResult(m_sweepIdx[idx], sweepSb, &sweepStatus, 1))
+            {
+                if (m_runAllStages) applyVetoMask(sweepStatus, sweepSb);
+
+                if (!(sweepSb & EDS_RSD_SB_M_VETOED)) m_sweepPassed[idx]++;
+            }
+
+            if (m_sweepFile.is_open()) m_sweepFile << " " << std::setw(8) << sweepStatus;
+        }
+
+        if (m_sweepFile.is_open()) m_sweepFile << std::dec << std::setfill(' ') << "\n";
+    }
+
     return;
 }
 
@@ -559,5 +797,21 @@ void GammaFilterTool::eorProcessing()
 
     log  << endreq;
 
+    // And the sweep summary
+    if (!m_sweepIdx.empty())
+    {
+        const std::vector<std::string>& sweepConfigs = m_sweepConfigs;
+
+        log << MSG::INFO << "-- Gamma Filter parameter sweep, " << m_sweepEvents << " events -- \n"
+            << "    as configured: passed " << m_primaryPassed << "\n";
+
+        for(unsigned int idx = 0; idx < m_sweepIdx.size(); idx++)
+        {
+            log << "    " << sweepConfigs[idx] << ": passed " << m_sweepPassed[idx] << "\n";
+        }
+
+        log << endreq;
+    }
+
     return;
 }
@@ -75,6 +75,8 @@ private:
 
     //****** This section for defining JO parameters
     // This is somewhat useless but if set will be passed to the CDM utility to print info
+    /// Only run for a 1 in N subset of the events (see ObfSampler.h)
+    IntegerProperty   m_sampleRate;
 
     //****** This section contains various useful member variables
     /// Pointer to the Gaudi data provider service
@@ -96,6 +98,7 @@ GemOutputTool::GemOutputTool(const std::string& type,
 
     // declare properties with setProperties calls
     //declareProperty("FillTowerHits",   m_towerHits = true);
+    declareProperty("SampleRate",      m_sampleRate = 1);
 
     return;
 }
@@ -126,6 +129,7 @@ StatusCode GemOutputTool::initialize()
 
         // Register this as an output routine
         obf->setEovOutputCallBack(this);
+        obf->setSampleRate(this, name(), m_sampleRate.value());
     }
     catch(ObfInterface::ObfException& obfException)
     {
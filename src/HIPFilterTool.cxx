@@ -24,6 +24,8 @@
 
 // Interface to EDS package here
 #include "ObfInterface.h"
+#include "ObfWarmStart.h"
+#include "ObfMootConfigCache.h"
 
 // FSW includes go here
 #ifdef OBF_B1_1_3
@@ -101,10 +103,16 @@ private:
     // Which filter configuration to run
     StringProperty    m_configToRun;
 
+    // Run on 1 in this many events (see ObfSampler.h)
+    IntegerProperty   m_sampleRate;
+
     //****** This section for controlling implementation of Gamma Filter
     // Filter ID returned from EDS_fw after initialization
     int               m_handlerId;
 
+    // Target mask of this filter, looked up once
+    unsigned int      m_target;
+
     // Current mode and configuration
     unsigned short    m_curConfig;
     unsigned short    m_curMode;
@@ -132,6 +140,7 @@ HIPFilterTool::HIPFilterTool(const std::string& type,
                                  const std::string& name, 
                                  const IInterface* parent) :
                                  AlgTool(type, name, parent)
+                               , m_target(0)
                                , m_curConfig(0)
                                , m_curMode(EFC_DB_MODE_K_NORMAL)
                                , m_mootSvc(0)
@@ -147,6 +156,9 @@ HIPFilterTool::HIPFilterTool(const std::string& type,
     // Overrides the default configuration given in the Master Configuration file
     declareProperty("Configuration", m_configToRun   = "");
 
+    // Parameter: SampleRate
+    // Run the filter on a 1 in N subset of the events only, for a filter which is not active
+    declareProperty("SampleRate",    m_sampleRate    = 1);
     declareProperty("verbosity",     m_verbosity     = 0);
     
     // zero our counters
@@ -238,23 +250,23 @@ StatusCode HIPFilterTool::initialize()
         // Bit mask for this filter
         unsigned int target = obf->getFilterTargetMask(master.filter.id);
 
+        m_target = target;
+
         // Are we using moot and is this an active filter?
         bool activeFilter = false;
 
-        if (m_mootSvc)
+        // A warm start already has the configurations Moot gave each mode
+        const std::vector<int>* warmConfigs = 0;
+        if (m_mootSvc && obf->warmStart()) warmConfigs = obf->warmStart()->modeConfigs(m_filterLibs->FilterSchema());
+
+        if (m_mootSvc && !warmConfigs)
         {
-            std::vector<CalibData::MootFilterCfg> filterCfgVec;
-            unsigned int filterCnt = m_mootSvc->getActiveFilters(filterCfgVec);
-            
-            for(std::vector<CalibData::MootFilterCfg>::const_iterator filterIter = filterCfgVec.begin();
-                filterIter != filterCfgVec.end(); filterIter++)
+            const ObfMootConfigCache::ActiveFilter* mootFilter = ObfMootConfigCache::instance()->findActive(m_mootSvc, m_filterLibs->FilterSchema());
+
+            if (mootFilter)
             {
-                if (filterIter->getSchemaId() == m_filterLibs->FilterSchema())
-                {
-                    activeFilter = true;
-                    log << MSG::INFO << "Moot has filter " <<  filterIter->getName() << " as active" << endreq;
-                    break;
-                }
+                activeFilter = true;
+                log << MSG::INFO << "Moot has filter " <<  mootFilter->m_name << " as active" << endreq;
             }
         }
 
@@ -263,17 +275,21 @@ StatusCode HIPFilterTool::initialize()
         {
             unsigned int configuration = m_filterLibs->getMasterConfiguration().filter.mode2cfg[modeIdx];
 
+            // Use the warm start if we have one
+            if (warmConfigs && modeIdx < (int)warmConfigs->size() && (*warmConfigs)[modeIdx] >= 0)
+            {
+                configuration = (*warmConfigs)[modeIdx];
+            }
             // If MootSvc configured and filter is active then attempt to retrieve the information from moot
-            if (activeFilter)
+            else if (activeFilter)
             {
-                std::string filterName = "";
-                CalibData::MootFilterCfg* mootCfg = m_mootSvc->getActiveFilter(modeIdx, m_handlerId, filterName);
+                const ObfMootConfigCache::ModeConfig& mootCfg = ObfMootConfigCache::instance()->modeConfig(m_mootSvc, m_handlerId, modeIdx);
 
                 // Returned configuration for this handler and mode 
-                if (mootCfg)
+                if (mootCfg.m_instanceId >= 0)
                 {
-                    configuration = mootCfg->getInstanceId();
-                    log << MSG::INFO << "Moot: mode " << modeIdx << " associated with configuration:\n" << mootCfg->getSrcPath() << endreq;
+                    configuration = mootCfg.m_instanceId;
+                    log << MSG::INFO << "Moot: mode " << modeIdx << " associated with configuration:\n" << mootCfg.m_srcPath << endreq;
                 }
             }
 
@@ -288,6 +304,7 @@ StatusCode HIPFilterTool::initialize()
 
         // Set the Gamma Filter output routine
         obf->setEovOutputCallBack(this);
+        obf->setSampleRate(this, name(), m_sampleRate.value(), m_target);
     }
     catch(ObfInterface::ObfException& obfException)
     {
@@ -311,14 +328,14 @@ void HIPFilterTool::setMode(unsigned int mode)
     // Output what we are doing...
     MsgStream log(msgSvc(), name());
 
-    std::string modeDesc[] = {"EFC_DB_MODE_K_NORMAL",
-                              "EFC_DB_MODE_K_TOO",
-                              "EFC_DB_MODE_K_ARR",
-                              "EFC_DB_MODE_K_RSVD3",
-                              "EFC_DB_MODE_K_RSVD4",
-                              "EFC_DB_MODE_K_RSVD5",
-                              "EFC_DB_MODE_K_RSVD6",
-                              "EFC_DB_MODE_K_RSVD7" };
+    static const char* modeDesc[] = {"EFC_DB_MODE_K_NORMAL",
+                                     "EFC_DB_MODE_K_TOO",
+                                     "EFC_DB_MODE_K_ARR",
+                                     "EFC_DB_MODE_K_RSVD3",
+                                     "EFC_DB_MODE_K_RSVD4",
+                                     "EFC_DB_MODE_K_RSVD5",
+                                     "EFC_DB_MODE_K_RSVD6",
+                                     "EFC_DB_MODE_K_RSVD7" };
 
     log << MSG::INFO << "Received request to change mode from " << modeDesc[m_curMode] << " to " << modeDesc[mode] << endreq;
 
@@ -328,11 +345,8 @@ void HIPFilterTool::setMode(unsigned int mode)
     // Schema id
     unsigned short int masterId = m_filterLibs->getMasterConfiguration().filter.id;
 
-    // Bit mask for this filter
-    unsigned int target = obf->getFilterTargetMask(masterId);
-
     // Set the default mode to run
-    obf->selectFiltermode(target, mode);
+    obf->selectFiltermode(m_target, mode);
 
     // If we are "leaking" all events then modify here
     // Note: this is standard mode of running for GSW version of obf
@@ -345,6 +359,8 @@ void HIPFilterTool::setMode(unsigned int mode)
         ////sampler->prescale.prescalers[0].refresh = 1;
     }
 
+    m_curMode = mode;
+
     return;
 }
 
@@ -39,6 +39,10 @@ public:
     // This defines the method called for end of event processing
     virtual void eoeProcessing(EDS_fwIxb* ixb) = 0;
 
+    // Called instead of eoeProcessing for an event without any of the contributors the tool
+    // needs (see ObfInterface::setEventClassNeeds), to leave whatever output is always expected
+    virtual void eoeBypassed(EDS_fwIxb* ixb) {}
+
     // This for end of run processing
     virtual void eorProcessing() = 0;
 
@@ -0,0 +1,117 @@
+/**  @file ObfAdaptiveOrder.cxx
+    @brief implementation of class ObfAdaptiveOrder
+
+  $Header$
+*/
+
+#include "ObfAdaptiveOrder.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Orders filter indices on a score, lowest first
+    class ScoreLess
+    {
+    public:
+        ScoreLess(const std::vector<double>& score) : m_score(score) {}
+        bool operator()(int left, int right) const {return m_score[left] < m_score[right];}
+    private:
+        const std::vector<double>& m_score;
+    };
+}
+
+ObfAdaptiveOrder::ObfAdaptiveOrder(int nFilters, int verifyInterval) :
+                                   m_filters(nFilters), m_verifyInterval(verifyInterval),
+                                   m_enabled(verifyInterval > 0), m_fullEvent(true), m_events(0), m_fullEvents(0), m_mismatches(0)
+{
+    for(int filter = 0; filter < nFilters; filter++) m_order.push_back(filter);
+
+    if (!m_enabled) m_reason = "fixed order";
+}
+
+void ObfAdaptiveOrder::leaveOut(int filter)
+{
+    m_order.erase(std::remove(m_order.begin(), m_order.end(), filter), m_order.end());
+
+    return;
+}
+
+bool ObfAdaptiveOrder::ordered(int filter) const
+{
+    return std::find(m_order.begin(), m_order.end(), filter) != m_order.end();
+}
+
+bool ObfAdaptiveOrder::startEvent()
+{
+    // The first event is a full one, so the order is measured before it is used
+    m_fullEvent = !m_enabled || m_events++ % m_verifyInterval == 0;
+
+    if (m_fullEvent && m_enabled) m_fullEvents++;
+
+    return m_fullEvent;
+}
+
+void ObfAdaptiveOrder::addRun(int filter, long long costNs)
+{
+    m_filters[filter].m_runs++;
+    m_filters[filter].m_totalNs += costNs;
+
+    return;
+}
+
+void ObfAdaptiveOrder::addFullEvent(unsigned int decisive, bool agrees)
+{
+    for(unsigned int filter = 0; filter < m_filters.size(); filter++)
+    {
+        if (decisive & (1 << filter)) m_filters[filter].m_decisive++;
+    }
+
+    if (!agrees)
+    {
+        m_mismatches++;
+        disable("stopping early changed the decision of an event");
+    }
+
+    reorder();
+
+    return;
+}
+
+void ObfAdaptiveOrder::disable(const std::string& reason)
+{
+    if (m_enabled) m_reason = reason;
+
+    m_enabled = false;
+
+    return;
+}
+
+double ObfAdaptiveOrder::costNs(int filter) const
+{
+    const FilterStats& stats = m_filters[filter];
+
+    return stats.m_runs ? (double)stats.m_totalNs / (double)stats.m_runs : 0.;
+}
+
+double ObfAdaptiveOrder::decisive(int filter) const
+{
+    return m_fullEvents ? (double)m_filters[filter].m_decisive / (double)m_fullEvents : 0.;
+}
+
+void ObfAdaptiveOrder::reorder()
+{
+    std::vector<double> score(m_filters.size());
+
+    // A filter which never settles an event on its own still has to run eventually, last
+    for(unsigned int filter = 0; filter < m_filters.size(); filter++)
+    {
+        double fraction = decisive(filter);
+
+        score[filter] = costNs(filter) / (fraction > 1.e-3 ? fraction : 1.e-3);
+    }
+
+    std::stable_sort(m_order.begin(), m_order.end(), ScoreLess(score));
+
+    return;
+}
@@ -0,0 +1,106 @@
+/** @file ObfAdaptiveOrder.h
+*
+* @class ObfAdaptiveOrder
+*
+* @brief Bookkeeping for running the filters an accept decision depends on in the cheapest
+*        order, stopping as soon as the decision can no longer change.
+*
+*        Every verifyInterval-th event all the filters run, in the fixed order. Those events
+*        measure, for each filter, its cost and how often its result alone fixes the decision,
+*        and check that stopping early along the current order gives the same decision as the
+*        full run. After each of them the filters are sorted on cost per decisive result, so
+*        the cheapest filter most likely to settle the event goes first. The other events run
+*        the filters in that order until the decision is fixed.
+*
+*        Once disabled (a mismatch, or anything else making the early stop unsafe) every event
+*        runs in full again. A verifyInterval of 0 starts out disabled, in the given order.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfAdaptiveOrder_H
+#define __ObfAdaptiveOrder_H
+
+#include <string>
+#include <vector>
+
+class ObfAdaptiveOrder
+{
+public:
+    ObfAdaptiveOrder(int nFilters = 0, int verifyInterval = 1000);
+
+    /// Filters, by index, in the order to run them
+    const std::vector<int>& order() const {return m_order;}
+
+    /// Take a filter out of the order, it is never run by it
+    void leaveOut(int filter);
+
+    /// Is a filter in the order?
+    bool ordered(int filter) const;
+
+    /// Start the next event, returns true if it runs in full
+    bool startEvent();
+
+    /// Is the current event run in full?
+    bool fullEvent() const {return m_fullEvent;}
+
+    /// A filter ran on the event, and how long it took
+    void addRun(int filter, long long costNs);
+
+    /// A filter was not needed for the event
+    void addSkipped(int filter) {m_filters[filter].m_skipped++;}
+
+    /// Results of a full event: which filters fix the decision on their own (bit n for
+    /// filter n) and whether stopping early would have given the same decision. Reorders
+    void addFullEvent(unsigned int decisive, bool agrees);
+
+    /// Go back to running every event in full, for good
+    void disable(const std::string& reason);
+
+    bool               enabled()    const {return m_enabled;}
+    const std::string& reason()     const {return m_reason;}
+
+    int                nFilters()   const {return m_filters.size();}
+    unsigned long long events()     const {return m_events;}
+    unsigned long long fullEvents() const {return m_fullEvents;}    ///< While enabled
+    unsigned long long mismatches() const {return m_mismatches;}
+
+    unsigned long long runs(int filter)     const {return m_filters[filter].m_runs;}
+    unsigned long long skipped(int filter)  const {return m_filters[filter].m_skipped;}
+
+    /// Mean cost of a filter when it runs, in nanoseconds
+    double             costNs(int filter)   const;
+
+    /// Fraction of the full events a filter's result alone fixed the decision for
+    double             decisive(int filter) const;
+
+private:
+    class FilterStats
+    {
+    public:
+        FilterStats() : m_runs(0), m_skipped(0), m_totalNs(0), m_decisive(0) {}
+
+        unsigned long long m_runs;
+        unsigned long long m_skipped;
+        long long          m_totalNs;
+        unsigned long long m_decisive;
+    };
+
+    // Sort on cost per decisive result
+    void reorder();
+
+    std::vector<FilterStats> m_filters;
+    std::vector<int>         m_order;
+    int                      m_verifyInterval;
+    bool                     m_enabled;
+    bool                     m_fullEvent;
+    std::string              m_reason;
+
+    unsigned long long       m_events;
+    unsigned long long       m_fullEvents;
+    unsigned long long       m_mismatches;
+};
+
+#endif // __ObfAdaptiveOrder_H
@@ -0,0 +1,397 @@
+/**  @file ObfBatchFilterAlg.cxx
+    @brief implementation of class ObfBatchFilterAlg
+
+  $Header$
+*/
+
+#include "GaudiKernel/Algorithm.h"
+#include "GaudiKernel/MsgStream.h"
+#include "GaudiKernel/AlgFactory.h"
+#include "GaudiKernel/IDataProviderSvc.h"
+#include "GaudiKernel/SmartDataPtr.h"
+#include "GaudiKernel/Property.h"
+
+#include "Event/TopLevel/EventModel.h"
+#include "Event/TopLevel/Event.h"
+#include "Event/Digi/TkrDigi.h"
+#include "Event/Digi/CalDigi.h"
+#include "EbfWriter/Ebf.h"
+#include "OnboardFilterTds/ObfFilterStatus.h"
+
+#include "facilities/Util.h"
+
+#include "release/ObfReleaseEngineLoader.h"
+#include "ObfBatchScheduler.h"
+#include "ObfGoldenRecord.h"
+
+#include <vector>
+#include <cstring>
+
+namespace
+{
+    // Names of the result slots, for the log
+    const char* filterNames[] = {"Gamma", "HIP", "MIP", "DGN"};
+}
+
+/** @class ObfBatchFilterAlg
+    @brief Filters the events of a batch job out of order, in lanes, and writes the results
+           in the original order.
+
+           Each event's EBF is copied and given a class key from what it contains (tracker
+           and/or calorimeter digis) and its size (a power of two bin of the EBF length).
+           ObfBatchScheduler collects Window events, sorts them on the key so similar events
+           run back to back, and shares them out between Lanes lanes; events of at least
+           HeavyEventBytes go to a lane of their own. Every lane has its own release engine
+           (see ObfReleaseEngine.h), loaded into a separate link namespace so the lanes run
+           in parallel without sharing any FSW state.
+
+           The results go to GoldenOutputFile (see ObfGoldenRecord.h) in the order the events
+           were read, so two batch runs compare with obfGoldenDiff whatever their lanes and
+           window. The engines run the master configurations of all four filters in NORMAL
+           mode, so a file written by test_OnboardFilter only compares in a job doing the
+           same: no Moot, no mode changes, no filter parameters changed in the job options
+           and no FilterTrack (the engines do not find tracks).
+
+           A prescaler counts the events its own engine sees, and each lane has its own, so
+           which events a prescaled filter passes depends on how they were shared out. A
+           setup with a prescaling filter is refused unless AllowPrescalers is set; the
+           prescale bit of those filters is then left out of the golden records and their
+           pass taken from the veto alone; the events their prescalers let through are not
+           reproducible.
+
+           The TDS is not touched; this is for reprocessing passes which only want the filter
+           results. Only available on glibc platforms.
+*/
+class ObfBatchFilterAlg : public Algorithm
+{
+public:
+    ObfBatchFilterAlg(const std::string& name, ISvcLocator *pSvcLocator);
+    ~ObfBatchFilterAlg() {}
+
+    StatusCode initialize();
+    StatusCode execute();
+    StatusCode finalize();
+
+private:
+    /// One event in flight
+    class BatchEvent
+    {
+    public:
+        unsigned int       run;
+        unsigned long long eventId;
+        std::vector<char>  data;
+        ObfReleaseResult   result;
+        int                failed;
+    };
+
+    /// Work routine of the scheduler, runs on the thread of a lane
+    static void filterEvent(void* prm, int lane, void* item);
+
+    /// Write the result of a finished event and free it
+    StatusCode commitEvent(MsgStream& log, BatchEvent* event);
+
+    /// Commit the finished events, waiting until no more than maxOutstanding remain
+    StatusCode commitDone(MsgStream& log, int maxOutstanding);
+
+    //****** This section for defining JO parameters
+    StringProperty          m_engineLibrary;
+    StringProperty          m_engineOptions;
+    IntegerProperty         m_nLanes;
+    IntegerProperty         m_window;
+    IntegerProperty         m_heavyEventBytes;
+    IntegerProperty         m_maxOutstanding;
+    StringProperty          m_goldenFile;
+    BooleanProperty         m_allowPrescalers;
+
+    // One engine per lane, the heavy lane last
+    std::vector<ObfReleaseEngineLoader> m_engines;
+
+    ObfBatchScheduler*      m_scheduler;
+    ObfGoldenWriter         m_goldenWriter;
+
+    // Filters which prescale, bit n for slot n, their prescale bits are not recorded
+    unsigned int            m_prescaled;
+
+    // Counters
+    int                     m_events;
+    int                     m_heavyEvents;
+    int                     m_failed;
+    int                     m_accepted[ObfRelease_NumFilters];
+};
+
+DECLARE_ALGORITHM_FACTORY(ObfBatchFilterAlg);
+
+ObfBatchFilterAlg::ObfBatchFilterAlg(const std::string& name, ISvcLocator *pSvcLocator) :
+                   Algorithm(name, pSvcLocator), m_scheduler(0), m_prescaled(0), m_events(0), m_heavyEvents(0), m_failed(0)
+{
+    // Parameter: EngineLibrary / EngineOptions
+    // The release engine library every lane loads, and its NAME=value;... settings
+    declareProperty("EngineLibrary",   m_engineLibrary   = "");
+    declareProperty("EngineOptions",   m_engineOptions   = "");
+    // Parameter: Lanes
+    // Number of lanes for normal events, the heavy lane comes on top (at most 14 in all)
+    declareProperty("Lanes",           m_nLanes          = 2);
+    // Parameter: Window
+    // Number of events reordered at a time
+    declareProperty("Window",          m_window          = 64);
+    // Parameter: HeavyEventBytes
+    // Events with at least this much EBF go to the heavy lane
+    declareProperty("HeavyEventBytes", m_heavyEventBytes = 32768);
+    // Parameter: MaxOutstanding
+    // Limit on the events held in memory, read ahead stops until the oldest are done
+    declareProperty("MaxOutstanding",  m_maxOutstanding  = 256);
+    // Parameter: GoldenOutputFile
+    // Results in the original event order
+    declareProperty("GoldenOutputFile", m_goldenFile     = "");
+    // Parameter: AllowPrescalers
+    // Run filters which prescale, their results then depend on the lanes
+    declareProperty("AllowPrescalers", m_allowPrescalers = false);
+
+    memset(m_accepted, 0, sizeof(m_accepted));
+}
+
+StatusCode ObfBatchFilterAlg::initialize()
+{
+    MsgStream log(msgSvc(), name());
+
+    setProperties();
+
+    if (m_nLanes.value() < 1 || m_nLanes.value() > 13)
+    {
+        log << MSG::ERROR << "Lanes must be between 1 and 13, found " << m_nLanes.value() << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    std::string fileName = m_engineLibrary.value();
+    facilities::Util::expandEnvVar(&fileName);
+
+    // Normal lanes plus the heavy lane
+    m_engines.resize(m_nLanes.value() + 1);
+
+    for(unsigned int lane = 0; lane < m_engines.size(); lane++)
+    {
+        std::string error;
+
+        if (!m_engines[lane].load(fileName, m_engineOptions.value(), error))
+        {
+            log << MSG::ERROR << "Lane " << lane << ": " << error << endreq;
+            return StatusCode::FAILURE;
+        }
+    }
+
+    std::string release = m_engines[0].release(m_engines[0].engine);
+
+    // The engines all run the same configurations
+    m_prescaled = m_engines[0].prescaled(m_engines[0].engine);
+
+    if (m_prescaled)
+    {
+        std::string prescaledNames;
+        for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+            if (m_prescaled & (1 << slot)) prescaledNames += std::string(" ") + filterNames[slot];
+
+        if (!m_allowPrescalers.value())
+        {
+            log << MSG::ERROR << "Filters which prescale give results depending on the lanes:" << prescaledNames
+                << ", set AllowPrescalers to run them anyway" << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        log << MSG::WARNING << "Results of" << prescaledNames << " depend on the lanes, their prescale bits "
+            << "are left out of the golden records" << endreq;
+    }
+
+    if (m_goldenFile.value() != "")
+    {
+        std::string goldenName = m_goldenFile.value();
+        facilities::Util::expandEnvVar(&goldenName);
+
+        if (!m_goldenWriter.open(goldenName, release))
+        {
+            log << MSG::ERROR << "Unable to open golden output file " << goldenName << endreq;
+            return StatusCode::FAILURE;
+        }
+    }
+
+    m_scheduler = new ObfBatchScheduler(filterEvent, this, m_nLanes.value(), m_window.value());
+
+    log << MSG::INFO << "Batch filtering with FSW release " << release << " in " << m_nLanes.value()
+        << " lanes plus a heavy lane, reorder window " << m_window.value() << endreq;
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode ObfBatchFilterAlg::execute()
+{
+    MsgStream log(msgSvc(), name());
+
+    SmartDataPtr<EbfWriterTds::Ebf> ebfData(eventSvc(), "/Event/Filter/Ebf");
+
+    if (!ebfData) return StatusCode::SUCCESS;
+
+    unsigned int length = 0;
+    char*        data   = ebfData->get(length);
+
+    if (length == 0) return StatusCode::SUCCESS;
+
+    m_events++;
+
+    BatchEvent* event = new BatchEvent();
+
+    SmartDataPtr<Event::EventHeader> header(eventSvc(), EventModel::EventHeader);
+
+    event->run     = header ? header->run()   : 0;
+    event->eventId = header ? header->event() : m_events;
+    event->data.assign(data, data + length);
+    event->failed  = 0;
+
+    // Class key: size bin above the contributor bits
+    SmartDataPtr<Event::TkrDigiCol> tkrDigis(eventSvc(), EventModel::Digi::TkrDigiCol);
+    SmartDataPtr<Event::CalDigiCol> calDigis(eventSvc(), EventModel::Digi::CalDigiCol);
+
+    unsigned int sizeBin = 0;
+    while((length >> sizeBin) > 1) sizeBin++;
+
+    unsigned int key = sizeBin << 2;
+    if (tkrDigis && !tkrDigis->empty()) key |= 1;
+    if (calDigis && !calDigis->empty()) key |= 2;
+
+    bool heavy = (int)length >= m_heavyEventBytes.value();
+
+    if (heavy) m_heavyEvents++;
+
+    m_scheduler->submit(event, key, heavy);
+
+    return commitDone(log, m_maxOutstanding.value());
+}
+
+void ObfBatchFilterAlg::filterEvent(void* prm, int lane, void* item)
+{
+    ObfBatchFilterAlg*      alg    = reinterpret_cast<ObfBatchFilterAlg*>(prm);
+    BatchEvent*             event  = reinterpret_cast<BatchEvent*>(item);
+    ObfReleaseEngineLoader& engine = alg->m_engines[lane];
+
+    event->failed = engine.filter(engine.engine, &event->data[0], event->data.size(), &event->result);
+
+    return;
+}
+
+StatusCode ObfBatchFilterAlg::commitDone(MsgStream& log, int maxOutstanding)
+{
+    void* item = 0;
+
+    // Whatever is finished, then wait for the oldest while there are too many
+    while(m_scheduler->nextDone(item, false))
+    {
+        if (commitEvent(log, reinterpret_cast<BatchEvent*>(item)).isFailure()) return StatusCode::FAILURE;
+    }
+
+    while(m_scheduler->outstanding() > maxOutstanding && m_scheduler->nextDone(item, true))
+    {
+        if (commitEvent(log, reinterpret_cast<BatchEvent*>(item)).isFailure()) return StatusCode::FAILURE;
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode ObfBatchFilterAlg::commitEvent(MsgStream& log, BatchEvent* event)
+{
+    StatusCode sc = StatusCode::SUCCESS;
+
+    if (event->failed) m_failed++;
+    else
+    {
+        ObfGoldenRecord record;
+
+        record.run     = event->run;
+        record.eventId = event->eventId;
+
+        for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+        {
+            const ObfReleaseFilterResult& result = event->result.filters[slot];
+
+            if (!result.ran) continue;
+
+            unsigned char sb       = result.sb;
+            bool          accepted = result.accepted != 0;
+
+            // Which events a prescaler passes depends on the lane, only the veto is kept
+            if (m_prescaled & (1 << slot))
+            {
+                sb       = sb & ~EDS_RSD_SB_M_PRESCALE_OUT;
+                accepted = (sb & EDS_RSD_SB_M_VETOED) == 0;
+            }
+
+            record.present     |= 1 << slot;
+            record.status[slot] = result.status;
+            record.id[slot]     = result.id;
+            record.sb[slot]     = sb;
+
+            if (accepted)
+            {
+                record.passed |= 1 << slot;
+                m_accepted[slot]++;
+            }
+        }
+
+        record.gammaEnergy = event->result.filters[ObfRelease_Gamma].energy;
+
+        if (m_goldenWriter.isOpen() && !m_goldenWriter.write(record))
+        {
+            log << MSG::ERROR << "Error writing golden record" << endreq;
+            sc = StatusCode::FAILURE;
+        }
+    }
+
+    delete event;
+
+    return sc;
+}
+
+StatusCode ObfBatchFilterAlg::finalize()
+{
+    MsgStream log(msgSvc(), name());
+
+    StatusCode sc = StatusCode::SUCCESS;
+
+    if (m_scheduler)
+    {
+        m_scheduler->flush();
+
+        sc = commitDone(log, 0);
+
+        log << MSG::INFO << "Batch filtered " << m_events << " events, " << m_heavyEvents << " heavy";
+        if (m_failed) log << ", " << m_failed << " could not be filtered";
+        log << "\n    accepted:";
+        for(int slot = 0; slot < ObfRelease_NumFilters; slot++) log << " " << filterNames[slot] << " " << m_accepted[slot];
+        log << "\n";
+
+        for(int lane = 0; lane <= m_scheduler->nLanes(); lane++)
+        {
+            log << "    lane " << lane << (lane == m_scheduler->nLanes() ? " (heavy)" : "") << ": "
+                << m_scheduler->laneEvents(lane) << " events, class changed " << m_scheduler->laneKeyChanges(lane) << " times\n";
+        }
+
+        log << "    latency (us) normal median " << 1.e-3 * m_scheduler->latency(false, 0.5)
+            << " 99% "                           << 1.e-3 * m_scheduler->latency(false, 0.99)
+            << ", heavy median "                 << 1.e-3 * m_scheduler->latency(true,  0.5)
+            << " 99% "                           << 1.e-3 * m_scheduler->latency(true,  0.99) << endreq;
+
+        // Stops the lanes before their engines go
+        delete m_scheduler;
+        m_scheduler = 0;
+    }
+
+    if (m_goldenWriter.isOpen())
+    {
+        log << MSG::INFO << "Wrote " << m_goldenWriter.getRecords() << " golden records" << endreq;
+        m_goldenWriter.close();
+    }
+
+    for(std::vector<ObfReleaseEngineLoader>::iterator engineIter = m_engines.begin(); engineIter != m_engines.end(); engineIter++)
+    {
+        engineIter->unload();
+    }
+
+    return sc;
+}
@@ -0,0 +1,278 @@
+/**  @file ObfBatchScheduler.cxx
+    @brief implementation of class ObfBatchScheduler
+
+  $Header$
+*/
+
+#include "ObfBatchScheduler.h"
+#include "ObfPerfMonitor.h"
+
+#include <algorithm>
+
+ObfBatchScheduler::ObfBatchScheduler(WorkRtn workRtn, void* prm, int nLanes, int window) :
+                                     m_workRtn(workRtn), m_prm(prm), m_window(window < 1 ? 1 : window),
+                                     m_lanes((nLanes < 1 ? 1 : nLanes) + 1)
+{
+#ifndef _WIN32
+    pthread_mutex_init(&m_mutex, 0);
+    pthread_cond_init(&m_workCond, 0);
+    pthread_cond_init(&m_doneCond, 0);
+    m_stopping = false;
+
+    // Sized before any thread starts, the threads keep pointers into it
+    m_laneArgs.resize(m_lanes.size());
+
+    for(unsigned int lane = 0; lane < m_lanes.size(); lane++)
+    {
+        m_laneArgs[lane].m_scheduler = this;
+        m_laneArgs[lane].m_lane      = lane;
+
+        pthread_create(&m_lanes[lane].m_thread, 0, worker, &m_laneArgs[lane]);
+    }
+#endif
+}
+
+ObfBatchScheduler::~ObfBatchScheduler()
+{
+#ifndef _WIN32
+    // Let the lanes finish what they have, then stop them
+    pthread_mutex_lock(&m_mutex);
+    dispatch();
+    m_stopping = true;
+    pthread_cond_broadcast(&m_workCond);
+    pthread_mutex_unlock(&m_mutex);
+
+    for(std::vector<Lane>::iterator laneIter = m_lanes.begin(); laneIter != m_lanes.end(); laneIter++)
+    {
+        pthread_join(laneIter->m_thread, 0);
+    }
+
+    pthread_cond_destroy(&m_doneCond);
+    pthread_cond_destroy(&m_workCond);
+    pthread_mutex_destroy(&m_mutex);
+#else
+    dispatch();
+#endif
+
+    for(std::deque<Item*>::iterator itemIter = m_inFlight.begin(); itemIter != m_inFlight.end(); itemIter++) delete *itemIter;
+}
+
+void ObfBatchScheduler::submit(void* item, unsigned int key, bool heavy)
+{
+    Item* newItem = new Item();
+
+    newItem->m_item       = item;
+    newItem->m_key        = key;
+    newItem->m_heavy      = heavy;
+    newItem->m_dispatched = false;
+    newItem->m_done       = false;
+    newItem->m_submitNs   = ObfPerfMonitor::wallTimeNs();
+    newItem->m_doneNs     = 0;
+
+#ifndef _WIN32
+    pthread_mutex_lock(&m_mutex);
+#endif
+
+    m_inFlight.push_back(newItem);
+
+    if (heavy)
+    {
+        int heavyLane = m_lanes.size() - 1;
+
+        newItem->m_dispatched = true;
+#ifndef _WIN32
+        m_lanes[heavyLane].m_queue.push_back(newItem);
+        pthread_cond_broadcast(&m_workCond);
+#else
+        runItem(heavyLane, newItem);
+#endif
+    }
+    else
+    {
+        m_pending.push_back(newItem);
+
+        if ((int)m_pending.size() >= m_window) dispatch();
+    }
+
+#ifndef _WIN32
+    pthread_mutex_unlock(&m_mutex);
+#endif
+
+    return;
+}
+
+void ObfBatchScheduler::flush()
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&m_mutex);
+    dispatch();
+    pthread_mutex_unlock(&m_mutex);
+#else
+    dispatch();
+#endif
+
+    return;
+}
+
+void ObfBatchScheduler::dispatch()
+{
+    if (m_pending.empty()) return;
+
+    // Group by key, in arrival order within a key
+    std::stable_sort(m_pending.begin(), m_pending.end(), keyLess);
+
+    // Contiguous runs of the sorted window, one per normal lane
+    int nNormal = m_lanes.size() - 1;
+    int perLane = (m_pending.size() + nNormal - 1) / nNormal;
+
+    for(unsigned int idx = 0; idx < m_pending.size(); idx++)
+    {
+        Item* item = m_pending[idx];
+
+        item->m_dispatched = true;
+#ifndef _WIN32
+        m_lanes[idx / perLane].m_queue.push_back(item);
+#else
+        runItem(idx / perLane, item);
+#endif
+    }
+
+    m_pending.clear();
+
+#ifndef _WIN32
+    pthread_cond_broadcast(&m_workCond);
+#endif
+
+    return;
+}
+
+bool ObfBatchScheduler::nextDone(void*& item, bool wait)
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&m_mutex);
+
+    while(!m_inFlight.empty() && !m_inFlight.front()->m_done)
+    {
+        if (!wait) break;
+
+        // The oldest event may still be sitting in the window
+        if (!m_inFlight.front()->m_dispatched) dispatch();
+
+        pthread_cond_wait(&m_doneCond, &m_mutex);
+    }
+#else
+    if (wait && !m_inFlight.empty() && !m_inFlight.front()->m_dispatched) dispatch();
+#endif
+
+    bool found = !m_inFlight.empty() && m_inFlight.front()->m_done;
+
+    if (found)
+    {
+        Item* done = m_inFlight.front();
+
+        m_inFlight.pop_front();
+
+        m_latency[done->m_heavy ? 1 : 0].push_back(done->m_doneNs - done->m_submitNs);
+
+        item = done->m_item;
+
+        delete done;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_unlock(&m_mutex);
+#endif
+
+    return found;
+}
+
+int ObfBatchScheduler::outstanding() const
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&m_mutex);
+    int nOutstanding = m_inFlight.size();
+    pthread_mutex_unlock(&m_mutex);
+
+    return nOutstanding;
+#else
+    return m_inFlight.size();
+#endif
+}
+
+long long ObfBatchScheduler::latency(bool heavy, double fraction) const
+{
+    std::vector<long long> latency = m_latency[heavy ? 1 : 0];
+
+    if (latency.empty()) return 0;
+
+    unsigned int index = (unsigned int)(fraction * (latency.size() - 1) + 0.5);
+    if (index >= latency.size()) index = latency.size() - 1;
+
+    std::nth_element(latency.begin(), latency.begin() + index, latency.end());
+
+    return latency[index];
+}
+
+void ObfBatchScheduler::runItem(int lane, Item* item)
+{
+    m_workRtn(m_prm, lane, item->m_item);
+
+#ifndef _WIN32
+    pthread_mutex_lock(&m_mutex);
+#endif
+
+    Lane& laneRef = m_lanes[lane];
+
+    if (laneRef.m_events++ > 0 && item->m_key != laneRef.m_lastKey) laneRef.m_keyChanges++;
+    laneRef.m_lastKey = item->m_key;
+
+    item->m_doneNs = ObfPerfMonitor::wallTimeNs();
+    item->m_done   = true;
+
+#ifndef _WIN32
+    pthread_cond_broadcast(&m_doneCond);
+    pthread_mutex_unlock(&m_mutex);
+#endif
+
+    return;
+}
+
+void* ObfBatchScheduler::worker(void* arg)
+{
+#ifndef _WIN32
+    LaneArg* laneArg = reinterpret_cast<LaneArg*>(arg);
+
+    laneArg->m_scheduler->runLane(laneArg->m_lane);
+#endif
+
+    return 0;
+}
+
+void ObfBatchScheduler::runLane(int lane)
+{
+#ifndef _WIN32
+    std::deque<Item*>& queue = m_lanes[lane].m_queue;
+
+    pthread_mutex_lock(&m_mutex);
+
+    for(;;)
+    {
+        while(queue.empty() && !m_stopping) pthread_cond_wait(&m_workCond, &m_mutex);
+
+        if (queue.empty()) break;
+
+        Item* item = queue.front();
+        queue.pop_front();
+
+        pthread_mutex_unlock(&m_mutex);
+
+        runItem(lane, item);
+
+        pthread_mutex_lock(&m_mutex);
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+#endif
+
+    return;
+}
@@ -0,0 +1,137 @@
+/** @file ObfBatchScheduler.h
+*
+* @class ObfBatchScheduler
+*
+* @brief Reorders a stream of events into lanes for batch filtering, and hands the
+*        results back in the original order.
+*
+*        Events are submitted with a class key (what the event contains, how big it is)
+*        and collected in a reorder window. When the window is full it is sorted on the
+*        key, so that similar events run back to back and keep the caches warm, and cut
+*        into contiguous runs, one per lane. Heavy events skip the window and go to a lane
+*        of their own, so a heavy ion or shower never holds up the small events behind it.
+*
+*        Each lane is a thread calling the work routine for its events one at a time; the
+*        routine is given the lane number so it can keep per lane state (e.g. a filter
+*        engine of its own). nextDone returns the events strictly in the order submitted,
+*        whichever lane finished them first. Per lane state which counts events, such as
+*        a filter's prescalers, sees only the events of its lane, so depends on the window.
+*
+*        Without pthreads the work routine is called in line when a window is dispatched.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfBatchScheduler_H
+#define __ObfBatchScheduler_H
+
+#include <vector>
+#include <deque>
+
+#ifndef _WIN32
+#  include <pthread.h>
+#endif
+
+class ObfBatchScheduler
+{
+public:
+    /// Routine doing the work for one event, called on the thread of the lane
+    typedef void (*WorkRtn)(void* prm, int lane, void* item);
+
+    /// nLanes lanes for the normal events plus one for heavy events, which are numbered nLanes
+    ObfBatchScheduler(WorkRtn workRtn, void* prm, int nLanes = 1, int window = 64);
+    ~ObfBatchScheduler();
+
+    /// Queue an event. The item is given to the work routine and returned by nextDone
+    void submit(void* item, unsigned int key, bool heavy);
+
+    /// Dispatch the events still waiting in the window
+    void flush();
+
+    /// Next finished event in submission order. If wait is set blocks until it is done,
+    /// otherwise returns false if it is not. Returns false when nothing is outstanding
+    bool nextDone(void*& item, bool wait);
+
+    /// Events submitted and not yet returned by nextDone
+    int outstanding() const;
+
+    int nLanes()  const {return m_lanes.size() - 1;}
+    int window()  const {return m_window;}
+
+    /// Events run by a lane and the number of times the key changed from one to the next
+    unsigned long long laneEvents(int lane)     const {return m_lanes[lane].m_events;}
+    unsigned long long laneKeyChanges(int lane) const {return m_lanes[lane].m_keyChanges;}
+
+    /// Latency, submit to done, of the normal or heavy events at a given fraction (0.5 for
+    /// the median, 0.99...) in nanoseconds. Only the events returned by nextDone count
+    long long latency(bool heavy, double fraction) const;
+
+private:
+    class Item
+    {
+    public:
+        void*        m_item;
+        unsigned int m_key;
+        bool         m_heavy;
+        bool         m_dispatched;
+        bool         m_done;
+        long long    m_submitNs;
+        long long    m_doneNs;
+    };
+
+    class Lane
+    {
+    public:
+        Lane() : m_events(0), m_keyChanges(0), m_lastKey(0) {}
+
+        std::deque<Item*>  m_queue;
+        unsigned long long m_events;
+        unsigned long long m_keyChanges;
+        unsigned int       m_lastKey;
+#ifndef _WIN32
+        pthread_t          m_thread;
+#endif
+    };
+
+    // Sort the window and hand it to the lanes
+    void dispatch();
+
+    // Run one event on a lane
+    void runItem(int lane, Item* item);
+
+    static void* worker(void* arg);
+    void         runLane(int lane);
+
+    // Ordering of the window
+    static bool keyLess(const Item* left, const Item* right) {return left->m_key < right->m_key;}
+
+    WorkRtn                 m_workRtn;
+    void*                   m_prm;
+    int                     m_window;
+
+    std::vector<Lane>       m_lanes;
+    std::vector<Item*>      m_pending;       // Window not yet dispatched
+    std::deque<Item*>       m_inFlight;      // Everything not yet returned, in submission order
+
+    std::vector<long long>  m_latency[2];    // Normal, heavy
+
+#ifndef _WIN32
+    mutable pthread_mutex_t m_mutex;
+    pthread_cond_t          m_workCond;      // Signalled when a lane has work, or on stopping
+    pthread_cond_t          m_doneCond;      // Signalled when an event is done
+    bool                    m_stopping;
+
+    // Argument of a lane thread
+    class LaneArg
+    {
+    public:
+        ObfBatchScheduler* m_scheduler;
+        int                m_lane;
+    };
+    std::vector<LaneArg>    m_laneArgs;
+#endif
+};
+
+#endif // __ObfBatchScheduler_H
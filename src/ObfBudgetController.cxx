@@ -0,0 +1,48 @@
+/**  @file ObfBudgetController.cxx
+    @brief implementation of class ObfBudgetController
+
+  $Header$
+*/
+
+#include "ObfBudgetController.h"
+
+const double ObfBudgetController::LowWater = 0.7;
+
+ObfBudgetController::ObfBudgetController(double budgetNs, double smoothing, int interval, int maxThrottle) :
+                                         m_budgetNs(budgetNs), m_smoothing(smoothing),
+                                         m_interval(interval < 1 ? 1 : interval), m_maxThrottle(maxThrottle < 1 ? 1 : maxThrottle),
+                                         m_throttle(1), m_averageNs(0.), m_eventCount(0)
+{
+}
+
+bool ObfBudgetController::addEvent(long long costNs, unsigned int run, unsigned long long event)
+{
+    m_eventsByThrottle[m_throttle]++;
+
+    // The first event starts the average
+    if (m_eventCount++ == 0) m_averageNs  = (double)costNs;
+    else                     m_averageNs += m_smoothing * ((double)costNs - m_averageNs);
+
+    if (!enabled() || m_eventCount % m_interval != 0) return false;
+
+    int throttle = m_throttle;
+
+    if      (m_averageNs > m_budgetNs && 2 * throttle <= m_maxThrottle)  throttle *= 2;
+    else if (m_averageNs < LowWater * m_budgetNs && throttle > 1)        throttle /= 2;
+
+    if (throttle == m_throttle) return false;
+
+    Change change;
+    change.m_eventCount = m_eventCount;
+    change.m_run        = run;
+    change.m_event      = event;
+    change.m_averageNs  = m_averageNs;
+    change.m_from       = m_throttle;
+    change.m_to         = throttle;
+
+    m_changes.push_back(change);
+
+    m_throttle = throttle;
+
+    return true;
+}
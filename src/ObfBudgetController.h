@@ -0,0 +1,77 @@
+/** @file ObfBudgetController.h
+*
+* @class ObfBudgetController
+*
+* @brief Feedback control of the optional filter work against a per event time budget.
+*
+*        The cost of each event is folded into an exponentially weighted moving average.
+*        Every interval events the average is compared to the budget: above it the throttle
+*        factor doubles (up to a maximum), below LowWater of it the factor halves again.
+*        The factor multiplies the sample rate of every optional filter and output tool
+*        (see ObfSampler.h), those the accept decision depends on are never throttled, so
+*        the decisions stay exact.
+*
+*        Every change is recorded with the event it took effect after, so that statistics
+*        from the throttled tools can be reweighted period by period.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfBudgetController_H
+#define __ObfBudgetController_H
+
+#include <vector>
+#include <map>
+
+class ObfBudgetController
+{
+public:
+    /// A change of the throttle factor
+    class Change
+    {
+    public:
+        unsigned long long m_eventCount;     ///< Events seen when the change was made
+        unsigned int       m_run;            ///< Run and event number of the last event at the old factor
+        unsigned long long m_event;
+        double             m_averageNs;      ///< Moving average cost per event at the time
+        int                m_from;
+        int                m_to;
+    };
+
+    /// A budget of zero switches the control off
+    ObfBudgetController(double budgetNs = 0., double smoothing = 0.02, int interval = 100, int maxThrottle = 64);
+
+    bool   enabled()  const {return m_budgetNs > 0.;}
+
+    /// Add the cost of an event, returns true if the throttle factor changed
+    bool   addEvent(long long costNs, unsigned int run, unsigned long long event);
+
+    int    throttle() const {return m_throttle;}
+    double average()  const {return m_averageNs;}
+    double budget()   const {return m_budgetNs;}
+
+    const std::vector<Change>&                 changes()          const {return m_changes;}
+
+    /// Number of events run at each throttle factor
+    const std::map<int, unsigned long long>&   eventsByThrottle() const {return m_eventsByThrottle;}
+
+private:
+    // Fraction of the budget below which the throttle is eased
+    static const double LowWater;
+
+    double                            m_budgetNs;
+    double                            m_smoothing;
+    int                               m_interval;
+    int                               m_maxThrottle;
+
+    int                               m_throttle;
+    double                            m_averageNs;
+    unsigned long long                m_eventCount;
+
+    std::vector<Change>               m_changes;
+    std::map<int, unsigned long long> m_eventsByThrottle;
+};
+
+#endif // __ObfBudgetController_H
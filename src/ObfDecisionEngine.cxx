@@ -0,0 +1,316 @@
+/**  @file ObfDecisionEngine.cxx
+    @brief implementation of class ObfDecisionEngine
+
+  $Header$
+*/
+
+#include "ObfDecisionEngine.h"
+
+#include <cctype>
+
+namespace
+{
+    std::string toLower(const std::string& text)
+    {
+        std::string lower = text;
+
+        for(std::string::iterator charIter = lower.begin(); charIter != lower.end(); charIter++)
+            *charIter = std::tolower(*charIter);
+
+        return lower;
+    }
+}
+
+// Recursive descent parser, or of ands of (possibly negated) terms
+class ObfDecisionEngine::Parser
+{
+public:
+    Parser(const std::string& text, const std::vector<std::string>& filterNames,
+           ObfDecisionEngine::Program& program, std::vector<unsigned int>& sourceBits) :
+           m_text(text), m_pos(0), m_filterNames(filterNames), m_program(program), m_sourceBits(sourceBits) {}
+
+    bool parse(std::string& error)
+    {
+        if (!parseOr())
+        {
+            error = m_error;
+            return false;
+        }
+
+        if (peek() != "")
+        {
+            error = "unexpected '" + peek() + "' in accept expression";
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    // Next token without consuming it: a name, or one of ! & | ( ) && ||
+    std::string peek()
+    {
+        while(m_pos < m_text.size() && std::isspace(m_text[m_pos])) m_pos++;
+
+        if (m_pos >= m_text.size()) return "";
+
+        std::string::size_type end = m_pos;
+
+        if (std::isalnum(m_text[end]) || m_text[end] == '_')
+        {
+            while(end < m_text.size() && (std::isalnum(m_text[end]) || m_text[end] == '_' || m_text[end] == '.')) end++;
+        }
+        else if ((m_text[end] == '&' || m_text[end] == '|') && end + 1 < m_text.size() && m_text[end + 1] == m_text[end]) end += 2;
+        else end++;
+
+        return m_text.substr(m_pos, end - m_pos);
+    }
+
+    std::string next()
+    {
+        std::string token = peek();
+        m_pos += token.size();
+        return token;
+    }
+
+    bool isOr(const std::string& token)  {return token == "|" || token == "||" || toLower(token) == "or";}
+    bool isAnd(const std::string& token) {return token == "&" || token == "&&" || toLower(token) == "and";}
+    bool isNot(const std::string& token) {return token == "!" || toLower(token) == "not";}
+
+    bool parseOr()
+    {
+        if (!parseAnd()) return false;
+
+        while(isOr(peek()))
+        {
+            next();
+            if (!parseAnd()) return false;
+            m_program.push_back(Op(Or));
+        }
+
+        return true;
+    }
+
+    bool parseAnd()
+    {
+        if (!parseTerm()) return false;
+
+        while(isAnd(peek()))
+        {
+            next();
+            if (!parseTerm()) return false;
+            m_program.push_back(Op(And));
+        }
+
+        return true;
+    }
+
+    bool parseTerm()
+    {
+        std::string token = next();
+
+        if (isNot(token))
+        {
+            if (!parseTerm()) return false;
+            m_program.push_back(Op(Not));
+            return true;
+        }
+
+        if (token == "(")
+        {
+            if (!parseOr()) return false;
+            if (next() != ")")
+            {
+                m_error = "missing ')' in accept expression";
+                return false;
+            }
+            return true;
+        }
+
+        if (token == "" || !(std::isalnum(token[0]) || token[0] == '_'))
+        {
+            m_error = token == "" ? "accept expression ends too soon" : "unexpected '" + token + "' in accept expression";
+            return false;
+        }
+
+        return variable(token);
+    }
+
+    // filter[.condition]
+    bool variable(const std::string& token)
+    {
+        std::string::size_type dot       = token.find('.');
+        std::string            filter    = toLower(token.substr(0, dot));
+        std::string            condition = dot == std::string::npos ? "pass" : toLower(token.substr(dot + 1));
+
+        int slot = -1;
+        for(unsigned int idx = 0; idx < m_filterNames.size() && slot < 0; idx++)
+        {
+            std::string name = toLower(m_filterNames[idx]);
+            if (filter == name || filter == name + "filter") slot = idx;
+        }
+
+        int bit = -1;
+        if      (condition == "pass")      bit = PassBit;
+        else if (condition == "ran")       bit = RanBit;
+        else if (condition == "vetoed")    bit = VetoedBit;
+        else if (condition == "prescaled") bit = PrescaledBit;
+
+        if (slot < 0 || slot >= MaxFilters || bit < 0)
+        {
+            m_error = "unknown filter or condition '" + token + "' in accept expression";
+            return false;
+        }
+
+        unsigned int sourceBit = slot * BitsPerFilter + bit;
+        unsigned int var       = 0;
+
+        while(var < m_sourceBits.size() && m_sourceBits[var] != sourceBit) var++;
+
+        if (var == m_sourceBits.size())
+        {
+            if (var >= MaxVariables)
+            {
+                m_error = "too many conditions in accept expression";
+                return false;
+            }
+            m_sourceBits.push_back(sourceBit);
+        }
+
+        m_program.push_back(Op(PushVar, var));
+
+        return true;
+    }
+
+    const std::string&              m_text;
+    std::string::size_type          m_pos;
+    const std::vector<std::string>& m_filterNames;
+    ObfDecisionEngine::Program&     m_program;
+    std::vector<unsigned int>&      m_sourceBits;
+    std::string                     m_error;
+};
+
+bool ObfDecisionEngine::compile(const std::string& expression, const std::vector<std::string>& filterNames, std::string& error)
+{
+    Program                   program;
+    std::vector<unsigned int> sourceBits;
+
+    if (expression.find_first_not_of(" \t") != std::string::npos)
+    {
+        Parser parser(expression, filterNames, program, sourceBits);
+
+        if (!parser.parse(error)) return false;
+    }
+
+    // Tabulate every assignment of the variables used
+    unsigned int nEntries = 1 << sourceBits.size();
+
+    m_table.assign((nEntries + 31) / 32, 0);
+
+    for(unsigned int index = 0; index < nEntries; index++)
+    {
+        if (!program.empty() && evaluate(program, index)) m_table[index >> 5] |= 1 << (index & 31);
+    }
+
+    m_expression = expression;
+    m_sourceBits = sourceBits;
+    m_outcomes.clear();
+
+    return true;
+}
+
+void ObfDecisionEngine::accept(const unsigned int* inputs, int nEvents, bool* decisions) const
+{
+    for(int event = 0; event < nEvents; event++) decisions[event] = accept(inputs[event]);
+
+    return;
+}
+
+bool ObfDecisionEngine::decidedBy(unsigned int slotMask, unsigned int inputs, bool& decision) const
+{
+    const std::vector<unsigned char>& outcome = outcomes(slotMask);
+
+    // Gather the known variables as in accept
+    unsigned int index = 0;
+    unsigned int known = 0;
+
+    for(unsigned int var = 0; var < m_sourceBits.size(); var++)
+    {
+        if (!(slotMask & (1 << (m_sourceBits[var] / BitsPerFilter)))) continue;
+
+        index |= ((inputs >> m_sourceBits[var]) & 1) << known++;
+    }
+
+    if (outcome[index] == Open) return false;
+
+    decision = outcome[index] == Accept;
+
+    return true;
+}
+
+const std::vector<unsigned char>& ObfDecisionEngine::outcomes(unsigned int slotMask) const
+{
+    std::map<unsigned int, std::vector<unsigned char> >::const_iterator outcomeIter = m_outcomes.find(slotMask);
+
+    if (outcomeIter != m_outcomes.end()) return outcomeIter->second;
+
+    // Variables of the filters in the mask
+    std::vector<unsigned int> knownVars;
+
+    for(unsigned int var = 0; var < m_sourceBits.size(); var++)
+    {
+        if (slotMask & (1 << (m_sourceBits[var] / BitsPerFilter))) knownVars.push_back(var);
+    }
+
+    std::vector<unsigned char>& outcome = m_outcomes[slotMask];
+
+    outcome.assign(1 << knownVars.size(), Open);
+
+    // Merge the decisions of all the assignments which agree on the known variables
+    std::vector<bool> seen(outcome.size(), false);
+    unsigned int      nEntries = 1 << m_sourceBits.size();
+
+    for(unsigned int index = 0; index < nEntries; index++)
+    {
+        unsigned int knownIndex = 0;
+
+        for(unsigned int known = 0; known < knownVars.size(); known++) knownIndex |= ((index >> knownVars[known]) & 1) << known;
+
+        unsigned char value = (m_table[index >> 5] >> (index & 31)) & 1 ? Accept : Reject;
+
+        if      (!seen[knownIndex])             outcome[knownIndex] = value;
+        else if (outcome[knownIndex] != value)  outcome[knownIndex] = Open;
+
+        seen[knownIndex] = true;
+    }
+
+    return outcome;
+}
+
+bool ObfDecisionEngine::evaluate(const Program& program, unsigned int index)
+{
+    std::vector<bool> stack;
+
+    for(Program::const_iterator opIter = program.begin(); opIter != program.end(); opIter++)
+    {
+        switch(opIter->m_code)
+        {
+        case PushVar:
+            stack.push_back(((index >> opIter->m_var) & 1) != 0);
+            break;
+        case Not:
+            stack.back() = !stack.back();
+            break;
+        case And:
+        case Or:
+            {
+                bool right = stack.back();
+                stack.pop_back();
+                stack.back() = opIter->m_code == And ? (stack.back() && right) : (stack.back() || right);
+            }
+            break;
+        }
+    }
+
+    return stack.back();
+}
@@ -0,0 +1,115 @@
+/** @file ObfDecisionEngine.h
+*
+* @class ObfDecisionEngine
+*
+* @brief Accept/reject decision over the results of several filters, given as a boolean
+*        expression, e.g. "Gamma | (HIP & !DGN)".
+*
+*        Each filter has a slot, named by the caller, and four condition bits per event:
+*          pass       the filter accepts the event (prescale taken into account)
+*          ran        the filter produced a result for the event
+*          vetoed     the veto bit of its summary byte
+*          prescaled  the prescale bit of its summary byte
+*        A filter name on its own means name.pass. Operators are ! (or NOT), & (&&, AND),
+*        | (||, OR) and parentheses, names and keywords are not case sensitive.
+*
+*        compile() turns the expression into a truth table over the condition bits it
+*        uses (at most MaxVariables of them), so deciding an event is a fixed sequence of
+*        shifts and masks to gather those bits and one table look up, with no branches
+*        depending on the event.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfDecisionEngine_H
+#define __ObfDecisionEngine_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+class ObfDecisionEngine
+{
+public:
+    enum {PassBit = 0, RanBit = 1, VetoedBit = 2, PrescaledBit = 3, BitsPerFilter = 4};
+    enum {MaxFilters = 8, MaxVariables = 16};
+
+    ObfDecisionEngine() {}
+
+    /// Condition bits of a filter in the given slot, to be or'ed into an event's input word
+    static unsigned int filterBits(int slot, bool ran, bool pass, bool vetoed, bool prescaled)
+    {
+        return ((unsigned int)ran       << RanBit
+              | (unsigned int)pass      << PassBit
+              | (unsigned int)vetoed    << VetoedBit
+              | (unsigned int)prescaled << PrescaledBit) << (slot * BitsPerFilter);
+    }
+
+    /// Compile an expression over the filters named (slot = index in filterNames), returns
+    /// false with a message if it does not parse. An empty expression rejects everything
+    bool compile(const std::string& expression, const std::vector<std::string>& filterNames, std::string& error);
+
+    /// Decide one event from its input word
+    bool accept(unsigned int inputs) const
+    {
+        unsigned int index = 0;
+
+        for(unsigned int var = 0; var < m_sourceBits.size(); var++) index |= ((inputs >> m_sourceBits[var]) & 1) << var;
+
+        return (m_table[index >> 5] >> (index & 31)) & 1;
+    }
+
+    /// Decide a batch of events
+    void accept(const unsigned int* inputs, int nEvents, bool* decisions) const;
+
+    /// Is the decision already fixed by the filters in slotMask (bit n for slot n), whatever
+    /// the others give? If so returns true with the decision. Only the condition bits of
+    /// those filters are taken from inputs
+    bool decidedBy(unsigned int slotMask, unsigned int inputs, bool& decision) const;
+
+    /// The expression compiled, as given
+    const std::string& expression() const {return m_expression;}
+
+    /// Number of condition bits the expression depends on
+    int nVariables() const {return m_sourceBits.size();}
+
+    /// Does the expression depend on the filter in this slot?
+    bool usesFilter(int slot) const
+    {
+        for(unsigned int var = 0; var < m_sourceBits.size(); var++) if ((int)m_sourceBits[var] / BitsPerFilter == slot) return true;
+        return false;
+    }
+
+private:
+    // Postfix program the expression parses into, only used while compiling
+    enum OpCode {PushVar, Not, And, Or};
+    class Op
+    {
+    public:
+        Op(OpCode code, int var = 0) : m_code(code), m_var(var) {}
+        OpCode m_code;
+        int    m_var;
+    };
+    typedef std::vector<Op> Program;
+
+    class Parser;
+
+    // Value of the program for one assignment of the variables
+    static bool evaluate(const Program& program, unsigned int index);
+
+    // Outcome over the variables of a set of filters: Reject, Accept or Open if it still
+    // depends on the others, indexed by the assignment of those variables
+    enum Outcome {Reject = 0, Accept = 1, Open = 2};
+    const std::vector<unsigned char>& outcomes(unsigned int slotMask) const;
+
+    std::string               m_expression;
+    std::vector<unsigned int> m_sourceBits;    // Input bit of each variable
+    std::vector<unsigned int> m_table;         // Decision for each assignment, packed 32 to a word
+
+    // Outcome tables by slot mask, made when first asked for
+    mutable std::map<unsigned int, std::vector<unsigned char> > m_outcomes;
+};
+
+#endif // __ObfDecisionEngine_H
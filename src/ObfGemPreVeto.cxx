@@ -0,0 +1,113 @@
+/**  @file ObfGemPreVeto.cxx
+    @brief implementation of class ObfGemPreVeto
+
+  $Header$
+*/
+
+#include "ObfGemPreVeto.h"
+
+ObfGemPreVeto::ObfGemPreVeto(int minTraining, int checkInterval) :
+                             m_minTraining(minTraining < 1 ? 1 : minTraining), m_checkInterval(checkInterval < 1 ? 1 : checkInterval),
+                             m_enabled(true), m_events(0), m_accepted(0), m_rejected(0), m_checked(0), m_disagreed(0)
+{
+}
+
+unsigned long long ObfGemPreVeto::key(unsigned int condsumCno, unsigned int thrTkr, unsigned int calHiLo, bool acdVeto)
+{
+    // The halves of calHiLo are the HI and LO tower vectors, either way round only "any" matters
+    unsigned int flags = (thrTkr              ? 0x1 : 0)
+                       | (calHiLo & 0xffff    ? 0x2 : 0)
+                       | (calHiLo >> 16       ? 0x4 : 0)
+                       | (acdVeto             ? 0x8 : 0);
+
+    return (unsigned long long)flags << 32 | condsumCno;
+}
+
+ObfGemPreVeto::Verdict ObfGemPreVeto::decide(unsigned long long key)
+{
+    m_events++;
+
+    if (!m_enabled) return Open;
+
+    RuleMap::iterator ruleIter = m_rules.find(key);
+
+    if (ruleIter == m_rules.end() || !active(ruleIter->second)) return Open;
+
+    Rule& rule = ruleIter->second;
+
+    // Starting with the first firing, so a rule is checked before it is trusted
+    if (rule.m_fired++ % m_checkInterval == 0) return Check;
+
+    if (rule.m_accepted)
+    {
+        m_accepted++;
+        return Accept;
+    }
+
+    m_rejected++;
+
+    return Reject;
+}
+
+void ObfGemPreVeto::addDecision(unsigned long long key, bool accepted, Verdict verdict)
+{
+    Rule& rule = m_rules[key];
+
+    if (verdict == Check)
+    {
+        m_checked++;
+
+        if (active(rule) && accepted != (rule.m_accepted != 0))
+        {
+            m_disagreed++;
+            rule.m_retired = true;
+        }
+    }
+
+    if (accepted) rule.m_accepted++;
+    else          rule.m_rejected++;
+
+    return;
+}
+
+void ObfGemPreVeto::disable(const std::string& reason)
+{
+    if (m_enabled) m_reason = reason;
+
+    m_enabled = false;
+
+    return;
+}
+
+int ObfGemPreVeto::active() const
+{
+    int nActive = 0;
+
+    for(RuleMap::const_iterator ruleIter = m_rules.begin(); ruleIter != m_rules.end(); ruleIter++)
+    {
+        if (active(ruleIter->second)) nActive++;
+    }
+
+    return nActive;
+}
+
+int ObfGemPreVeto::retired() const
+{
+    int nRetired = 0;
+
+    for(RuleMap::const_iterator ruleIter = m_rules.begin(); ruleIter != m_rules.end(); ruleIter++)
+    {
+        if (ruleIter->second.m_retired) nRetired++;
+    }
+
+    return nRetired;
+}
+
+bool ObfGemPreVeto::active(const Rule& rule) const
+{
+    if (rule.m_retired) return false;
+
+    if (rule.m_accepted && rule.m_rejected) return false;
+
+    return rule.m_accepted + rule.m_rejected >= (unsigned long long)m_minTraining;
+}
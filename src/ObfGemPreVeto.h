@@ -0,0 +1,104 @@
+/** @file ObfGemPreVeto.h
+*
+* @class ObfGemPreVeto
+*
+* @brief Rules deciding events from their GEM summary alone, ahead of the filters.
+*
+*        Events are grouped by a signature made from the GEM condition summary word, whether
+*        any tower has a tracker trigger, CAL LO or CAL HI, and whether any ACD tile vetoed.
+*        While the filters run, every decision they make trains the rule of its signature.
+*        A rule is used once its signature has had at least minTraining events, all with the
+*        same decision. A rule found wrong is retired for good.
+*
+*        With a checkInterval of 1 (the default) every firing is a Check: the filters still
+*        decide every event and the rules are only measured against them. This is lossless.
+*
+*        With a larger checkInterval the rules are statistical and LOSSY. A rule then decides
+*        the events with its signature without running the filters, except every
+*        checkInterval-th time it fires. The decisions in between are never verified: an event
+*        the filters would have decided the other way goes unnoticed, so a signature whose
+*        events are rarely accepted loses those accepts until a check happens to land on one.
+*        The signature is coarse and nothing here knows the filter configuration, so no rule
+*        is proven safe. Only for productions which can afford such losses.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfGemPreVeto_H
+#define __ObfGemPreVeto_H
+
+#include <string>
+#include <map>
+
+class ObfGemPreVeto
+{
+public:
+    /// What the rules make of an event
+    enum Verdict {Open   = 0,   ///< No rule, the filters decide
+                  Accept = 1,   ///< Accepted without running the filters
+                  Reject = 2,   ///< Rejected without running the filters
+                  Check  = 3};  ///< A rule fired, the filters run to check it
+
+    /// A checkInterval above 1 lets rules decide events unchecked, see above
+    ObfGemPreVeto(int minTraining = 1000, int checkInterval = 1);
+
+    /// Signature of an event from its GEM summary
+    static unsigned long long key(unsigned int condsumCno, unsigned int thrTkr, unsigned int calHiLo, bool acdVeto);
+
+    /// Verdict for an event with this signature
+    Verdict decide(unsigned long long key);
+
+    /// The filters decided an event the verdict was Open or Check for
+    void addDecision(unsigned long long key, bool accepted, Verdict verdict);
+
+    /// Stop deciding events, for good
+    void disable(const std::string& reason);
+
+    bool               enabled()    const {return m_enabled;}
+    bool               lossy()      const {return m_checkInterval > 1;}
+    const std::string& reason()     const {return m_reason;}
+
+    unsigned long long events()     const {return m_events;}
+    unsigned long long accepted()   const {return m_accepted;}    ///< Accepted by a rule
+    unsigned long long rejected()   const {return m_rejected;}    ///< Rejected by a rule
+    unsigned long long checked()    const {return m_checked;}
+    unsigned long long disagreed()  const {return m_disagreed;}
+
+    /// Number of signatures seen, with a rule in use and with a retired rule
+    int                signatures() const {return m_rules.size();}
+    int                active()     const;
+    int                retired()    const;
+
+private:
+    class Rule
+    {
+    public:
+        Rule() : m_accepted(0), m_rejected(0), m_fired(0), m_retired(false) {}
+
+        unsigned long long m_accepted;     // Training decisions
+        unsigned long long m_rejected;
+        unsigned long long m_fired;
+        bool               m_retired;
+    };
+
+    // Has the rule seen enough, all one way?
+    bool active(const Rule& rule) const;
+
+    typedef std::map<unsigned long long, Rule> RuleMap;
+    RuleMap            m_rules;
+
+    int                m_minTraining;
+    int                m_checkInterval;
+    bool               m_enabled;
+    std::string        m_reason;
+
+    unsigned long long m_events;
+    unsigned long long m_accepted;
+    unsigned long long m_rejected;
+    unsigned long long m_checked;
+    unsigned long long m_disagreed;
+};
+
+#endif // __ObfGemPreVeto_H
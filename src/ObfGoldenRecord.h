@@ -0,0 +1,144 @@
+/** @file ObfGoldenRecord.h
+*
+* @class ObfGoldenRecord
+*
+* @brief Fixed size binary record of the filter decisions for one event, used to prove
+*        that changes to the package leave every decision bit-identical. A golden file is
+*        an ObfGoldenHeader followed by one ObfGoldenRecord per event. Records are plain
+*        data so files can be compared with block memcmp; the sequence number is the
+*        order in which the event was processed and is not part of the comparison, so
+*        files written by serial and parallel drivers can be checked against each other
+*        after sorting on (run, eventId).
+*
+*        No dependence on Gaudi, this header is shared by the test harness, the parallel
+*        drivers and the obfGoldenDiff utility.
+*
+* $Header$
+*/
+
+#ifndef __ObfGoldenRecord_H
+#define __ObfGoldenRecord_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+class ObfGoldenRecord
+{
+public:
+    /// Filter slots in the record
+    enum Filters {Gamma = 0, HIP = 1, MIP = 2, DGN = 3, NumFilters = 4};
+
+    /// Bits in the present word
+    enum Present {TrackPresent = 0x10};
+
+    ObfGoldenRecord() {clear();}
+
+    void clear() {memset(this, 0, sizeof(ObfGoldenRecord));}
+
+    /// Number of leading bytes which take part in the comparison (everything but sequence and passed)
+    static size_t compareSize() {return sizeof(ObfGoldenRecord) - sizeof(unsigned int) - sizeof(unsigned int);}
+
+    /// Compare the decision content of two records
+    bool sameDecisions(const ObfGoldenRecord& other) const {return memcmp(this, &other, compareSize()) == 0;}
+
+    /// Order on (run, eventId) for unordered comparisons
+    bool operator<(const ObfGoldenRecord& other) const
+    {
+        if (run != other.run) return run < other.run;
+        return eventId < other.eventId;
+    }
+
+    unsigned long long eventId;                  ///< Event number
+    unsigned int       run;                      ///< Run number
+    unsigned int       present;                  ///< Bit n set if filter n ran, TrackPresent if FilterTrack ran
+    unsigned int       status[NumFilters];       ///< Filter status words
+    unsigned char      id[NumFilters];           ///< rsdDsc->id for each filter
+    unsigned char      sb[NumFilters];           ///< Summary bytes
+    unsigned int       gammaEnergy;              ///< Gamma filter energy
+    int                nXhits;                   ///< FilterTrack hits in X
+    int                nYhits;                   ///< FilterTrack hits in Y
+    float              xInt;                     ///< FilterTrack X intercept
+    float              yInt;                     ///< FilterTrack Y intercept
+    float              zInt;                     ///< FilterTrack Z of the intercept
+    float              slpXZ;                    ///< FilterTrack XZ slope
+    float              slpYZ;                    ///< FilterTrack YZ slope
+    unsigned int       sequence;                 ///< Processing order, not compared
+    unsigned int       passed;                   ///< Bit n set if filter n accepted the event (from sb, version 2 on)
+};
+
+/** @class ObfGoldenHeader
+* @brief File header for a golden file
+*/
+class ObfGoldenHeader
+{
+public:
+    /// Version 2 added the passed word to the record
+    enum {CurrentVersion = 2};
+
+    ObfGoldenHeader() : version(CurrentVersion), recordSize(sizeof(ObfGoldenRecord)), flags(0), spare(0)
+    {
+        memcpy(magic, "OBFGOLD1", 8);
+        memset(release, 0, sizeof(release));
+    }
+
+    bool valid() const {return memcmp(magic, "OBFGOLD1", 8) == 0 && recordSize == sizeof(ObfGoldenRecord);}
+
+    char         magic[8];
+    unsigned int version;
+    unsigned int recordSize;
+    unsigned int flags;
+    unsigned int spare;
+    char         release[32];                    ///< Flight software release which wrote the file
+};
+
+/** @class ObfGoldenWriter
+* @brief Buffered writer of golden files
+*/
+class ObfGoldenWriter
+{
+public:
+    ObfGoldenWriter() : m_file(0), m_nRecords(0) {}
+    ~ObfGoldenWriter() {close();}
+
+    /// Open the file and write the header, returns false on failure
+    bool open(const std::string& fileName, const std::string& release = "")
+    {
+        close();
+
+        m_file = fopen(fileName.c_str(), "wb");
+        if (!m_file) return false;
+
+        // Large buffer, records are small and come one at a time
+        setvbuf(m_file, 0, _IOFBF, 1 << 20);
+
+        ObfGoldenHeader header;
+        strncpy(header.release, release.c_str(), sizeof(header.release) - 1);
+
+        return fwrite(&header, sizeof(header), 1, m_file) == 1;
+    }
+
+    bool write(ObfGoldenRecord& record)
+    {
+        if (!m_file) return false;
+
+        record.sequence = m_nRecords++;
+
+        return fwrite(&record, sizeof(record), 1, m_file) == 1;
+    }
+
+    void close()
+    {
+        if (m_file) fclose(m_file);
+        m_file = 0;
+    }
+
+    bool         isOpen()     const {return m_file != 0;}
+    unsigned int getRecords() const {return m_nRecords;}
+
+private:
+    FILE*        m_file;
+    unsigned int m_nRecords;
+};
+
+#endif // __ObfGoldenRecord_H
@@ -4,11 +4,19 @@
 #include "IFilterTool.h"
 #include "IFilterCfgPrms.h"
 #include "IFilterLibs.h"
+#include "ObfLibraryLoader.h"
+#include "ObfLibraryBundle.h"
+#include "ObfWarmStart.h"
+#include "ObfSampler.h"
+#include "ObfPerfMonitor.h"
+#include "ObfAdaptiveOrder.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
 #include <sstream>
+#include <algorithm>
 
 #include "EbfWriter/Ebf.h"
 
@@ -23,9 +31,11 @@
 
 #ifdef OBF_B1_1_3
 #include "FSWHeaders/EFC.h"
+#include "FSWHeaders/EFC_sampler.h"
 #endif
 #if defined(OBF_B3_0_0) || defined(OBF_B3_1_0)  || defined(OBF_B3_1_1) || defined(OBF_B3_1_3)
 #include "EFC/EFC.h"
+#include "EFC/EFC_samplerDef.h"
 #include "EFC/EFR_key.h"
 #include "CDM/CDM_pubdefs.h"
 #endif
@@ -39,6 +49,7 @@
 
 #include "EDS/io/EBF_evts.h"
 #include "EDS/EBF_edw.h"
+#include "EDS/EBF_dir.h"
 #include "EDS/LCBV.h"
 
 #include "GaudiKernel/MsgStream.h"
@@ -57,6 +68,10 @@ static unsigned int dummyFreeRtn (void* prm, EBF_pkt *from, EBF_pkt *to);
 static int          myOutputFlush (void *unused, int reason);
 // Enables us to run the filters in pass-through mode
 static int          passThrough (void *unused, unsigned int nbytes, EBF_pkt *pkt, EBF_siv siv, EDS_fwIxb ixb);
+// Runs the shadow filters on a packet
+static int          runShadowFilters (ObfShadowList* shadows, unsigned int nbytes, EBF_pkt *pkt, EBF_siv siv, EDS_fwIxb *ixb);
+// Runs the adaptively ordered filters on a packet
+static int          runOrderedFilters (ObfOrderedSweep* ordered, unsigned int nbytes, EBF_pkt *pkt, EBF_siv siv, EDS_fwIxb *ixb);
 
 /* ---------------------------------------------------------------------- */
 
@@ -66,12 +81,167 @@ class EOVCallBackParams
 {
 public:
 //    EOVCallBackParams() : m_statParms(0), m_callBackParm(0) {m_callBackVec.clear();}
-    EOVCallBackParams() : m_statParms(0) {m_callBackVec.clear();}
+    EOVCallBackParams() : m_statParms(0), m_decisionRtn(0), m_decisionPrm(0), m_outputSkipped(0),
+                          m_deadlineNs(0), m_timedOut(false), m_eventClass(0), m_ordered(0) {m_callBackVec.clear();}
     ~EOVCallBackParams() {}
 
-    std::ostringstream     m_defaultStream;
-    void*                  m_statParms;
-    OutputRtnVec           m_callBackVec;
+    typedef std::pair<ObfInterface::EovCallBackRtn, void*> EovCallBack;
+
+    std::ostringstream       m_defaultStream;
+    void*                    m_statParms;
+    OutputRtnVec             m_callBackVec;
+    std::vector<EovCallBack> m_rtnCallBackVec;
+
+    // Output routines for accepted events only, and what decides
+    OutputRtnVec             m_acceptedOnlyVec;
+    ObfInterface::EovDecisionRtn m_decisionRtn;
+    void*                    m_decisionPrm;
+    int                      m_outputSkipped;
+
+    // Sampled output routines and those not selected for the current event
+    typedef std::pair<IFilterTool*, ObfSampler> SampledRtn;
+    std::vector<SampledRtn>  m_sampledVec;
+    OutputRtnVec             m_skippedVec;
+
+    // Output tools, as opposed to filters, left out of an event which runs out of time
+    OutputRtnVec             m_outputToolVec;
+
+    // Time the current event has to finish by (0 if no limit) and whether it ran out
+    long long                m_deadlineNs;
+    bool                     m_timedOut;
+
+    // Event classes each routine needs, those not listed need every event
+    typedef std::map<IFilterTool*, unsigned int> ClassNeedsMap;
+    ClassNeedsMap            m_classNeeds;
+    unsigned int             m_eventClass;
+
+    // Adaptively ordered filters, checked at the end of a full event
+    ObfOrderedSweep*         m_ordered;
+
+    bool skipped(IFilterTool* outRtn) const
+    {
+        if (m_timedOut && std::find(m_outputToolVec.begin(), m_outputToolVec.end(), outRtn) != m_outputToolVec.end()) return true;
+
+        return !m_skippedVec.empty() && std::find(m_skippedVec.begin(), m_skippedVec.end(), outRtn) != m_skippedVec.end();
+    }
+
+    // Run the routine, or only its bypass if the event has none of the classes it needs
+    void run(IFilterTool* outRtn, EDS_fwIxb* ixb) const
+    {
+        ClassNeedsMap::const_iterator needsIter = m_classNeeds.find(outRtn);
+
+        if (needsIter == m_classNeeds.end() || (needsIter->second & m_eventClass)) outRtn->eoeProcessing(ixb);
+        else                                                                       outRtn->eoeBypassed(ixb);
+    }
+
+    // Check the deadline, once passed the event stays timed out
+    bool timedOut()
+    {
+        if (!m_timedOut && m_deadlineNs && ObfPerfMonitor::wallTimeNs() > m_deadlineNs) m_timedOut = true;
+
+        return m_timedOut;
+    }
+};
+
+/* ---------------------------------------------------------------------- */
+// Local utility classes for the shadow filters
+// The sweep handler occupies a handler slot not used by the flight filters and runs
+// just ahead of the pass through handler (priority 1000), after the flight filters
+static const int ShadowHandlerId       = 16;
+static const int ShadowHandlerPriority = 990;
+
+class ObfShadowFilter
+{
+public:
+    enum {MaxResultBytes = 32};
+
+    ObfShadowFilter(EFC* efc, int handlerId, unsigned int resultBytes) : 
+                    m_efc(efc), m_handlerId(handlerId), m_resultBytes(resultBytes), m_valid(false), m_sb(0)
+    {
+        if (m_resultBytes > MaxResultBytes) m_resultBytes = MaxResultBytes;
+        memset(m_result, 0, sizeof(m_result));
+    }
+
+    EFC*          m_efc;
+    int           m_handlerId;                         // Handler id of the flight filter being shadowed
+    unsigned int  m_resultBytes;                       // Size of the result summary to keep
+    bool          m_valid;                             // Set when the shadow ran on the current event
+    unsigned char m_sb;
+    unsigned int  m_result[MaxResultBytes / sizeof(unsigned int)];
+};
+
+class ObfShadowList
+{
+public:
+    ObfShadowList() : m_handlerId(-1) {}
+    ~ObfShadowList() {}
+
+    // Clear the results before each event
+    void clearResults()
+    {
+        for(std::vector<ObfShadowFilter>::iterator iter = m_filters.begin(); iter != m_filters.end(); iter++) 
+            iter->m_valid = false;
+    }
+
+    int                          m_handlerId;
+    std::vector<ObfShadowFilter> m_filters;
+};
+
+/* ---------------------------------------------------------------------- */
+// Local utility classes for the adaptively ordered filters
+// The flight handlers of the ordered filters are disabled and this sweep handler runs them
+// instead, after any other flight filter and ahead of the shadow sweep
+static const int OrderedHandlerId       = 17;
+static const int OrderedHandlerPriority = 980;
+
+class ObfOrderedFilter
+{
+public:
+    ObfOrderedFilter(EFC* efc, int handlerId, unsigned int target) : m_efc(efc), m_handlerId(handlerId), m_target(target) {}
+
+    EFC*          m_efc;                               // The flight filter
+    int           m_handlerId;                         // Its handler id, where its result goes
+    unsigned int  m_target;                            // Its handler mask
+};
+
+class ObfOrderedSweep
+{
+public:
+    ObfOrderedSweep(EOVCallBackParams* callBack, ObfInterface::PartialDecisionRtn decisionRtn, void* prm, 
+                    int nFilters, int verifyInterval) :
+                    m_callBack(callBack), m_decisionRtn(decisionRtn), m_decisionPrm(prm), m_preDecisionRtn(0), m_preDecisionPrm(0), m_handlerId(-1),
+                    m_order(nFilters, verifyInterval), m_earlyDecided(false), m_earlyDecision(false), m_decisive(0)
+    {
+        memset(m_sbs, 0, sizeof(m_sbs));
+    }
+
+    // Check the early stop of a full event against the decision actually made
+    void endEvent()
+    {
+        if (!m_order.enabled() || !m_order.fullEvent()) return;
+
+        bool decision = m_callBack->m_decisionRtn(m_callBack->m_decisionPrm);
+
+        m_order.addFullEvent(m_decisive, !m_earlyDecided || m_earlyDecision == decision);
+    }
+
+    EOVCallBackParams*               m_callBack;
+    ObfInterface::PartialDecisionRtn m_decisionRtn;
+    void*                            m_decisionPrm;
+    ObfInterface::PreDecisionRtn     m_preDecisionRtn;
+    void*                            m_preDecisionPrm;
+    int                              m_handlerId;
+
+    // By index in the list given, those not set up have no EFC
+    std::vector<ObfOrderedFilter>    m_filters;
+    ObfAdaptiveOrder                 m_order;
+
+    // Current event: summary bytes, where the decision became fixed and, for a full event,
+    // which filters fix it on their own
+    unsigned char                    m_sbs[32];
+    bool                             m_earlyDecided;
+    bool                             m_earlyDecision;
+    unsigned int                     m_decisive;
 };
 
 ObfInterface* ObfInterface::m_instance = 0;
@@ -82,11 +252,24 @@ ObfInterface* ObfInterface::instance()
     return m_instance;
 }
 
-ObfInterface::ObfInterface() : m_eventCount(0), m_eventProcessed(0), m_eventBad(0), m_levels(0), m_verbosity(0)
+ObfInterface::ObfInterface() : m_eventCount(0), m_eventProcessed(0), m_eventBad(0), m_levels(0), m_verbosity(0),
+                               m_deferConfigLoading(false), m_eventBudgetNs(0)
 {
     // Call back routine control
     m_callBack = new EOVCallBackParams();
 
+    // Shadow filters, if any
+    m_shadows  = new ObfShadowList();
+
+    // No adaptive ordering unless asked for
+    m_ordered  = 0;
+
+    // Registry and prefetching of the libraries we load
+    m_loader   = new ObfLibraryLoader();
+    m_bundle   = 0;
+
+    m_warmStart = 0;
+
     m_schemaToEnum[GAMMA_DB_SCHEMA] = EH_ID_K_GAMMA;
     m_schemaToEnum[MIP_DB_SCHEMA]   = EH_ID_K_MIP;
     m_schemaToEnum[HIP_DB_SCHEMA]   = EH_ID_K_HIP;
@@ -145,7 +328,16 @@ ObfInterface::ObfInterface() : m_eventCount(0), m_eventProcessed(0), m_eventBad(
 
 ObfInterface::~ObfInterface()
 {
-    free(m_edsFw);
+    // dumpCounters will normally have released the framework already
+    if (m_edsFw) free(m_edsFw);
+    m_edsFw = 0;
+
+    delete m_callBack;
+    delete m_shadows;
+    delete m_ordered;
+    delete m_loader;
+    delete m_bundle;
+    delete m_warmStart;
 
     return;
 }
@@ -155,6 +347,9 @@ int ObfInterface::setupFilter(const EFC_DB_Schema* schema,
 {
     int filterId = -100;
 
+    // The configuration must be loaded to find its key
+    requireConfiguration(schema->filter.id, configIndex);
+
     // Attempt to trap any dprintf or printf output in fsw code
     // Create a local buffer and store the current state of stdout
 #ifdef _WIN32__
@@ -194,6 +389,10 @@ int ObfInterface::setupFilter(const EFC_DB_Schema* schema,
     // Keep track of the pointer for deletion at end of processing
     m_filterMap[schema->filter.id] = filter;
 
+    // And what is needed to shadow it
+    m_filterSchemas[schema->filter.id]    = schema;
+    m_filterHandlerIds[schema->filter.id] = filterId;
+
     // Associate a configuration with our run mode
     //EDS_fwHandlerAssociate(m_edsFw, EDS_FW_MASK(target), EFC_DB_MODE_K_NORMAL, configIndex );
     //EDS_fwHandlerAssociate(m_edsFw, target, EFC_DB_MODE_K_NORMAL, configIndex );
@@ -217,6 +416,23 @@ int ObfInterface::setupFilter(const EFC_DB_Schema* schema,
 /// Associate a given (set of) filter(s) configuration with a mode
 unsigned int ObfInterface::associateConfigToMode(unsigned int targets, unsigned int mode, unsigned int configuration)
 {
+    // Remember the association for any mode shadows
+    for(SchemaToEnumMap::const_iterator idIter = m_schemaToEnum.begin(); idIter != m_schemaToEnum.end(); idIter++)
+    {
+        if (!(targets & EDS_FW_MASK(idIter->second))) continue;
+
+        // Load the configuration now if it was deferred
+        requireConfiguration(idIter->first, configuration);
+
+        if (mode >= EFC_DB_MODE_K_CNT) continue;
+
+        std::vector<int>& modeConfigs = m_modeConfigs[idIter->first];
+
+        if (modeConfigs.empty()) modeConfigs.resize(EFC_DB_MODE_K_CNT, -1);
+
+        modeConfigs[mode] = configuration;
+    }
+
     // Associate a configuration with our run mode
     return EDS_fwHandlerAssociate(m_edsFw, targets, mode, configuration );
 }
@@ -258,10 +474,369 @@ void* ObfInterface::getFilterPrm(unsigned short filterSchemaId, int type)
 }
 
 
+int ObfInterface::setupShadowFilter(const EFC_DB_Schema* schema,
+                                    int                  handlerId,
+                                    unsigned int         mode,
+                                    unsigned short int   configIndex)
+{
+    requireConfiguration(schema->filter.id, configIndex);
+
+    // Retrieve the key to our filter
+#if defined(OBF_B3_0_0) || defined(OBF_B3_1_0) || defined(OBF_B3_1_1) || defined(OBF_B3_1_3)
+    unsigned int key = EFR_keyGet (CDM_findDatabase (schema->filter.id, configIndex), 0);
+#endif
+#ifdef OBF_B1_1_3
+    unsigned int key = LFR_keyGet (CDM_findDatabase (schema->filter.id, configIndex), 0);
+#endif
+
+    // Get a pointer to the "services" structure 
+    const char*                            fnd      = schema->eds.get;
+    EDS_DB_handlerServicesGet              get      = (const EDS_DB_HandlerConstructServices*(*)(void*)) CMX_lookupSymbol(fnd);
+    const EDS_DB_HandlerConstructServices *services = (EDS_DB_HandlerConstructServices *)get (0);
+
+    // Look up the target mask for this filter
+    unsigned int target = m_schemaToEnum[schema->filter.id];
+
+    // Allocate memory for the Filter and then initialize it, but do NOT register it
+    EFC* filter = (EFC *) malloc(services->sizeOf (schema, NULL));
+    services->construct (filter, target, schema, key, NULL, m_edsFw);
+
+    // Register the sweep handler the first time through
+    if (m_shadows->m_handlerId < 0)
+    {
+        m_shadows->m_handlerId = EDS_fwHandlerRegister (m_edsFw,
+                                 ShadowHandlerId,
+                                 EDS_FW_OBJ_M_DIR,
+                                 EDS_FW_FN_M_DIR | EDS_FW_FN_M_POST_0,
+                                 ShadowHandlerPriority,
+                                 (EDS_fwHandlerProcessRtn    )runShadowFilters,
+                                 (EDS_fwHandlerAssociateRtn  )NULL,
+                                 (EDS_fwHandlerSelectRtn     )NULL,
+                                 (EDS_fwHandlerFlushRtn      )NULL,
+                                 (EDS_fwHandlerDestructRtn   )NULL,
+                                 m_shadows);
+
+        EDS_fwHandlerChange(m_edsFw, EDS_FW_MASK(m_shadows->m_handlerId), EDS_FW_MASK(m_shadows->m_handlerId));
+    }
+
+    m_shadows->m_filters.push_back(ObfShadowFilter(filter, handlerId, schema->filter.rsd.nbytes));
+
+    int shadowIdx = m_shadows->m_filters.size() - 1;
+
+    selectShadowFilterMode(shadowIdx, mode, configIndex);
+
+    return shadowIdx;
+}
+
+void ObfInterface::selectShadowFilterMode(int shadowIdx, unsigned int mode, unsigned short int configIndex)
+{
+    if (shadowIdx < 0 || shadowIdx >= (int)m_shadows->m_filters.size()) return;
+
+    EFC* filter = m_shadows->m_filters[shadowIdx].m_efc;
+
+    EFC_modeAssociate(filter, mode, configIndex);
+    EFC_modeSelect   (filter, mode, NULL);
+
+    return;
+}
+
+void* ObfInterface::getShadowFilterPrm(int shadowIdx, int type)
+{
+    if (shadowIdx < 0 || shadowIdx >= (int)m_shadows->m_filters.size()) return 0;
+
+    return EFC_get(m_shadows->m_filters[shadowIdx].m_efc, (EFC_OBJECT_K)type);
+}
+
+bool ObfInterface::getShadowResult(int shadowIdx, unsigned char& sb, unsigned int* words, int nWords) const
+{
+    if (shadowIdx < 0 || shadowIdx >= (int)m_shadows->m_filters.size()) return false;
+
+    const ObfShadowFilter& shadow = m_shadows->m_filters[shadowIdx];
+
+    if (!shadow.m_valid) return false;
+
+    int maxWords = shadow.m_resultBytes / sizeof(unsigned int);
+
+    sb = shadow.m_sb;
+    for(int idx = 0; idx < nWords; idx++) words[idx] = idx < maxWords ? shadow.m_result[idx] : 0;
+
+    return true;
+}
+
+int ObfInterface::setupModeShadows()
+{
+    int nShadows = 0;
+
+    for(SchemaMap::const_iterator schemaIter = m_filterSchemas.begin(); schemaIter != m_filterSchemas.end(); schemaIter++)
+    {
+        ModeVecMap::const_iterator configIter = m_modeConfigs.find(schemaIter->first);
+
+        if (configIter == m_modeConfigs.end()) continue;
+
+        std::vector<int>& modeShadows = m_modeShadows[schemaIter->first];
+
+        modeShadows.assign(EFC_DB_MODE_K_CNT, -1);
+
+        for(unsigned int mode = 0; mode < EFC_DB_MODE_K_CNT; mode++)
+        {
+            int configuration = configIter->second[mode];
+
+            if (configuration < 0) continue;
+
+            modeShadows[mode] = setupShadowFilter(schemaIter->second, m_filterHandlerIds[schemaIter->first], mode, configuration);
+            nShadows++;
+        }
+    }
+
+    return nShadows;
+}
+
+bool ObfInterface::getModeResult(unsigned short int schemaId, unsigned int mode, unsigned char& sb) const
+{
+    ModeVecMap::const_iterator shadowIter = m_modeShadows.find(schemaId);
+
+    if (shadowIter == m_modeShadows.end() || mode >= shadowIter->second.size()) return false;
+
+    unsigned int status = 0;
+
+    return getShadowResult(shadowIter->second[mode], sb, &status, 1);
+}
+
 //void ObfInterface::setEovOutputCallBack(OutputRtn* outRtn)
-void ObfInterface::setEovOutputCallBack(IFilterTool* outRtn)
+bool ObfInterface::setAdaptiveOrder(const std::vector<unsigned short int>& schemaIds, PartialDecisionRtn decisionRtn, void* prm,
+                                    int verifyInterval, std::string& error)
+{
+    if (m_ordered)
+    {
+        error = "adaptive ordering is already set up";
+        return false;
+    }
+
+    if (!m_callBack->m_decisionRtn)
+    {
+        error = "adaptive ordering needs the accept decision";
+        return false;
+    }
+
+    if (schemaIds.size() > 32)
+    {
+        error = "at most 32 filters can be ordered";
+        return false;
+    }
+
+    ObfOrderedSweep* ordered = new ObfOrderedSweep(m_callBack, decisionRtn, prm, schemaIds.size(), verifyInterval);
+
+    unsigned int targets  = 0;
+    int          nOrdered = 0;
+
+    for(unsigned int idx = 0; idx < schemaIds.size(); idx++)
+    {
+        FilterMap::const_iterator    filterIter  = m_filterMap.find(schemaIds[idx]);
+        HandlerIdMap::const_iterator handlerIter = m_filterHandlerIds.find(schemaIds[idx]);
+
+        bool canOrder = filterIter != m_filterMap.end() && handlerIter != m_filterHandlerIds.end()
+                     && m_resultAdjusted.find(schemaIds[idx]) == m_resultAdjusted.end();
+
+        if (canOrder)
+        {
+            ordered->m_filters.push_back(ObfOrderedFilter(filterIter->second, handlerIter->second, getFilterTargetMask(schemaIds[idx])));
+
+            targets |= ordered->m_filters.back().m_target;
+            nOrdered++;
+        }
+        else
+        {
+            ordered->m_filters.push_back(ObfOrderedFilter(0, -1, 0));
+            ordered->m_order.leaveOut(idx);
+        }
+    }
+
+    if (nOrdered < (verifyInterval > 0 ? 2 : 1))
+    {
+        delete ordered;
+        error = verifyInterval > 0 ? "fewer than two filters can be ordered" : "no filter can be taken over";
+        return false;
+    }
+
+    ordered->m_handlerId = EDS_fwHandlerRegister (m_edsFw,
+                           OrderedHandlerId,
+                           EDS_FW_OBJ_M_DIR,
+                           EDS_FW_FN_M_DIR | EDS_FW_FN_M_POST_0,
+                           OrderedHandlerPriority,
+                           (EDS_fwHandlerProcessRtn    )runOrderedFilters,
+                           (EDS_fwHandlerAssociateRtn  )NULL,
+                           (EDS_fwHandlerSelectRtn     )NULL,
+                           (EDS_fwHandlerFlushRtn      )NULL,
+                           (EDS_fwHandlerDestructRtn   )NULL,
+                           ordered);
+
+    // The sweep takes over from the flight handlers
+    enableDisableFilter(targets, 0);
+    EDS_fwHandlerChange(m_edsFw, EDS_FW_MASK(ordered->m_handlerId), EDS_FW_MASK(ordered->m_handlerId));
+
+    m_ordered              = ordered;
+    m_callBack->m_ordered  = ordered;
+
+    return true;
+}
+
+bool ObfInterface::setPreDecision(PreDecisionRtn preDecisionRtn, void* prm)
+{
+    if (!m_ordered) return false;
+
+    m_ordered->m_preDecisionRtn = preDecisionRtn;
+    m_ordered->m_preDecisionPrm = prm;
+
+    return true;
+}
+
+const ObfAdaptiveOrder* ObfInterface::adaptiveOrder() const
+{
+    return m_ordered ? &m_ordered->m_order : 0;
+}
+
+void ObfInterface::setEovOutputCallBack(IFilterTool* outRtn, bool acceptedOnly)
+{
+    if (outRtn) (acceptedOnly ? m_callBack->m_acceptedOnlyVec : m_callBack->m_callBackVec).push_back(outRtn);
+
+    return;
+}
+
+void ObfInterface::setEovDecision(EovDecisionRtn decisionRtn, void* prm)
+{
+    m_callBack->m_decisionRtn = decisionRtn;
+    m_callBack->m_decisionPrm = prm;
+
+    return;
+}
+
+void ObfInterface::setEventClassNeeds(IFilterTool* outRtn, unsigned int eventClasses)
+{
+    if (outRtn) m_callBack->m_classNeeds[outRtn] = eventClasses;
+
+    return;
+}
+
+unsigned int ObfInterface::getEventClass() const
+{
+    return m_callBack->m_eventClass;
+}
+
+int ObfInterface::getOutputSkipped() const
+{
+    return m_callBack->m_outputSkipped;
+}
+
+bool ObfInterface::eventTimedOut() const
+{
+    return m_callBack->m_timedOut;
+}
+
+void ObfInterface::setSampleRate(IFilterTool* outRtn, const std::string& name, int rate, unsigned int targets)
+{
+    // Registered even at a rate of 1, it may still be throttled
+    if (outRtn) m_callBack->m_sampledVec.push_back(EOVCallBackParams::SampledRtn(outRtn, ObfSampler(name, rate, targets)));
+
+    // No handler means an output tool
+    if (outRtn && !targets) m_callBack->m_outputToolVec.push_back(outRtn);
+
+    return;
+}
+
+int ObfInterface::getSampleRate(unsigned short int schemaId) const
+{
+    SchemaToEnumMap::const_iterator enumIter = m_schemaToEnum.find(schemaId);
+
+    if (enumIter == m_schemaToEnum.end()) return 1;
+
+    std::vector<EOVCallBackParams::SampledRtn>& sampledVec = m_callBack->m_sampledVec;
+    for(std::vector<EOVCallBackParams::SampledRtn>::const_iterator sampledIter = sampledVec.begin(); sampledIter != sampledVec.end(); sampledIter++)
+    {
+        if (sampledIter->second.target() & EDS_FW_MASK(enumIter->second)) return sampledIter->second.rate();
+    }
+
+    return 1;
+}
+
+bool ObfInterface::prescalesEvents(unsigned short int schemaId)
+{
+    const EFC_sampler* sampler = (const EFC_sampler*)getFilterPrm(schemaId, EFC_OBJECT_K_SAMPLER);
+
+    if (!sampler) return false;
+
+    // A refresh of 0 is switched off, one of 1 passes every event whatever came before
+    if (sampler->prescale.in.refresh > 1 || sampler->prescale.out.refresh > 1) return true;
+
+    for(unsigned int bit = 0; bit < 32; bit++)
+    {
+        if ((sampler->prescale.enabled.all & (1u << bit)) && sampler->prescale.prescalers[bit].refresh > 1) return true;
+    }
+
+    return false;
+}
+
+void ObfInterface::setSampleThrottle(int throttle)
+{
+    std::vector<EOVCallBackParams::SampledRtn>& sampledVec = m_callBack->m_sampledVec;
+    for(std::vector<EOVCallBackParams::SampledRtn>::iterator sampledIter = sampledVec.begin(); sampledIter != sampledVec.end(); sampledIter++)
+    {
+        sampledIter->second.setThrottle(throttle);
+    }
+
+    return;
+}
+
+void ObfInterface::setSampleFixed(unsigned short int schemaId)
+{
+    SchemaToEnumMap::const_iterator enumIter = m_schemaToEnum.find(schemaId);
+
+    if (enumIter == m_schemaToEnum.end()) return;
+
+    std::vector<EOVCallBackParams::SampledRtn>& sampledVec = m_callBack->m_sampledVec;
+    for(std::vector<EOVCallBackParams::SampledRtn>::iterator sampledIter = sampledVec.begin(); sampledIter != sampledVec.end(); sampledIter++)
+    {
+        if (sampledIter->second.target() & EDS_FW_MASK(enumIter->second)) sampledIter->second.setFixed(true);
+    }
+
+    return;
+}
+
+void ObfInterface::selectSampledEvent(unsigned int run, unsigned long long event)
 {
-    if (outRtn) m_callBack->m_callBackVec.push_back(outRtn);
+    m_callBack->m_skippedVec.clear();
+
+    std::vector<EOVCallBackParams::SampledRtn>& sampledVec = m_callBack->m_sampledVec;
+    for(std::vector<EOVCallBackParams::SampledRtn>::iterator sampledIter = sampledVec.begin(); sampledIter != sampledVec.end(); sampledIter++)
+    {
+        ObfSampler& sampler  = sampledIter->second;
+        bool        previous = sampler.current();
+        bool        selected = sampler.select(run, event);
+
+        if (!selected) m_callBack->m_skippedVec.push_back(sampledIter->first);
+
+        // Switch a sampled filter on or off, only when that changes
+        if (sampler.target() && selected != previous) enableDisableFilter(sampler.target(), selected ? sampler.target() : 0);
+    }
+
+    return;
+}
+
+void ObfInterface::getSampling(std::vector<ObfSampler>& samplers) const
+{
+    samplers.clear();
+
+    std::vector<EOVCallBackParams::SampledRtn>& sampledVec = m_callBack->m_sampledVec;
+    for(std::vector<EOVCallBackParams::SampledRtn>::const_iterator sampledIter = sampledVec.begin(); sampledIter != sampledVec.end(); sampledIter++)
+    {
+        samplers.push_back(sampledIter->second);
+    }
+
+    return;
+}
+
+void ObfInterface::setEovOutputCallBack(EovCallBackRtn outRtn, void* prm)
+{
+    if (outRtn) m_callBack->m_rtnCallBackVec.push_back(EOVCallBackParams::EovCallBack(outRtn, prm));
 
     return;
 }
@@ -304,10 +879,132 @@ bool ObfInterface::setupPassThrough(void* prm)
 /* ---------------------------------------------------------------------- */
 bool ObfInterface::loadLibrary (std::string libraryName, std::string libraryPath, int verbosity)
 {
-  // For debugging, ignore input verbosity arg.  Always set to 1
-    verbosity = 1;   
     if (verbosity > 0) printf (" Loading: %s", libraryName.c_str());
 
+    std::string fullFileName = libraryFileName(libraryName, libraryPath);
+
+    // Several tools may ask for the same library, only load it once
+    bool loaded = false;
+
+    if (m_loader->loadAttempted(fullFileName, loaded))
+    {
+        if (verbosity > 0) printf (" (already loaded)\n\n");
+        return loaded;
+    }
+
+    // If the library is in the bundle then load the node local copy of it
+    std::string loadFileName = fullFileName;
+
+    if (const ObfLibraryBundle::Entry* entry = m_bundle ? m_bundle->find(fullFileName) : 0)
+    {
+        std::string error;
+        std::string cachedFileName = m_bundle->cachedFile(*entry, m_bundleCacheDir, error);
+
+        if (cachedFileName != "") loadFileName = cachedFileName;
+        else                      printf (" (bundle: %s)", error.c_str());
+    }
+
+    // call CDM to load the library
+    // Note that currently (12/4/06) cal_db will be zero even when library loads
+    CDM_Database* cal_db = CDM_loadDatabase (loadFileName.c_str(), 0);
+
+    // So whether it loaded is whether it is now mapped in
+    loaded = cal_db != NULL || ObfLibraryLoader::resident(loadFileName);
+
+    if (verbosity > 0) printf (!loaded ? " (FAILED)\n\n" : " (succeeded)\n\n");
+
+    m_loader->setLoaded(fullFileName, loaded, loadFileName);
+
+    return loaded;
+}
+
+void ObfInterface::prefetchLibraries(const std::vector<std::pair<std::string, std::string> >& libraries)
+{
+    std::vector<std::string> fileNames;
+
+    for(std::vector<std::pair<std::string, std::string> >::const_iterator libIter = libraries.begin(); libIter != libraries.end(); libIter++)
+    {
+        std::string fileName = libraryFileName(libIter->first, libIter->second);
+
+        // Those in the bundle do not come from the file system
+        if (!m_bundle || !m_bundle->find(fileName)) fileNames.push_back(fileName);
+    }
+
+    m_loader->prefetch(fileNames);
+
+    return;
+}
+
+void ObfInterface::prefetchFiles(const std::vector<std::string>& fileNames)
+{
+    std::vector<std::string> toRead;
+
+    for(std::vector<std::string>::const_iterator fileIter = fileNames.begin(); fileIter != fileNames.end(); fileIter++)
+    {
+        if (!m_bundle || !m_bundle->find(*fileIter)) toRead.push_back(*fileIter);
+    }
+
+    m_loader->prefetch(toRead);
+
+    return;
+}
+
+const std::vector<std::string>& ObfInterface::loadedLibraries() const
+{
+    return m_loader->loadOrder();
+}
+
+const std::vector<std::string>& ObfInterface::openedLibraries() const
+{
+    return m_loader->openedFiles();
+}
+
+const std::vector<int>* ObfInterface::getModeConfigs(unsigned short int schemaId) const
+{
+    ModeVecMap::const_iterator modeIter = m_modeConfigs.find(schemaId);
+
+    return modeIter != m_modeConfigs.end() ? &modeIter->second : 0;
+}
+
+void ObfInterface::setWarmStart(const ObfWarmStart& warmStart)
+{
+    delete m_warmStart;
+
+    m_warmStart = new ObfWarmStart(warmStart);
+
+    return;
+}
+
+bool ObfInterface::setLibraryBundle(const std::string& bundleFile, const std::string& cacheBase, std::string& error)
+{
+    std::string fileName = bundleFile;
+    facilities::Util::expandEnvVar(&fileName);
+
+    ObfLibraryBundle* bundle = new ObfLibraryBundle();
+
+    if (!bundle->open(fileName, error))
+    {
+        delete bundle;
+        return false;
+    }
+
+    // Cache on local disk, by default the temporary directory
+    std::string cacheDir = cacheBase;
+
+    if (cacheDir == "") cacheDir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+
+    facilities::Util::expandEnvVar(&cacheDir);
+
+    delete m_bundle;
+
+    m_bundle         = bundle;
+    m_bundleCacheDir = m_bundle->cacheDirectory(cacheDir);
+
+    return true;
+}
+
+std::string ObfInterface::libraryFileName(const std::string& libraryName, const std::string& libraryPath) const
+{
     std::string fullFileName = libraryPath != "" ? libraryPath + "/" : "";
 
     // Platform dependent section to paste it all together
@@ -320,19 +1017,19 @@ bool ObfInterface::loadLibrary (std::string libraryName, std::string libraryPath
     // Expand any environment variables that might be in the name
     facilities::Util::expandEnvVar(&fullFileName);
 
-    // call CDM to load the library
-    // Note that currently (12/4/06) cal_db will be zero even when library loads
-    CDM_Database* cal_db = CDM_loadDatabase (fullFileName.c_str(), 0);
-
-    if (verbosity > 0) printf (cal_db == NULL ? " (FAILED)\n\n" : " (succeeded)\n\n");
-
-    return cal_db != NULL;
+    return fullFileName;
 }
 
 const EFC_DB_Schema& ObfInterface::loadFilterLibs(IFilterLibs* filterLibs, int verbosity)
 {
     const std::string basePath = filterLibs->ConfigBasePath() + "/";
 
+    // Start reading the filter code and master configuration, they are loaded in that order
+    std::vector<std::pair<std::string, std::string> > libraries;
+    libraries.push_back(std::make_pair(filterLibs->FilterLibName(),    filterLibs->FilterLibPath()));
+    libraries.push_back(std::make_pair(filterLibs->MasterConfigName(), basePath + filterLibs->MasterConfigName()));
+    prefetchLibraries(libraries);
+
     // Load the library containing the filter code
     loadLibrary (filterLibs->FilterLibName(), filterLibs->FilterLibPath(), verbosity);
 
@@ -352,33 +1049,78 @@ const EFC_DB_Schema& ObfInterface::loadFilterLibs(IFilterLibs* filterLibs, int v
         master.filter.rsd.nbytes = 4;
     }
 
-    // Load any dependent libraries called for by the master configuration
-    for (int idx = 0; idx < master.filter.cnt; idx++)
+    // Remember where to find the configurations of this filter
+    m_filterLibs[master.filter.id] = filterLibs;
+
+    // Start reading the configurations that will be loaded, all of them or, if deferred,
+    // those the master configuration associates with a mode (Moot may add others later)
+    libraries.clear();
+
+    for (int idx = 0; idx < (m_deferConfigLoading ? EFC_DB_MODE_K_CNT : master.filter.cnt); idx++)
     {
-        SchemaPair pair(master.filter.id, master.filter.instances[idx]);
-            
-        //std::string& fileName = m_idToFile[pair];
+        SchemaPair pair(master.filter.id, m_deferConfigLoading ? master.filter.mode2cfg[idx] : master.filter.instances[idx]);
+
         IdToFileMap::const_iterator idIter = filterLibs->getIdToFileMap().find(pair);
-        if (idIter == filterLibs->getIdToFileMap().end())
+
+        if (idIter != filterLibs->getIdToFileMap().end())
+            libraries.push_back(std::make_pair(idIter->second, basePath + idIter->second));
+    }
+
+    prefetchLibraries(libraries);
+
+    // Load any dependent libraries called for by the master configuration, unless deferred
+    // until they are actually needed
+    if (!m_deferConfigLoading)
+    {
+        for (int idx = 0; idx < master.filter.cnt; idx++)
         {
-            std::stringstream errorString;
-            errorString << "Unable to find file for configuration: " << pair.second;
-            throw ObfException(errorString.str());
+            requireConfiguration(master.filter.id, master.filter.instances[idx]);
         }
+    }
+
+    return master;
+}
 
-        const std::string& fileName = idIter->second;
-        //#ifndef SCons
-        loadLibrary(fileName, basePath + fileName, verbosity);
-        //#else
-        //loadLibrary(fileName, filterLibs->FilterLibPath(), verbosity);
-        //#endif
+bool ObfInterface::loadConfiguration(unsigned short int schemaId, unsigned short int configIndex)
+{
+    SchemaPair pair(schemaId, configIndex);
+
+    // Already done?
+    if (m_loadedConfigs.find(pair) != m_loadedConfigs.end()) return true;
+
+    FilterLibsMap::const_iterator libsIter = m_filterLibs.find(schemaId);
+
+    // Filters not loaded through loadFilterLibs look after their own configurations
+    if (libsIter == m_filterLibs.end()) return true;
+
+    IFilterLibs* filterLibs = libsIter->second;
+
+    //std::string& fileName = m_idToFile[pair];
+    IdToFileMap::const_iterator idIter = filterLibs->getIdToFileMap().find(pair);
+    if (idIter == filterLibs->getIdToFileMap().end()) return false;
+
+    const std::string& fileName = idIter->second;
+    //#ifndef SCons
+    if (!loadLibrary(fileName, filterLibs->ConfigBasePath() + "/" + fileName, m_verbosity)) return false;
+    //#else
+    //loadLibrary(fileName, filterLibs->FilterLibPath(), verbosity);
+    //#endif
+
+    m_loadedConfigs.insert(pair);
 
-        // Look up the configruation
-        const EFC_DB_Schema* thisSchema = EFC_lookup (filterLibs->FilterSchema(), pair.second);
-        int j = 0;
+    return true;
+}
+
+void ObfInterface::requireConfiguration(unsigned short int schemaId, unsigned short int configIndex)
+{
+    if (!loadConfiguration(schemaId, configIndex))
+    {
+        std::stringstream errorString;
+        errorString << "Unable to find file for configuration: " << configIndex;
+        throw ObfException(errorString.str());
     }
 
-    return master;
+    return;
 }
 
 
@@ -392,21 +1134,29 @@ const EFC_DB_Schema& ObfInterface::loadFilterLibs(IFilterLibs* filterLibs, int v
                                                                           */
 /* ---------------------------------------------------------------------- */
 unsigned int ObfInterface::filterEvent(EbfWriterTds::Ebf* ebfData)
+{
+    // The following few lines will put the pointer to the data in 
+    // into a form which can be eaten by the fsw data handler
+    unsigned int  length;
+    char         *data = ebfData->get(length);
+
+    return filterEvent(data, length);
+}
+
+unsigned int ObfInterface::filterEvent(char* data, unsigned int length)
 {
     // Set everything on?
     unsigned int filterStatus = -1;
 
     // Event counter 
     m_eventCount++;
-    
-    // The following few lines will put the pointer to the data in 
-    // into a form which can be eaten by the fsw data handler
-    unsigned int  length;
-    char         *data = ebfData->get(length);
 
     // This can't happen (flw!)
     if(length==0) throw ObfException("Warning: Event has no EBF data. Ignoring...");
 
+    // Nor can this, unless called after dumpCounters
+    if (!m_edsFw) throw ObfException("Filter framework has been released, cannot process event");
+
     // The data variable points to the head of our EBF_ptks 
     // What follows here will create the EBF_pkts object in C++ (as opposed to C)
     unsigned int* dataPtr = (unsigned int*)data;
@@ -441,6 +1191,13 @@ unsigned int ObfInterface::filterEvent(EbfWriterTds::Ebf* ebfData)
 
     m_eventProcessed++;
 
+    // Shadow results are per event
+    m_shadows->clearResults();
+
+    // Start the watchdog
+    m_callBack->m_timedOut   = false;
+    m_callBack->m_deadlineNs = m_eventBudgetNs > 0 ? ObfPerfMonitor::wallTimeNs() + m_eventBudgetNs : 0;
+
     /* Start the event flow (do we need this?)*/
 //    ctx.result.beg = TMR_GET ();
 
@@ -471,7 +1228,21 @@ unsigned int ObfInterface::filterEvent(EbfWriterTds::Ebf* ebfData)
          | Must pull this information out of the packets before the 
          | calling the user else if might destroy it.
         */
+        unsigned int pktsSize = EBF__pktsSize (pkts);
+
         pkts = EBF__pktsNext (pkts);
+
+        // A corrupt packet length would have us loop for ever
+        if (EBF__pktsSize (pkts) >= pktsSize)
+        {
+            std::stringstream errorString;
+
+            m_eventBad++;
+
+            errorString << "Corrupt packet length in event, count " << m_eventCount;
+
+            throw ObfException(errorString.str());
+        }
             
         // Call the EDS handler which will call the filters in turn
         fate   = EDS_fwHandlerProcess (m_edsFw, edw.ui, pkt);
@@ -479,6 +1250,9 @@ unsigned int ObfInterface::filterEvent(EbfWriterTds::Ebf* ebfData)
         // As fate will have it...
         if (fate & LCBV_PKT_FATE_M_NO_MORE) break;
         if (fate & LCBV_PKT_FATE_M_ABORT  ) break;
+
+        // Out of time, give up on any further packets
+        if (m_callBack->timedOut()) break;
     }
 
     /* Flush the output  */
@@ -536,8 +1310,23 @@ void ObfInterface::dumpCounters()
     ////myOutputFlush (m_callBack, -1);
     ////m_log << m_callBack->m_defaultStream.str() << endreq;
 
+    // loop through the call back vector for End of Run processing
+    // Do this first, the tools may still want to look at the filter parameter blocks
+    OutputRtnVec& callBackVec = m_callBack->m_callBackVec;
+    for(OutputRtnVec::iterator callBackIter = callBackVec.begin(); callBackIter != callBackVec.end(); callBackIter++)
+    {
+        (*callBackIter)->eorProcessing();
+    }
+
+    OutputRtnVec& acceptedOnlyVec = m_callBack->m_acceptedOnlyVec;
+    for(OutputRtnVec::iterator callBackIter = acceptedOnlyVec.begin(); callBackIter != acceptedOnlyVec.end(); callBackIter++)
+    {
+        (*callBackIter)->eorProcessing();
+    }
+
     // No EFC_deconstruct to call 
-    free(m_edsFw);
+    if (m_edsFw) free(m_edsFw);
+    m_edsFw = 0;
 
     for(FilterMap::iterator filterIter = m_filterMap.begin(); filterIter != m_filterMap.end(); filterIter++)
     {
@@ -545,13 +1334,17 @@ void ObfInterface::dumpCounters()
         free(efc);
     }
 
-    // loop through the call back vector for End of Run processing
-    OutputRtnVec& callBackVec = m_callBack->m_callBackVec;
-    for(OutputRtnVec::iterator callBackIter = callBackVec.begin(); callBackIter != callBackVec.end(); callBackIter++)
+    m_filterMap.clear();
+
+    for(std::vector<ObfShadowFilter>::iterator shadowIter = m_shadows->m_filters.begin(); 
+        shadowIter != m_shadows->m_filters.end(); shadowIter++)
     {
-        (*callBackIter)->eorProcessing();
+        free(shadowIter->m_efc);
     }
 
+    m_shadows->m_filters.clear();
+    m_modeShadows.clear();
+
     return;
 }
 
@@ -560,16 +1353,56 @@ void extractFilterInfo (EOVCallBackParams* callBack, EDS_fwIxb *ixb)
 {
     // loop through the call back vector 
     OutputRtnVec& callBackVec = callBack->m_callBackVec;
+
+    // Decide now whether the output tools still have time
+    callBack->timedOut();
+
+    // Classify the event once from the contributors in its directory
+    const EBF_dir* dir = ixb->blk.evt.dir;
+
+    callBack->m_eventClass = 0;
+    if (EBF_DIR_TEMS_TKR(dir->redux.ctids)) callBack->m_eventClass |= ObfInterface::TkrEvent;
+    if (EBF_DIR_TEMS_CAL(dir->redux.ctids)) callBack->m_eventClass |= ObfInterface::CalEvent;
+
     for(OutputRtnVec::iterator callBackIter = callBackVec.begin(); callBackIter != callBackVec.end(); callBackIter++)
     {
+        // Sampled and not selected this event, or out of time?
+        if (callBack->skipped(*callBackIter)) continue;
+
         try{
-        (*callBackIter)->eoeProcessing(ixb);
+        callBack->run(*callBackIter, ixb);
         }
         catch(...)
         {
             int j = 0;
         }
     }
+
+    // And any plain function call backs
+    std::vector<EOVCallBackParams::EovCallBack>& rtnCallBackVec = callBack->m_rtnCallBackVec;
+    for(std::vector<EOVCallBackParams::EovCallBack>::iterator rtnIter = rtnCallBackVec.begin(); rtnIter != rtnCallBackVec.end(); rtnIter++)
+    {
+        rtnIter->first(rtnIter->second, ixb);
+    }
+
+    // Check the adaptive order against the decision
+    if (callBack->m_ordered) callBack->m_ordered->endEvent();
+
+    // The filter results are all out now, the expensive output is only wanted for accepted events
+    // and not at all once out of time
+    OutputRtnVec& acceptedOnlyVec = callBack->m_acceptedOnlyVec;
+    if (!acceptedOnlyVec.empty() && !callBack->timedOut())
+    {
+        if (!callBack->m_decisionRtn || callBack->m_decisionRtn(callBack->m_decisionPrm))
+        {
+            for(OutputRtnVec::iterator callBackIter = acceptedOnlyVec.begin(); callBackIter != acceptedOnlyVec.end(); callBackIter++)
+            {
+                if (!callBack->skipped(*callBackIter)) callBack->run(*callBackIter, ixb);
+            }
+        }
+        else callBack->m_outputSkipped++;
+    }
+
     return;
 }
 
@@ -627,6 +1460,143 @@ int passThrough (void        *unused,
 }
 
 
+/* ---------------------------------------------------------------------- *//*!
+
+  \fn     static int runShadowFilters (ObfShadowList  *shadows,
+                                       unsigned int    nbytes,
+                                       EBF_pkt           *pkt,
+                                       EBF_siv            siv,
+                                       EDS_fwIxb         *ixb)
+  \brief  Runs each shadow filter on the packet, keeping its result and 
+          restoring the result descriptor of the flight filter it shadows
+
+  \param  shadows The list of shadow filters
+  \param  nbytes  Number of bytes in the packet
+  \param  pkt     The event packet
+  \param  siv     The state information vector
+  \param  ixb     The EDS framework information exchange block
+                                                                          */
+/* ---------------------------------------------------------------------- */
+int runShadowFilters (ObfShadowList *shadows,
+                      unsigned int   nbytes,
+                      EBF_pkt          *pkt,
+                      EBF_siv           siv,
+                      EDS_fwIxb        *ixb)
+{
+    unsigned char saveResult[ObfShadowFilter::MaxResultBytes];
+
+    for(std::vector<ObfShadowFilter>::iterator shadowIter = shadows->m_filters.begin(); 
+        shadowIter != shadows->m_filters.end(); shadowIter++)
+    {
+        EDS_rsdDsc* rsdDsc  = ixb->rsd.dscs + shadowIter->m_handlerId;
+        EDS_rsdDsc  saveDsc = *rsdDsc;
+
+        if (rsdDsc->ptr) memcpy(saveResult, rsdDsc->ptr, shadowIter->m_resultBytes);
+
+        EFC_filter(shadowIter->m_efc, nbytes, pkt, siv, ixb, shadowIter->m_handlerId);
+
+        // Keep the shadow's result
+        shadowIter->m_sb    = rsdDsc->sb;
+        shadowIter->m_valid = true;
+        if (rsdDsc->ptr) memcpy(shadowIter->m_result, rsdDsc->ptr, shadowIter->m_resultBytes);
+
+        // Put back the flight filter's result
+        if (saveDsc.ptr) memcpy(saveDsc.ptr, saveResult, shadowIter->m_resultBytes);
+        *rsdDsc = saveDsc;
+    }
+
+    return EDS_FW_FN_M_POST_0;
+}
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \fn     static int runOrderedFilters (ObfOrderedSweep *ordered,
+                                        unsigned int     nbytes,
+                                        EBF_pkt            *pkt,
+                                        EBF_siv             siv,
+                                        EDS_fwIxb          *ixb)
+  \brief  Runs the ordered filters on the packet, cheapest first, until the 
+          accept decision is fixed. A full event runs them all
+
+  \param  ordered The ordered filters
+  \param  nbytes  Number of bytes in the packet
+  \param  pkt     The event packet
+  \param  siv     The state information vector
+  \param  ixb     The EDS framework information exchange block
+                                                                          */
+/* ---------------------------------------------------------------------- */
+int runOrderedFilters (ObfOrderedSweep *ordered,
+                       unsigned int     nbytes,
+                       EBF_pkt            *pkt,
+                       EBF_siv             siv,
+                       EDS_fwIxb          *ixb)
+{
+    ObfAdaptiveOrder& order      = ordered->m_order;
+    bool              fullEvent  = order.startEvent();
+    unsigned int      ranFilters = 0;
+    unsigned int      leftOut    = 0;
+
+    ordered->m_earlyDecided = false;
+    ordered->m_decisive     = 0;
+
+    // Nothing to run if decided beforehand, but an event checking the order runs in full
+    bool preDecided = ordered->m_preDecisionRtn && !(fullEvent && order.enabled()) 
+                   && ordered->m_preDecisionRtn(ordered->m_preDecisionPrm, ixb);
+
+    for(std::vector<int>::const_iterator orderIter = order.order().begin(); orderIter != order.order().end(); orderIter++)
+    {
+        ObfOrderedFilter& filter = ordered->m_filters[*orderIter];
+
+        if (preDecided || (ordered->m_earlyDecided && !fullEvent))
+        {
+            order.addSkipped(*orderIter);
+            leftOut |= filter.m_target;
+            continue;
+        }
+
+        long long startNs = ObfPerfMonitor::wallTimeNs();
+
+        EFC_filter(filter.m_efc, nbytes, pkt, siv, ixb, filter.m_handlerId);
+
+        order.addRun(*orderIter, ObfPerfMonitor::wallTimeNs() - startNs);
+
+        unsigned char sb = ixb->rsd.dscs[filter.m_handlerId].sb;
+
+        ordered->m_sbs[*orderIter] = sb;
+        ranFilters |= 1 << *orderIter;
+
+        if (!ordered->m_earlyDecided)
+            ordered->m_earlyDecided = ordered->m_decisionRtn(ordered->m_decisionPrm, ranFilters, ordered->m_sbs, ordered->m_earlyDecision);
+    }
+
+    // What each filter settles on its own
+    if (fullEvent && order.enabled())
+    {
+        for(std::vector<int>::const_iterator orderIter = order.order().begin(); orderIter != order.order().end(); orderIter++)
+        {
+            bool decision = false;
+
+            if (ordered->m_decisionRtn(ordered->m_decisionPrm, 1 << *orderIter, ordered->m_sbs, decision)) ordered->m_decisive |= 1 << *orderIter;
+        }
+    }
+
+    // The output routines of the filters left out have no result to look at
+    if (leftOut)
+    {
+        EOVCallBackParams* callBack = ordered->m_callBack;
+
+        for(std::vector<EOVCallBackParams::SampledRtn>::const_iterator sampledIter = callBack->m_sampledVec.begin(); 
+            sampledIter != callBack->m_sampledVec.end(); sampledIter++)
+        {
+            if (sampledIter->second.target() & leftOut) callBack->m_skippedVec.push_back(sampledIter->first);
+        }
+    }
+
+    return EDS_FW_FN_M_POST_0;
+}
+
+
 /* ---------------------------------------------------------------------- *//*!
 
   \fn     static int streamFlush (Stream *stream, int reason)
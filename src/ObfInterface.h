@@ -17,6 +17,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <set>
 #include <exception>
 
 // Forward declarations
@@ -29,6 +30,17 @@ namespace EbfWriterTds {
 }
 
 class EOVCallBackParams;
+class ObfShadowList;
+class ObfLibraryLoader;
+class ObfLibraryBundle;
+class ObfWarmStart;
+class ObfSampler;
+class ObfOrderedSweep;
+class ObfAdaptiveOrder;
+
+#ifndef EDS_fwIxb 
+    typedef struct _EDS_fwIxb EDS_fwIxb;
+#endif
 class IFilterTool;
 class IFilterLibs;
 
@@ -65,13 +77,72 @@ public:
     /// Set up the specific passthrough filter
     bool setupPassThrough(void* prm);
 
-    /// Set a call back routine for end of event output processing
-    void setEovOutputCallBack(IFilterTool* outRtn);
+    /// Set a call back routine for end of event output processing. If acceptedOnly it is only
+    /// called for events the decision routine (below) accepts, after all the other call backs
+    void setEovOutputCallBack(IFilterTool* outRtn, bool acceptedOnly = false);
+
+    /// Routine deciding whether an event is accepted, called at end of event once the filter
+    /// results are out. Without one every "accepted only" call back is always called
+    typedef bool (*EovDecisionRtn)(void* prm);
+    void setEovDecision(EovDecisionRtn decisionRtn, void* prm);
+
+    /// Number of events the "accepted only" call backs were skipped for
+    int getOutputSkipped() const;
+
+    /// Only call an output routine for a 1 in rate subset of the events (see ObfSampler.h). For a
+    /// filter also give its handler mask, the filter is then switched off for the other events
+    void setSampleRate(IFilterTool* outRtn, const std::string& name, int rate, unsigned int targets = 0);
+
+    /// Sample rate of a filter, 1 if it runs on every event
+    int  getSampleRate(unsigned short int schemaId) const;
+
+    /// Does a filter prescale events in its current mode? A prescaler with a refresh above 1 counts
+    /// the events its filter sees, so which events it passes depends on the filter seeing them all
+    bool prescalesEvents(unsigned short int schemaId);
+
+    /// Multiply the sample rates of all but the fixed output routines by a throttle factor
+    void setSampleThrottle(int throttle);
+
+    /// Never throttle this filter, e.g. because the accept decision depends on it
+    void setSampleFixed(unsigned short int schemaId);
+
+    /// Select the sampled filters and output routines for the next event
+    void selectSampledEvent(unsigned int run, unsigned long long event);
+
+    /// Sampling counts, for reweighting
+    void getSampling(std::vector<ObfSampler>& samplers) const;
+
+    /// Time limit per event, 0 for none. Once it is passed no further packets of the event are
+    /// given to the filters and the output tools are skipped, so the filter results (and the
+    /// decision) are all an event which runs out of time gets. A filter handler already running
+    /// is not interrupted
+    void setEventTimeBudget(long long budgetNs) {m_eventBudgetNs = budgetNs;}
+
+    /// Did the last event run out of time?
+    bool eventTimedOut() const;
+
+    /// Classes of event, by the contributors the event's directory lists
+    enum EventClass {TkrEvent = 0x1,    ///< At least one tower with tracker data
+                     CalEvent = 0x2};   ///< At least one tower with calorimeter data
+
+    /// An output routine only needs events of (any of) the given classes, for other events its
+    /// eoeBypassed is called instead of eoeProcessing. The default is every event
+    void setEventClassNeeds(IFilterTool* outRtn, unsigned int eventClasses);
+
+    /// Classes of the last event
+    unsigned int getEventClass() const;
+
+    /// Plain function version of the above for use outside of Gaudi, called after the tools
+    typedef void (*EovCallBackRtn)(void* prm, EDS_fwIxb* ixb);
+    void setEovOutputCallBack(EovCallBackRtn outRtn, void* prm);
 
     /// This will cause the filters to execute upon the given event
     /// Results will appear in the provided TDS output objects
     unsigned int filterEvent(EbfWriterTds::Ebf* ebfData);
 
+    /// Same for an event given as a buffer of EBF packets
+    unsigned int filterEvent(char* data, unsigned int length);
+
     /// Return a pointer to a given filter's parameter block of the requested type
     /// (must be typed by the user)
     void* getFilterPrm(unsigned short filterSchemaId, int type);
@@ -79,13 +150,102 @@ public:
     /// Return a "target" mask given a filter's schema id
     unsigned int getFilterTargetMask(unsigned short int schemaId) const;
 
+    ///@name shadow filters
+    /// Set up a "shadow" copy of an already registered filter. A shadow is constructed exactly 
+    /// as the flight filter but is not registered with EDS_fw, instead it is run on each packet 
+    /// by a sweep handler after the flight filters so it sees the same unpacked event. Its result
+    /// is collected and the flight filter's result descriptor restored. Returns the shadow index
+    int  setupShadowFilter(const EFC_DB_Schema* schema, int handlerId, unsigned int mode, unsigned short int configIndex);
+
+    /// Put a shadow filter into the given mode/configuration
+    void selectShadowFilterMode(int shadowIdx, unsigned int mode, unsigned short int configIndex);
+
+    /// Return a pointer to a shadow filter's parameter block of the requested type
+    void* getShadowFilterPrm(int shadowIdx, int type);
+
+    /// Retrieve the result of a shadow filter for the current event, returns false if it did not run.
+    /// Up to nWords of the result are copied to words, the first is the filter status word.
+    bool getShadowResult(int shadowIdx, unsigned char& sb, unsigned int* words, int nWords) const;
+
+    /// Set up a shadow for every filter and every mode which has a configuration associated,
+    /// so each event is evaluated under all modes at once. Returns the number of shadows
+    int  setupModeShadows();
+
+    /// Retrieve the summary byte a filter would have given the current event in a given mode,
+    /// returns false if there is no shadow for that filter and mode or it did not run
+    bool getModeResult(unsigned short int schemaId, unsigned int mode, unsigned char& sb) const;
+
+    ///@name adaptive ordering
+    /// Routine telling whether the accept decision is already fixed by the filters run so far.
+    /// Filter n (index in the list given to setAdaptiveOrder) ran if bit n of ranFilters is set,
+    /// its summary byte is sbs[n]. If fixed returns true with the decision
+    typedef bool (*PartialDecisionRtn)(void* prm, unsigned int ranFilters, const unsigned char* sbs, bool& decision);
+
+    /// Run the listed filters (up to 32, by schema id) from a sweep handler instead of as flight
+    /// handlers, cheapest first, stopping once the decision routine finds the decision fixed.
+    /// The output routines of a filter left out are skipped for the event. Every verifyInterval-th
+    /// event runs all of them to measure their cost and check the early stop against the accept
+    /// decision (see setEovDecision, which must be set); the order is then revised. A verifyInterval
+    /// of 0 runs them all, in the order given, on every event. Filters not set up, or with results
+    /// adjusted (below), are left as they are. Returns false with a message if fewer than two
+    /// filters (one for a fixed order) can be taken over
+    bool setAdaptiveOrder(const std::vector<unsigned short int>& schemaIds, PartialDecisionRtn decisionRtn, void* prm,
+                          int verifyInterval, std::string& error);
+
+    /// Routine run ahead of the ordered filters, on every event but those checking the order.
+    /// If it decides the event (returning true) none of them run and their output routines are
+    /// skipped. Needs setAdaptiveOrder first, returns false otherwise
+    typedef bool (*PreDecisionRtn)(void* prm, EDS_fwIxb* ixb);
+    bool setPreDecision(PreDecisionRtn preDecisionRtn, void* prm);
+
+    /// Statistics of the adaptive ordering, indexed as the list given, 0 if not set up
+    const ObfAdaptiveOrder* adaptiveOrder() const;
+
+    /// The output routine of a filter changes its summary byte before recording it, so the
+    /// raw result cannot tell whether the decision is fixed
+    void setResultAdjusted(unsigned short int schemaId) {m_resultAdjusted.insert(schemaId);}
+
     ///@name other methods
-    /// Load shareable libraries
+    /// Load shareable libraries, a library already loaded is not loaded again
     bool loadLibrary(std::string libraryName, std::string libraryPath = "", int verbosity = 0);
 
+    /// Start reading (name, path) libraries in the background ahead of loading them
+    void prefetchLibraries(const std::vector<std::pair<std::string, std::string> >& libraries);
+
+    /// Load libraries found in a bundle (see ObfLibraryBundle.h) from their copies in a node
+    /// local cache under cacheBase (default $TMPDIR or /tmp) rather than from their own paths.
+    /// Set before loading any library, returns false with a message if the bundle is unusable
+    bool setLibraryBundle(const std::string& bundleFile, const std::string& cacheBase, std::string& error);
+
+    /// Start reading already resolved library files in the background
+    void prefetchFiles(const std::vector<std::string>& fileNames);
+
+    /// Library files loaded so far, in load order
+    const std::vector<std::string>& loadedLibraries() const;
+
+    /// The file actually opened for each of loadedLibraries (a node local copy for bundled ones)
+    const std::vector<std::string>& openedLibraries() const;
+
+    /// Configuration associated with each mode (-1 if none) for a filter, 0 if none set up
+    const std::vector<int>* getModeConfigs(unsigned short int schemaId) const;
+
+    /// Warm start snapshot (see ObfWarmStart.h) for the filter tools to set up from, if any.
+    /// A copy is kept
+    void setWarmStart(const ObfWarmStart& warmStart);
+    const ObfWarmStart* warmStart() const {return m_warmStart;}
+
     ///@name other methods
     /// Load shareable libraries
     const EFC_DB_Schema& loadFilterLibs(IFilterLibs* filterLibs, int verbosity = 0);
+
+    /// If set, loadFilterLibs only loads the filter and its master configuration. The library
+    /// of a configuration instance is then loaded when it is first set up or associated with
+    /// a mode, so instances no mode uses are never loaded. Set before loading any filter
+    void setDeferConfigLoading(bool defer) {m_deferConfigLoading = defer;}
+
+    /// Make sure the library of a filter configuration instance is loaded, returns false if
+    /// the filter's libraries do not list a file for it or the file does not load
+    bool loadConfiguration(unsigned short int schemaId, unsigned short int configIndex);
     
     // Output status of counters
     void dumpCounters();
@@ -96,9 +256,15 @@ private:
     // constructor
     ObfInterface();
 
+    // As loadConfiguration, but throws an ObfException if it cannot be loaded
+    void requireConfiguration(unsigned short int schemaId, unsigned short int configIndex);
+
     // destructor
     virtual ~ObfInterface();
 
+    // Full file name of a library, as loaded by loadLibrary
+    std::string libraryFileName(const std::string& libraryName, const std::string& libraryPath) const;
+
     // Pointer to me
     static ObfInterface* m_instance;
 
@@ -108,6 +274,13 @@ private:
     // Keep track of "priority" for each filter
     int                  m_priority;
 
+    // Deferred loading of the configuration libraries, the filter library information of
+    // each filter by schema id and the instances loaded so far
+    bool                 m_deferConfigLoading;
+    typedef std::map<unsigned short int, IFilterLibs*> FilterLibsMap;
+    FilterLibsMap        m_filterLibs;
+    std::set<std::pair<unsigned short int, unsigned short int> > m_loadedConfigs;
+
     // pointers to FSW structures
     EDS_fw              *m_edsFw;
 
@@ -115,6 +288,17 @@ private:
     typedef std::map<unsigned short int, EFC*> FilterMap;
     FilterMap            m_filterMap;
 
+    // Schema and handler id of each initialized filter, needed to shadow it
+    typedef std::map<unsigned short int, const EFC_DB_Schema*> SchemaMap;
+    SchemaMap            m_filterSchemas;
+    typedef std::map<unsigned short int, int> HandlerIdMap;
+    HandlerIdMap         m_filterHandlerIds;
+
+    // Configuration associated with each mode (-1 if none) and the mode shadow index, by schema id
+    typedef std::map<unsigned short int, std::vector<int> > ModeVecMap;
+    ModeVecMap           m_modeConfigs;
+    ModeVecMap           m_modeShadows;
+
     // Map file name to EH_id enum value
     typedef std::map<unsigned short int, unsigned int> SchemaToEnumMap;
     SchemaToEnumMap      m_schemaToEnum;
@@ -122,6 +306,26 @@ private:
     // Map to control the list of filter output routines
     EOVCallBackParams*   m_callBack;
 
+    // Shadow filters run by the sweep handler
+    ObfShadowList*       m_shadows;
+
+    // Filters run in adaptive order, if any, and those which cannot be
+    ObfOrderedSweep*     m_ordered;
+    std::set<unsigned short int> m_resultAdjusted;
+
+    // Registry of the loaded libraries, and their prefetching
+    ObfLibraryLoader*    m_loader;
+
+    // Library bundle, if any, and where its libraries are cached on this node
+    ObfLibraryBundle*    m_bundle;
+    std::string          m_bundleCacheDir;
+
+    // Warm start snapshot, if any
+    ObfWarmStart*        m_warmStart;
+
+    // Time limit per event
+    long long            m_eventBudgetNs;
+
     // Counters, run type data, etc.
     int                  m_eventCount;
     int                  m_eventProcessed;
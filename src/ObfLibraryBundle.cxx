@@ -0,0 +1,318 @@
+/**  @file ObfLibraryBundle.cxx
+    @brief implementation of class ObfLibraryBundle
+
+  $Header$
+*/
+
+#include "ObfLibraryBundle.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#ifndef _WIN32
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+#endif
+
+namespace
+{
+    const char bundleMagic[8] = {'O', 'B', 'F', 'B', 'N', 'D', 'L', 0};
+
+    // File name part of a path
+    std::string baseName(const std::string& path)
+    {
+        std::string::size_type slash = path.find_last_of("/\\");
+
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    unsigned long long pageAlign(unsigned long long offset)
+    {
+        return (offset + ObfLibraryBundle::PageSize - 1) / ObfLibraryBundle::PageSize * ObfLibraryBundle::PageSize;
+    }
+
+    bool readFile(const std::string& fileName, std::vector<char>& data)
+    {
+        FILE* file = fopen(fileName.c_str(), "rb");
+
+        if (!file) return false;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        data.resize(size);
+
+        bool ok = size == 0 || fread(&data[0], 1, size, file) == (size_t)size;
+
+        fclose(file);
+
+        return ok;
+    }
+}
+
+ObfLibraryBundle::ObfLibraryBundle() : m_base(0), m_size(0), m_header(0), m_entries(0)
+{
+}
+
+ObfLibraryBundle::~ObfLibraryBundle()
+{
+    close();
+}
+
+unsigned long long ObfLibraryBundle::hash(const char* data, unsigned long long size, unsigned long long seed)
+{
+    unsigned long long value = seed;
+
+    for(unsigned long long idx = 0; idx < size; idx++)
+    {
+        value ^= (unsigned char)data[idx];
+        value *= 1099511628211ULL;
+    }
+
+    return value;
+}
+
+bool ObfLibraryBundle::write(const std::string& bundleFile, const std::string& release,
+                             const std::vector<std::string>& libraryFiles, std::string& error)
+{
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, bundleMagic, sizeof(header.magic));
+    header.version  = CurrentVersion;
+    header.nEntries = libraryFiles.size();
+    strncpy(header.release, release.c_str(), ReleaseSize - 1);
+
+    std::vector<Entry>             entries(libraryFiles.size());
+    std::vector<std::vector<char> > images(libraryFiles.size());
+
+    unsigned long long offset = pageAlign(sizeof(Header) + libraryFiles.size() * sizeof(Entry));
+
+    header.hash = hash(release.c_str(), release.size());
+
+    for(unsigned int idx = 0; idx < libraryFiles.size(); idx++)
+    {
+        std::string name = baseName(libraryFiles[idx]);
+
+        if (name.size() >= NameSize)
+        {
+            error = "library name too long: " + name;
+            return false;
+        }
+
+        for(unsigned int prev = 0; prev < idx; prev++)
+        {
+            if (name == entries[prev].name)
+            {
+                error = "library " + name + " given twice";
+                return false;
+            }
+        }
+
+        if (!readFile(libraryFiles[idx], images[idx]))
+        {
+            error = "cannot read " + libraryFiles[idx];
+            return false;
+        }
+
+        memset(&entries[idx], 0, sizeof(Entry));
+        strcpy(entries[idx].name, name.c_str());
+        entries[idx].offset = offset;
+        entries[idx].size   = images[idx].size();
+        entries[idx].hash   = hash(images[idx].empty() ? 0 : &images[idx][0], images[idx].size());
+
+        header.hash = hash((const char*)&entries[idx].hash, sizeof(entries[idx].hash), header.hash);
+
+        offset = pageAlign(offset + entries[idx].size);
+    }
+
+    FILE* file = fopen(bundleFile.c_str(), "wb");
+
+    if (!file)
+    {
+        error = "cannot create " + bundleFile;
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    if (ok && !entries.empty()) ok = fwrite(&entries[0], sizeof(Entry), entries.size(), file) == entries.size();
+
+    for(unsigned int idx = 0; ok && idx < images.size(); idx++)
+    {
+        // Pad up to the page boundary
+        ok = fseek(file, entries[idx].offset, SEEK_SET) == 0;
+
+        if (ok && !images[idx].empty()) ok = fwrite(&images[idx][0], 1, images[idx].size(), file) == images[idx].size();
+    }
+
+    if (fclose(file) != 0) ok = false;
+
+    if (!ok) error = "error writing " + bundleFile;
+
+    return ok;
+}
+
+bool ObfLibraryBundle::open(const std::string& bundleFile, std::string& error)
+{
+    close();
+
+#ifdef _WIN32
+    error = "library bundles are not supported on this platform";
+    return false;
+#else
+    int fd = ::open(bundleFile.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        error = "cannot open " + bundleFile;
+        return false;
+    }
+
+    struct stat fileStat;
+
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(Header))
+    {
+        ::close(fd);
+        error = bundleFile + " is not a library bundle";
+        return false;
+    }
+
+    void* base = mmap(0, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if (base == MAP_FAILED)
+    {
+        error = "cannot map " + bundleFile;
+        return false;
+    }
+
+    m_base    = (const char*)base;
+    m_size    = fileStat.st_size;
+    m_header  = (const Header*)m_base;
+    m_entries = (const Entry*)(m_base + sizeof(Header));
+
+    // Check it all hangs together before anything is used
+    bool valid = memcmp(m_header->magic, bundleMagic, sizeof(bundleMagic)) == 0
+              && m_header->version == CurrentVersion
+              && sizeof(Header) + (unsigned long long)m_header->nEntries * sizeof(Entry) <= m_size;
+
+    for(unsigned int idx = 0; valid && idx < m_header->nEntries; idx++)
+    {
+        valid = m_entries[idx].offset + m_entries[idx].size <= m_size && memchr(m_entries[idx].name, 0, NameSize) != 0;
+    }
+
+    if (!valid)
+    {
+        close();
+        error = bundleFile + " is not a valid library bundle";
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+void ObfLibraryBundle::close()
+{
+#ifndef _WIN32
+    if (m_base) munmap((void*)m_base, m_size);
+#endif
+
+    m_base    = 0;
+    m_size    = 0;
+    m_header  = 0;
+    m_entries = 0;
+
+    return;
+}
+
+const ObfLibraryBundle::Entry* ObfLibraryBundle::find(const std::string& libraryFile) const
+{
+    if (!m_header) return 0;
+
+    std::string name = baseName(libraryFile);
+
+    for(unsigned int idx = 0; idx < m_header->nEntries; idx++)
+    {
+        if (name == m_entries[idx].name) return m_entries + idx;
+    }
+
+    return 0;
+}
+
+std::string ObfLibraryBundle::cacheDirectory(const std::string& base) const
+{
+    std::ostringstream dirName;
+
+    dirName << base << "/obf-" << m_header->release << "-" << std::hex << std::setw(16) << std::setfill('0') << m_header->hash;
+
+    return dirName.str();
+}
+
+std::string ObfLibraryBundle::cachedFile(const Entry& entry, const std::string& cacheDir, std::string& error) const
+{
+#ifdef _WIN32
+    error = "library bundles are not supported on this platform";
+    return "";
+#else
+    std::string fileName = cacheDir + "/" + entry.name;
+
+    // Already there from an earlier job or another worker on this node?
+    struct stat fileStat;
+
+    if (stat(fileName.c_str(), &fileStat) == 0 && (unsigned long long)fileStat.st_size == entry.size) return fileName;
+
+    if (mkdir(cacheDir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        error = "cannot create cache directory " + cacheDir;
+        return "";
+    }
+
+    if (hash(image(entry), entry.size) != entry.hash)
+    {
+        error = std::string("corrupt image of ") + entry.name + " in the bundle";
+        return "";
+    }
+
+    std::ostringstream tempName;
+    tempName << cacheDir << "/." << entry.name << "." << getpid();
+
+    int fd = ::open(tempName.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
+
+    if (fd < 0)
+    {
+        error = "cannot write to cache directory " + cacheDir;
+        return "";
+    }
+
+    const char*        data      = image(entry);
+    unsigned long long remaining = entry.size;
+
+    while(remaining > 0)
+    {
+        ssize_t written = ::write(fd, data, remaining);
+
+        if (written <= 0) break;
+
+        data      += written;
+        remaining -= written;
+    }
+
+    if (::close(fd) != 0 || remaining > 0 || rename(tempName.str().c_str(), fileName.c_str()) != 0)
+    {
+        unlink(tempName.str().c_str());
+        error = "cannot write " + fileName;
+        return "";
+    }
+
+    return fileName;
+#endif
+}
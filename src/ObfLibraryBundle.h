@@ -0,0 +1,102 @@
+/** @file ObfLibraryBundle.h
+*
+* @class ObfLibraryBundle
+*
+* @brief A single file holding all the FSW libraries a job loads (filter code, master and
+*        instance configurations, calibration and geometry databases), so that a job reads
+*        one file from the shared file system instead of opening dozens of libraries.
+*
+*        The CDM databases cannot be serialized themselves: they are loaded by the dynamic
+*        linker, contain relocated pointers and register themselves with CDM and CMX from
+*        their constructors. The bundle therefore carries the library images unchanged.
+*        At startup the bundle is mapped read-only and each library is written, once per
+*        node, to a node-local cache directory named after the release and the bundle's
+*        content hash. Every worker on the node then loads the same local files, so the
+*        library pages are shared through the page cache.
+*
+*        Layout: an ObfLibraryBundle::Header, nEntries Entry records, then each library
+*        image starting on a page boundary. Entries are looked up by library file name
+*        (e.g. "libgamma_normal.so"), which must be unique within a bundle.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfLibraryBundle_H
+#define __ObfLibraryBundle_H
+
+#include <string>
+#include <vector>
+
+class ObfLibraryBundle
+{
+public:
+    enum {CurrentVersion = 1, PageSize = 4096, NameSize = 120, ReleaseSize = 32};
+
+    /// File header
+    class Header
+    {
+    public:
+        char               magic[8];                 ///< "OBFBNDL\0"
+        unsigned int       version;
+        unsigned int       nEntries;
+        unsigned long long hash;                     ///< Hash of all library images
+        char               release[ReleaseSize];     ///< FSW release the libraries belong to
+    };
+
+    /// Index record, one per library
+    class Entry
+    {
+    public:
+        char               name[NameSize];           ///< Library file name, no directory
+        unsigned long long offset;                   ///< Start of the image in the bundle
+        unsigned long long size;                     ///< Size of the image
+        unsigned long long hash;                     ///< Hash of the image
+    };
+
+    ObfLibraryBundle();
+    ~ObfLibraryBundle();
+
+    /// Write a bundle of the given library files, returns false with a message on failure
+    static bool write(const std::string& bundleFile, const std::string& release,
+                      const std::vector<std::string>& libraryFiles, std::string& error);
+
+    /// Map a bundle read-only, returns false with a message on failure
+    bool open(const std::string& bundleFile, std::string& error);
+
+    /// Release the mapping
+    void close();
+
+    bool               isOpen()   const {return m_header != 0;}
+    const Header&      header()   const {return *m_header;}
+    const Entry*       entries()  const {return m_entries;}
+
+    /// Look up a library by file name, the directory part of the argument is ignored
+    const Entry*       find(const std::string& libraryFile) const;
+
+    /// Image of a library in the mapping
+    const char*        image(const Entry& entry) const {return m_base + entry.offset;}
+
+    /// Directory under which this bundle's libraries are cached: base/obf-<release>-<hash>
+    std::string        cacheDirectory(const std::string& base) const;
+
+    /// Make sure a library is present in the cache directory and return its path there, or
+    /// an empty string on failure. Writes to a temporary file and renames it into place, so
+    /// concurrent workers on a node never see a partial library
+    std::string        cachedFile(const Entry& entry, const std::string& cacheDir, std::string& error) const;
+
+    /// FNV-1a hash used for the images
+    static unsigned long long hash(const char* data, unsigned long long size, unsigned long long seed = 14695981039346656037ULL);
+
+private:
+    ObfLibraryBundle(const ObfLibraryBundle&);
+    ObfLibraryBundle& operator=(const ObfLibraryBundle&);
+
+    const char*        m_base;
+    unsigned long long m_size;
+    const Header*      m_header;
+    const Entry*       m_entries;
+};
+
+#endif // __ObfLibraryBundle_H
@@ -0,0 +1,180 @@
+/**  @file ObfLibraryLoader.cxx
+    @brief implementation of class ObfLibraryLoader
+
+  $Header$
+*/
+
+#include "ObfLibraryLoader.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <dlfcn.h>
+#endif
+
+ObfLibraryLoader::ObfLibraryLoader(int maxThreads) : m_maxThreads(maxThreads), m_duplicates(0)
+{
+#ifndef _WIN32
+    pthread_mutex_init(&m_mutex, 0);
+    m_active = 0;
+#endif
+}
+
+ObfLibraryLoader::~ObfLibraryLoader()
+{
+    wait();
+
+#ifndef _WIN32
+    pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+bool ObfLibraryLoader::loadAttempted(const std::string& fileName, bool& loaded) const
+{
+    std::map<std::string, bool>::const_iterator regIter = m_registry.find(fileName);
+
+    if (regIter == m_registry.end()) return false;
+
+    loaded = regIter->second;
+    m_duplicates++;
+
+    return true;
+}
+
+void ObfLibraryLoader::setLoaded(const std::string& fileName, bool loaded, const std::string& openedFile)
+{
+    if (loaded && !m_registry[fileName])
+    {
+        m_loadOrder.push_back(fileName);
+        m_openedFiles.push_back(openedFile != "" ? openedFile : fileName);
+    }
+
+    m_registry[fileName] = loaded;
+}
+
+bool ObfLibraryLoader::resident(const std::string& fileName)
+{
+#ifdef _WIN32
+    return GetModuleHandleA(fileName.c_str()) != NULL;
+#else
+    // Only finds a library already loaded, and takes a reference we give straight back
+    void* handle = dlopen(fileName.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+
+    if (handle) dlclose(handle);
+
+    return handle != 0;
+#endif
+}
+
+void ObfLibraryLoader::prefetch(const std::vector<std::string>& fileNames)
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&m_mutex);
+
+    for(std::vector<std::string>::const_iterator fileIter = fileNames.begin(); fileIter != fileNames.end(); fileIter++)
+    {
+        if (m_registry.find(*fileIter) != m_registry.end()) continue;
+        if (!m_prefetched.insert(*fileIter).second)        continue;
+
+        m_queue.push_back(*fileIter);
+    }
+
+    // Start more threads if there is more queued than running
+    int nStart = m_maxThreads - m_active;
+    if (nStart > (int)m_queue.size()) nStart = m_queue.size();
+
+    m_active += nStart;
+
+    pthread_mutex_unlock(&m_mutex);
+
+    for(int idx = 0; idx < nStart; idx++)
+    {
+        pthread_t thread;
+
+        if (pthread_create(&thread, 0, worker, this) == 0) m_threads.push_back(thread);
+        else
+        {
+            // Not fatal, the files will simply be read when loaded
+            pthread_mutex_lock(&m_mutex);
+            m_active--;
+            pthread_mutex_unlock(&m_mutex);
+        }
+    }
+#endif
+
+    return;
+}
+
+void ObfLibraryLoader::wait()
+{
+#ifndef _WIN32
+    for(std::vector<pthread_t>::iterator threadIter = m_threads.begin(); threadIter != m_threads.end(); threadIter++)
+    {
+        pthread_join(*threadIter, 0);
+    }
+
+    m_threads.clear();
+#endif
+
+    return;
+}
+
+void* ObfLibraryLoader::worker(void* loader)
+{
+    reinterpret_cast<ObfLibraryLoader*>(loader)->runQueue();
+
+    return 0;
+}
+
+void ObfLibraryLoader::runQueue()
+{
+#ifndef _WIN32
+    for(;;)
+    {
+        pthread_mutex_lock(&m_mutex);
+
+        if (m_queue.empty())
+        {
+            m_active--;
+            pthread_mutex_unlock(&m_mutex);
+            break;
+        }
+
+        std::string fileName = m_queue.front();
+        m_queue.pop_front();
+
+        pthread_mutex_unlock(&m_mutex);
+
+        readFile(fileName);
+    }
+#endif
+
+    return;
+}
+
+void ObfLibraryLoader::readFile(const std::string& fileName)
+{
+#ifndef _WIN32
+    int fd = open(fileName.c_str(), O_RDONLY);
+
+    // A missing file is reported when it is loaded
+    if (fd < 0) return;
+
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+    static const int bufferSize = 1 << 18;
+    char*            buffer     = new char[bufferSize];
+
+    while(read(fd, buffer, bufferSize) > 0) {}
+
+    delete [] buffer;
+
+    close(fd);
+#endif
+
+    return;
+}
@@ -0,0 +1,96 @@
+/** @file ObfLibraryLoader.h
+*
+* @class ObfLibraryLoader
+*
+* @brief Registry of the FSW libraries loaded by ObfInterface, and background prefetching
+*        of the library files.
+*
+*        Loading itself stays serial and in the order asked for: CDM_loadDatabase runs
+*        constructors which register with CDM and the filter code must be in before its
+*        configurations are looked up, nor is CDM safe to call from several threads.
+*        What does overlap is the file I/O, which on shared file systems is most of the
+*        cost: prefetch hands the files to a small pool of threads which read them into
+*        the page cache while the caller goes on loading, so that by the time a library
+*        is loaded its pages are already in memory.
+*
+*        The registry is keyed by the fully resolved file name, so a library requested
+*        by more than one tool is loaded once.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfLibraryLoader_H
+#define __ObfLibraryLoader_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+
+#ifndef _WIN32
+#  include <pthread.h>
+#endif
+
+class ObfLibraryLoader
+{
+public:
+    ObfLibraryLoader(int maxThreads = 4);
+    ~ObfLibraryLoader();
+
+    /// Returns true if a load of this file was already attempted, with its result in loaded
+    bool loadAttempted(const std::string& fileName, bool& loaded) const;
+
+    /// Record the result of loading a file, and the file actually opened if it was
+    /// another copy of it (a node local copy from a bundle)
+    void setLoaded(const std::string& fileName, bool loaded, const std::string& openedFile = "");
+
+    /// Is this library file mapped into the process? CDM_loadDatabase does not say
+    static bool resident(const std::string& fileName);
+
+    /// Files loaded (or attempted) so far and the result of each
+    const std::map<std::string, bool>& registry() const {return m_registry;}
+
+    /// Files loaded successfully, in the order they were loaded
+    const std::vector<std::string>&    loadOrder() const {return m_loadOrder;}
+
+    /// The file actually opened for each of loadOrder
+    const std::vector<std::string>&    openedFiles() const {return m_openedFiles;}
+
+    /// Number of load requests answered from the registry
+    int duplicates() const {return m_duplicates;}
+
+    /// Start reading files into the page cache in the background. Files already loaded
+    /// or already queued are skipped. Does nothing on platforms without pthreads
+    void prefetch(const std::vector<std::string>& fileNames);
+
+    /// Wait for all prefetching to finish
+    void wait();
+
+private:
+    static void* worker(void* loader);
+
+    // Take files off the queue and read them until it is empty
+    void runQueue();
+
+    // Read one file, discarding the contents
+    static void readFile(const std::string& fileName);
+
+    int                         m_maxThreads;
+    mutable int                 m_duplicates;
+    std::map<std::string, bool> m_registry;
+    std::vector<std::string>    m_loadOrder;
+    std::vector<std::string>    m_openedFiles;
+    std::set<std::string>       m_prefetched;
+
+#ifndef _WIN32
+    pthread_mutex_t             m_mutex;       // Protects the queue and the active count
+    std::deque<std::string>     m_queue;
+    int                         m_active;
+    std::vector<pthread_t>      m_threads;
+#endif
+};
+
+#endif // __ObfLibraryLoader_H
@@ -0,0 +1,98 @@
+/**  @file ObfMootConfigCache.cxx
+    @brief implementation of class ObfMootConfigCache
+
+  $Header$
+*/
+
+#include "ObfMootConfigCache.h"
+
+#include "CalibData/Moot/MootData.h"
+#include "MootSvc/IMootSvc.h"
+
+#include "EFC_DB/EFC_DB_schema.h"
+
+ObfMootConfigCache* ObfMootConfigCache::m_instance = 0;
+
+ObfMootConfigCache* ObfMootConfigCache::instance()
+{
+    if (!m_instance) m_instance = new ObfMootConfigCache();
+    return m_instance;
+}
+
+ObfMootConfigCache::Table& ObfMootConfigCache::table(IMootSvc* mootSvc)
+{
+    return m_tables[mootSvc->getMootConfigKey()];
+}
+
+const ObfMootConfigCache::ActiveFilterVec& ObfMootConfigCache::activeFilters(IMootSvc* mootSvc)
+{
+    Table& keyTable = table(mootSvc);
+
+    if (keyTable.m_activeResolved)
+    {
+        m_cacheHits++;
+        return keyTable.m_activeFilters;
+    }
+
+    std::vector<CalibData::MootFilterCfg> filterCfgVec;
+    mootSvc->getActiveFilters(filterCfgVec);
+    m_mootQueries++;
+
+    for(std::vector<CalibData::MootFilterCfg>::const_iterator filterIter = filterCfgVec.begin();
+        filterIter != filterCfgVec.end(); filterIter++)
+    {
+        keyTable.m_activeFilters.push_back(ActiveFilter(filterIter->getSchemaId(), filterIter->getName()));
+    }
+
+    keyTable.m_activeResolved = true;
+
+    return keyTable.m_activeFilters;
+}
+
+const ObfMootConfigCache::ActiveFilter* ObfMootConfigCache::findActive(IMootSvc* mootSvc, unsigned int schemaId)
+{
+    const ActiveFilterVec& active = activeFilters(mootSvc);
+
+    for(ActiveFilterVec::const_iterator activeIter = active.begin(); activeIter != active.end(); activeIter++)
+    {
+        if (activeIter->m_schemaId == schemaId) return &*activeIter;
+    }
+
+    return 0;
+}
+
+const ObfMootConfigCache::ModeConfig& ObfMootConfigCache::modeConfig(IMootSvc* mootSvc, int handlerId, int mode)
+{
+    Table& keyTable = table(mootSvc);
+
+    std::map<int, std::vector<ModeConfig> >::iterator handlerIter = keyTable.m_modeConfigs.find(handlerId);
+
+    if (handlerIter != keyTable.m_modeConfigs.end())
+    {
+        m_cacheHits++;
+    }
+    else
+    {
+        // First time for this handler, resolve all its modes
+        std::vector<ModeConfig> modeConfigs(EFC_DB_MODE_K_CNT);
+
+        for(int modeIdx = 0; modeIdx < EFC_DB_MODE_K_CNT; modeIdx++)
+        {
+            std::string filterName = "";
+            CalibData::MootFilterCfg* mootCfg = mootSvc->getActiveFilter(modeIdx, handlerId, filterName);
+            m_mootQueries++;
+
+            if (mootCfg)
+            {
+                modeConfigs[modeIdx].m_instanceId = mootCfg->getInstanceId();
+                modeConfigs[modeIdx].m_srcPath    = mootCfg->getSrcPath();
+            }
+        }
+
+        handlerIter = keyTable.m_modeConfigs.insert(std::make_pair(handlerId, modeConfigs)).first;
+    }
+
+    static const ModeConfig noConfig;
+
+    return mode >= 0 && mode < (int)handlerIter->second.size() ? handlerIter->second[mode] : noConfig;
+}
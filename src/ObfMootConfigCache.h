@@ -0,0 +1,91 @@
+/** @file ObfMootConfigCache.h
+*
+* @class ObfMootConfigCache
+*
+* @brief Cache of the filter configuration lookups made to MootSvc, keyed by the Moot
+*        configuration key, shared by OnboardFilter and the filter tools.
+*
+*        For a given key the active filter list is asked of Moot once, and the configuration
+*        of every mode of a filter handler is asked for once, all modes together, the first
+*        time any tool wants one of them. Handler ids are only known once the filters are set
+*        up, which is why handlers are not all resolved up front. What has been resolved for
+*        a key is never changed, so a mode change or a second tool asking again costs a map
+*        look up and no Moot round trip.
+*
+* $Header$
+*/
+
+#ifndef __ObfMootConfigCache_H
+#define __ObfMootConfigCache_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+class IMootSvc;
+
+class ObfMootConfigCache
+{
+public:
+    /// A filter Moot lists as active
+    class ActiveFilter
+    {
+    public:
+        ActiveFilter(unsigned int schemaId, const std::string& name) : m_schemaId(schemaId), m_name(name) {}
+
+        unsigned int m_schemaId;
+        std::string  m_name;
+    };
+    typedef std::vector<ActiveFilter> ActiveFilterVec;
+
+    /// Configuration Moot associates with a mode of a handler, instance -1 if none
+    class ModeConfig
+    {
+    public:
+        ModeConfig() : m_instanceId(-1) {}
+
+        int          m_instanceId;
+        std::string  m_srcPath;
+    };
+
+    // Retrieve the instance of this class
+    static ObfMootConfigCache* instance();
+
+    /// Active filters for the current Moot key
+    const ActiveFilterVec& activeFilters(IMootSvc* mootSvc);
+
+    /// The active filter with this schema id for the current Moot key, 0 if it is not active
+    const ActiveFilter* findActive(IMootSvc* mootSvc, unsigned int schemaId);
+
+    /// Configuration of a handler in a mode for the current Moot key
+    const ModeConfig& modeConfig(IMootSvc* mootSvc, int handlerId, int mode);
+
+    /// Number of queries made to Moot and the number answered from the cache
+    int mootQueries() const {return m_mootQueries;}
+    int cacheHits()   const {return m_cacheHits;}
+
+private:
+    // Everything resolved for one Moot key
+    class Table
+    {
+    public:
+        Table() : m_activeResolved(false) {}
+
+        bool                                      m_activeResolved;
+        ActiveFilterVec                           m_activeFilters;
+        std::map<int, std::vector<ModeConfig> >   m_modeConfigs;    // By handler id
+    };
+
+    ObfMootConfigCache() : m_mootQueries(0), m_cacheHits(0) {}
+
+    // Table for the current Moot key
+    Table& table(IMootSvc* mootSvc);
+
+    static ObfMootConfigCache* m_instance;
+
+    std::map<unsigned int, Table> m_tables;
+    int                           m_mootQueries;
+    int                           m_cacheHits;
+};
+
+#endif // __ObfMootConfigCache_H
@@ -0,0 +1,203 @@
+/** @file ObfPerfMonitor.h
+* @class ObfPerfMonitor
+*
+* @brief Lightweight timing, memory and allocation counters used to benchmark the
+*        GSW side kernels of the OnboardFilter package. Everything here is inline so
+*        that it can be used by the component library and the test/bench programs
+*        without introducing a link dependency.
+*
+*        Allocation counts are only available when the ObfAllocHook library has been
+*        linked into (or preloaded by) the executable; otherwise they read as zero and
+*        allocCountersAvailable() returns false.
+*
+* $Header$
+*/
+
+#ifndef __ObfPerfMonitor_H
+#define __ObfPerfMonitor_H
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <ctime>
+#else
+#  include <time.h>
+#  include <sys/time.h>
+#  include <sys/resource.h>
+#  include <unistd.h>
+#  include <dlfcn.h>
+#endif
+
+class ObfPerfMonitor
+{
+public:
+    /// Signature of the counter routine exported by the ObfAllocHook library
+    typedef void (*AllocCountFn)(unsigned long long* allocs, unsigned long long* frees, unsigned long long* bytes);
+
+    /// Monotonic wall clock time in nanoseconds
+    static long long wallTimeNs()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER count, freq;
+        QueryPerformanceCounter(&count);
+        QueryPerformanceFrequency(&freq);
+        return static_cast<long long>(static_cast<double>(count.QuadPart) * 1.e9 / static_cast<double>(freq.QuadPart));
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+#endif
+    }
+
+    /// Process cpu time (user + system) in nanoseconds
+    static long long cpuTimeNs()
+    {
+#ifdef _WIN32
+        return static_cast<long long>(static_cast<double>(clock()) * 1.e9 / CLOCKS_PER_SEC);
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (static_cast<long long>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+             + (static_cast<long long>(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+#endif
+    }
+
+    /// Peak resident set size in kB (zero if not available)
+    static long peakRssKb()
+    {
+#ifdef _WIN32
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+#endif
+    }
+
+    /// Current resident set size in kB (zero if not available)
+    static long currentRssKb()
+    {
+        long rss = 0;
+#ifndef _WIN32
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (statm)
+        {
+            long pages = 0;
+            if (fscanf(statm, "%*s %ld", &pages) == 1) rss = pages * (sysconf(_SC_PAGESIZE) / 1024);
+            fclose(statm);
+        }
+#endif
+        return rss;
+    }
+
+    /// Returns true if the ObfAllocHook counters are present in this process
+    static bool allocCountersAvailable() {return allocCountFn() != 0;}
+
+    /// Number of heap allocations made by the process so far
+    static unsigned long long allocCount()
+    {
+        unsigned long long allocs = 0, frees = 0, bytes = 0;
+        if (AllocCountFn fn = allocCountFn()) fn(&allocs, &frees, &bytes);
+        return allocs;
+    }
+
+    /// Number of heap allocations currently outstanding
+    static long long liveAllocCount()
+    {
+        unsigned long long allocs = 0, frees = 0, bytes = 0;
+        if (AllocCountFn fn = allocCountFn()) fn(&allocs, &frees, &bytes);
+        return static_cast<long long>(allocs) - static_cast<long long>(frees);
+    }
+
+    /// Total number of bytes requested from the heap so far
+    static unsigned long long allocBytes()
+    {
+        unsigned long long allocs = 0, frees = 0, bytes = 0;
+        if (AllocCountFn fn = allocCountFn()) fn(&allocs, &frees, &bytes);
+        return bytes;
+    }
+
+private:
+    static AllocCountFn allocCountFn()
+    {
+#ifdef _WIN32
+        return 0;
+#else
+        static bool         looked = false;
+        static AllocCountFn fn     = 0;
+
+        if (!looked)
+        {
+            fn     = reinterpret_cast<AllocCountFn>(dlsym(RTLD_DEFAULT, "ObfAllocHook_counts"));
+            looked = true;
+        }
+
+        return fn;
+#endif
+    }
+};
+
+/** @class ObfKernelStats
+*
+* @brief Accumulates calls, wall time and heap allocations for one named kernel.
+*        Usage is start()/stop() around the code of interest, report with the
+*        per call averages at the end of the run.
+*/
+class ObfKernelStats
+{
+public:
+    ObfKernelStats(const std::string& name = "") : m_name(name), m_calls(0), m_ns(0), m_allocs(0),
+                                                   m_startNs(0), m_startAllocs(0) {}
+
+    void start()
+    {
+        m_startAllocs = ObfPerfMonitor::allocCount();
+        m_startNs     = ObfPerfMonitor::wallTimeNs();
+    }
+
+    void stop()
+    {
+        m_ns     += ObfPerfMonitor::wallTimeNs() - m_startNs;
+        m_allocs += ObfPerfMonitor::allocCount() - m_startAllocs;
+        m_calls++;
+    }
+
+    void reset() {m_calls = 0; m_ns = 0; m_allocs = 0;}
+
+    const std::string&  getName()         const {return m_name;}
+    unsigned long long  getCalls()        const {return m_calls;}
+    long long           getTotalNs()      const {return m_ns;}
+    unsigned long long  getTotalAllocs()  const {return m_allocs;}
+    double              getNsPerCall()    const {return m_calls ? static_cast<double>(m_ns) / m_calls : 0.;}
+    double              getAllocsPerCall()const {return m_calls ? static_cast<double>(m_allocs) / m_calls : 0.;}
+
+    /// One line summary, per call and (if nEvents given) per event numbers
+    std::string summary(unsigned long long nEvents = 0) const
+    {
+        std::stringstream line;
+        line << std::setw(28) << std::left << m_name << std::right
+             << " calls: "      << std::setw(9)  << m_calls
+             << " ns/call: "    << std::setw(10) << std::fixed << std::setprecision(1) << getNsPerCall();
+        if (nEvents > 0)
+            line << " ns/event: " << std::setw(10) << static_cast<double>(m_ns) / nEvents;
+        if (ObfPerfMonitor::allocCountersAvailable())
+            line << " allocs/call: " << std::setprecision(2) << getAllocsPerCall();
+        else
+            line << " allocs/call: n/a";
+        return line.str();
+    }
+
+private:
+    std::string        m_name;
+    unsigned long long m_calls;
+    long long          m_ns;
+    unsigned long long m_allocs;
+    long long          m_startNs;
+    unsigned long long m_startAllocs;
+};
+
+#endif // __ObfPerfMonitor_H
@@ -0,0 +1,239 @@
+/**  @file ObfReleaseCompareAlg.cxx
+    @brief implementation of class ObfReleaseCompareAlg
+
+  $Header$
+*/
+
+#include "GaudiKernel/Algorithm.h"
+#include "GaudiKernel/MsgStream.h"
+#include "GaudiKernel/AlgFactory.h"
+#include "GaudiKernel/IDataProviderSvc.h"
+#include "GaudiKernel/SmartDataPtr.h"
+#include "GaudiKernel/Property.h"
+
+#include "Event/TopLevel/EventModel.h"
+#include "Event/TopLevel/Event.h"
+#include "EbfWriter/Ebf.h"
+
+#include "facilities/Util.h"
+
+#include "release/ObfReleaseEngineLoader.h"
+
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+
+/** @class ObfReleaseCompareAlg
+    @brief Runs every event through the filters of two flight software releases in the same
+           job and reports the differences in status words and accept decisions.
+
+           Each release is a libObfReleaseEngine<release> library, built by this package when
+           configured against that release (see ObfReleaseEngine.h). The two libraries are
+           loaded with dlmopen into separate link namespaces so that each brings up its own
+           copy of the FSW libraries; the EBF of the event is handed to both and the results
+           compared. Only available on glibc platforms.
+
+           One line is written to OutputFile for each filter whose result differs:
+           run event filter refStatus testStatus refAccept testAccept
+*/
+class ObfReleaseCompareAlg : public Algorithm
+{
+public:
+    ObfReleaseCompareAlg(const std::string& name, ISvcLocator *pSvcLocator);
+    ~ObfReleaseCompareAlg() {}
+
+    StatusCode initialize();
+    StatusCode execute();
+    StatusCode finalize();
+
+private:
+    typedef ObfReleaseEngineLoader Engine;
+
+    StatusCode loadEngine(MsgStream& log, const std::string& library, const std::string& options, Engine& engine);
+
+    //****** This section for defining JO parameters
+    StringProperty  m_refLibrary;
+    StringProperty  m_refOptions;
+    StringProperty  m_testLibrary;
+    StringProperty  m_testOptions;
+    StringProperty  m_outputFile;
+    IntegerProperty m_maxPrint;
+
+    Engine          m_ref;
+    Engine          m_test;
+    std::ofstream   m_output;
+
+    // Counters
+    int             m_events;
+    int             m_failed;
+    int             m_eventsDiffering;
+    int             m_statusDiffers[ObfRelease_NumFilters];
+    int             m_gained[ObfRelease_NumFilters];    // Accepted by test, rejected by reference
+    int             m_lost[ObfRelease_NumFilters];      // Rejected by test, accepted by reference
+};
+
+DECLARE_ALGORITHM_FACTORY(ObfReleaseCompareAlg);
+
+ObfReleaseCompareAlg::ObfReleaseCompareAlg(const std::string& name, ISvcLocator *pSvcLocator) :
+                      Algorithm(name, pSvcLocator), m_events(0), m_failed(0), m_eventsDiffering(0)
+{
+    // Parameter: ReferenceLibrary / TestLibrary
+    // The release engine libraries to compare, e.g. "$(OBFLDPATH)/lib/libObfReleaseEngineB1-1-3.so"
+    declareProperty("ReferenceLibrary", m_refLibrary  = "");
+    declareProperty("TestLibrary",      m_testLibrary = "");
+    // Parameter: ReferenceOptions / TestOptions
+    // NAME=value;... environment settings applied inside each engine before it loads anything
+    declareProperty("ReferenceOptions", m_refOptions  = "");
+    declareProperty("TestOptions",      m_testOptions = "");
+    // Parameter: OutputFile
+    // Per event differences, if set
+    declareProperty("OutputFile",       m_outputFile  = "");
+    // Parameter: MaxPrint
+    // Number of differing events also reported in the log
+    declareProperty("MaxPrint",         m_maxPrint    = 10);
+
+    memset(m_statusDiffers, 0, sizeof(m_statusDiffers));
+    memset(m_gained,        0, sizeof(m_gained));
+    memset(m_lost,          0, sizeof(m_lost));
+}
+
+StatusCode ObfReleaseCompareAlg::initialize()
+{
+    MsgStream log(msgSvc(), name());
+
+    setProperties();
+
+    if (loadEngine(log, m_refLibrary.value(),  m_refOptions.value(),  m_ref).isFailure())  return StatusCode::FAILURE;
+    if (loadEngine(log, m_testLibrary.value(), m_testOptions.value(), m_test).isFailure()) return StatusCode::FAILURE;
+
+    log << MSG::INFO << "Comparing FSW release " << m_ref.release(m_ref.engine)
+        << " (reference) with " << m_test.release(m_test.engine) << endreq;
+
+    if (m_outputFile.value() != "")
+    {
+        std::string fileName = m_outputFile.value();
+        facilities::Util::expandEnvVar(&fileName);
+
+        m_output.open(fileName.c_str());
+
+        if (!m_output.is_open())
+        {
+            log << MSG::ERROR << "Unable to open output file " << fileName << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        m_output << "# reference " << m_ref.release(m_ref.engine) << " test " << m_test.release(m_test.engine) << "\n"
+                 << "# run event filter refStatus testStatus refAccept testAccept\n";
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode ObfReleaseCompareAlg::loadEngine(MsgStream& log, const std::string& library, const std::string& options, Engine& engine)
+{
+    std::string fileName = library;
+    facilities::Util::expandEnvVar(&fileName);
+
+    std::string error;
+
+    if (!engine.load(fileName, options, error))
+    {
+        log << MSG::ERROR << "Release comparison: " << error << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode ObfReleaseCompareAlg::execute()
+{
+    MsgStream log(msgSvc(), name());
+
+    SmartDataPtr<EbfWriterTds::Ebf> ebfData(eventSvc(), "/Event/Filter/Ebf");
+
+    if (!ebfData) return StatusCode::SUCCESS;
+
+    m_events++;
+
+    unsigned int length = 0;
+    char*        data   = ebfData->get(length);
+
+    if (length == 0) return StatusCode::SUCCESS;
+
+    // Each engine gets its own copy, the FSW may modify the packets and the TDS copy
+    // is still wanted by the algorithms after us
+    std::vector<char> refData(data, data + length);
+    std::vector<char> testData(data, data + length);
+
+    ObfReleaseResult refResult, testResult;
+
+    if (m_ref.filter(m_ref.engine, &refData[0], length, &refResult) || m_test.filter(m_test.engine, &testData[0], length, &testResult))
+    {
+        m_failed++;
+        return StatusCode::SUCCESS;
+    }
+
+    SmartDataPtr<Event::EventHeader> header(eventSvc(), EventModel::EventHeader);
+
+    static const char* filterNames[] = {"Gamma", "HIP", "MIP", "DGN"};
+    bool               differs       = false;
+
+    for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+    {
+        const ObfReleaseFilterResult& ref  = refResult.filters[slot];
+        const ObfReleaseFilterResult& test = testResult.filters[slot];
+
+        if (ref.ran == test.ran && ref.status == test.status && ref.accepted == test.accepted) continue;
+
+        differs = true;
+
+        if (ref.status   != test.status)  m_statusDiffers[slot]++;
+        if (test.accepted && !ref.accepted) m_gained[slot]++;
+        if (!test.accepted && ref.accepted) m_lost[slot]++;
+
+        if (m_output.is_open())
+        {
+            m_output << (header ? header->run() : 0) << " " << (header ? header->event() : 0) << " " << filterNames[slot]
+                     << std::hex << std::setfill('0') << " " << std::setw(8) << ref.status << " " << std::setw(8) << test.status
+                     << std::dec << std::setfill(' ') << " " << (int)ref.accepted << " " << (int)test.accepted << "\n";
+        }
+
+        if (m_eventsDiffering < m_maxPrint)
+        {
+            log << MSG::INFO << "Event " << (header ? header->event() : 0) << " " << filterNames[slot] << " status "
+                << std::hex << ref.status << " -> " << test.status << std::dec
+                << ", accept " << (int)ref.accepted << " -> " << (int)test.accepted << endreq;
+        }
+    }
+
+    if (differs) m_eventsDiffering++;
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode ObfReleaseCompareAlg::finalize()
+{
+    MsgStream log(msgSvc(), name());
+
+    static const char* filterNames[] = {"Gamma", "HIP", "MIP", "DGN"};
+
+    log << MSG::INFO << "Release comparison over " << m_events << " events, " << m_eventsDiffering << " differ";
+    if (m_failed) log << ", " << m_failed << " could not be filtered";
+    log << "\n";
+
+    for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+    {
+        log << "    " << filterNames[slot] << ": status differs " << m_statusDiffers[slot]
+            << ", accepted only by test " << m_gained[slot] << ", only by reference " << m_lost[slot] << "\n";
+    }
+
+    log << endreq;
+
+    if (m_output.is_open()) m_output.close();
+
+    m_ref.unload();
+    m_test.unload();
+
+    return StatusCode::SUCCESS;
+}
@@ -0,0 +1,231 @@
+/**  @file ObfResultCache.cxx
+    @brief implementation of class ObfResultCache
+
+  $Header$
+*/
+
+#include "ObfResultCache.h"
+#include "ObfWarmStart.h"
+
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <sys/stat.h>
+
+namespace
+{
+    // Mix a 64 bit word into a running hash
+    inline unsigned long long mix(unsigned long long hash, unsigned long long word, unsigned long long multiplier)
+    {
+        hash ^= word;
+        hash *= multiplier;
+        return hash ^ (hash >> 29);
+    }
+}
+
+ObfResultCache::Key ObfResultCache::key(const char* data, unsigned int length, unsigned int mode)
+{
+    Key key;
+
+    key.hash1  = 14695981039346656037ULL;
+    key.hash2  = 0x9e3779b97f4a7c15ULL;
+    key.length = length;
+    key.mode   = mode;
+
+    // Eight bytes at a time, then what is left over
+    unsigned int idx = 0;
+
+    for(; idx + 8 <= length; idx += 8)
+    {
+        unsigned long long word;
+        memcpy(&word, data + idx, 8);
+
+        key.hash1 = mix(key.hash1, word, 1099511628211ULL);
+        key.hash2 = mix(key.hash2, word, 0xff51afd7ed558ccdULL);
+    }
+
+    unsigned long long tail = 0;
+    if (idx < length) memcpy(&tail, data + idx, length - idx);
+
+    key.hash1 = mix(key.hash1, tail, 1099511628211ULL);
+    key.hash2 = mix(key.hash2, tail, 0xff51afd7ed558ccdULL);
+
+    return key;
+}
+
+std::string ObfResultCache::fileName(const std::string& directory, const std::string& fingerprint)
+{
+    std::ostringstream name;
+
+    name << directory << "/obfResults-" << std::hex << std::setw(16) << std::setfill('0') << ObfWarmStart::hash(fingerprint) << ".cache";
+
+    return name.str();
+}
+
+std::string ObfResultCache::fileFingerprint(const std::string& fileName)
+{
+    struct stat fileStat;
+
+    if (stat(fileName.c_str(), &fileStat) != 0) return "";
+
+    FILE* input = fopen(fileName.c_str(), "rb");
+
+    if (!input) return "";
+
+    // The contents, a block at a time, as a chain of event keys
+    std::vector<char> buffer(1 << 16);
+    Key               contents;
+    size_t            nRead;
+
+    while((nRead = fread(&buffer[0], 1, buffer.size(), input)) > 0)
+    {
+        Key block = key(&buffer[0], nRead, 0);
+
+        contents.hash1 = mix(contents.hash1, block.hash1, 1099511628211ULL);
+        contents.hash2 = mix(contents.hash2, block.hash2, 0xff51afd7ed558ccdULL);
+    }
+
+    bool readError = ferror(input) != 0;
+
+    fclose(input);
+
+    if (readError) return "";
+
+    // The file the name resolves to
+    std::string resolved = fileName;
+
+#ifdef _WIN32
+    char path[_MAX_PATH];
+    if (_fullpath(path, fileName.c_str(), _MAX_PATH)) resolved = path;
+#else
+    if (char* path = realpath(fileName.c_str(), 0))
+    {
+        resolved = path;
+        free(path);
+    }
+#endif
+
+    std::ostringstream fingerprint;
+
+    fingerprint << resolved << " " << fileStat.st_size << " " << fileStat.st_mtime << " " 
+                << std::hex << std::setfill('0') << std::setw(16) << contents.hash1 << std::setw(16) << contents.hash2;
+
+    return fingerprint.str();
+}
+
+bool ObfResultCache::open(const std::string& directory, const std::string& fingerprint, std::string& error)
+{
+    close();
+
+    m_entries.clear();
+
+    unsigned long long fingerprintHash = ObfWarmStart::hash(fingerprint);
+
+    m_fileName = fileName(directory, fingerprint);
+
+    // Read what is already there
+    bool partial = false;
+
+    if (FILE* input = fopen(m_fileName.c_str(), "rb"))
+    {
+        Header header;
+
+        if (fread(&header, sizeof(header), 1, input) != 1 || !header.valid(fingerprintHash))
+        {
+            fclose(input);
+            error = m_fileName + " is not a result cache for this setup";
+            return false;
+        }
+
+        Entry entry;
+
+        while(fread(&entry, sizeof(entry), 1, input) == 1) m_entries[entry.key] = entry.result;
+
+        partial = !feof(input) || ftell(input) != (long)(sizeof(Header) + m_entries.size() * sizeof(Entry));
+
+        fclose(input);
+
+        // Append to it, unless a job died part way through an entry
+        if (!partial) m_file = fopen(m_fileName.c_str(), "ab");
+    }
+
+    if (!m_file && !rewrite(fingerprintHash))
+    {
+        error = "unable to write result cache " + m_fileName;
+        return false;
+    }
+
+    return true;
+}
+
+bool ObfResultCache::find(const Key& key, ObfGoldenRecord& result)
+{
+    EntryMap::const_iterator entryIter = m_entries.find(key);
+
+    if (entryIter == m_entries.end())
+    {
+        m_misses++;
+        return false;
+    }
+
+    result = entryIter->second;
+    m_hits++;
+
+    return true;
+}
+
+bool ObfResultCache::store(const Key& key, const ObfGoldenRecord& result)
+{
+    if (!m_file) return false;
+
+    Entry entry;
+
+    entry.key    = key;
+    entry.result = result;
+
+    // Only the filter results belong to the content
+    entry.result.run      = 0;
+    entry.result.eventId  = 0;
+    entry.result.sequence = 0;
+
+    if (fwrite(&entry, sizeof(entry), 1, m_file) != 1) return false;
+
+    m_entries[key] = entry.result;
+    m_stored++;
+
+    return true;
+}
+
+void ObfResultCache::close()
+{
+    if (m_file) fclose(m_file);
+    m_file = 0;
+
+    return;
+}
+
+bool ObfResultCache::rewrite(unsigned long long fingerprintHash)
+{
+    m_file = fopen(m_fileName.c_str(), "wb");
+
+    if (!m_file) return false;
+
+    Header header(fingerprintHash);
+
+    bool ok = fwrite(&header, sizeof(header), 1, m_file) == 1;
+
+    for(EntryMap::const_iterator entryIter = m_entries.begin(); ok && entryIter != m_entries.end(); entryIter++)
+    {
+        Entry entry;
+
+        entry.key    = entryIter->first;
+        entry.result = entryIter->second;
+
+        ok = fwrite(&entry, sizeof(entry), 1, m_file) == 1;
+    }
+
+    if (!ok) close();
+
+    return ok;
+}
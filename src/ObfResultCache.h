@@ -0,0 +1,138 @@
+/** @file ObfResultCache.h
+*
+* @class ObfResultCache
+*
+* @brief On disk cache of filter results, keyed by the content of each event's EBF, so
+*        reprocessing the same events with the same filter setup reads the results back
+*        instead of running the filters again.
+*
+*        The key is two independent 64 bit hashes of the EBF bytes, with the length and the
+*        mode the event ran in. The value is the compact result of ObfGoldenRecord (status
+*        word, id and summary byte of each filter, the gamma energy and the FilterTrack best
+*        track). Everything else that decides the results (release, job options and the
+*        contents of the libraries loaded) goes into a fingerprint, and each fingerprint has
+*        a file of its own in the cache directory, so a change of setup starts a fresh cache
+*        and never reads a stale one. A file is a header followed by fixed size entries,
+*        appended as events miss; a partial entry left by a job which died is dropped when
+*        the file is next opened.
+*
+*        Only one job should write a cache file at a time.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfResultCache_H
+#define __ObfResultCache_H
+
+#include "ObfGoldenRecord.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <map>
+
+class ObfResultCache
+{
+public:
+    enum {CurrentVersion = 1};
+
+    /// Key of one event
+    class Key
+    {
+    public:
+        Key() : hash1(0), hash2(0), length(0), mode(0) {}
+
+        bool operator<(const Key& other) const
+        {
+            if (hash1  != other.hash1)  return hash1  < other.hash1;
+            if (hash2  != other.hash2)  return hash2  < other.hash2;
+            if (length != other.length) return length < other.length;
+            return mode < other.mode;
+        }
+
+        unsigned long long hash1;
+        unsigned long long hash2;
+        unsigned int       length;
+        unsigned int       mode;
+    };
+
+    ObfResultCache() : m_file(0), m_hits(0), m_misses(0), m_stored(0) {}
+    ~ObfResultCache() {close();}
+
+    /// Key of an event's EBF, run in the given mode
+    static Key key(const char* data, unsigned int length, unsigned int mode);
+
+    /// File holding the entries of a fingerprint
+    static std::string fileName(const std::string& directory, const std::string& fingerprint);
+
+    /// Fingerprint of a library file: resolved path, size, modification time and a hash of
+    /// the contents, so a rebuilt library gives another one even with the same name and size.
+    /// Empty if the file cannot be read
+    static std::string fileFingerprint(const std::string& fileName);
+
+    /// Open the cache of a fingerprint in a directory, reading in what it already holds.
+    /// Returns false with a message if it cannot be used
+    bool open(const std::string& directory, const std::string& fingerprint, std::string& error);
+
+    /// Look up an event, returns false on a miss
+    bool find(const Key& key, ObfGoldenRecord& result);
+
+    /// Add the result of an event which missed, returns false if it cannot be written
+    bool store(const Key& key, const ObfGoldenRecord& result);
+
+    void close();
+
+    bool               isOpen()   const {return m_file != 0;}
+    const std::string& fileName() const {return m_fileName;}
+    int                entries()  const {return m_entries.size();}
+    unsigned long long hits()     const {return m_hits;}
+    unsigned long long misses()   const {return m_misses;}
+    unsigned long long stored()   const {return m_stored;}
+
+private:
+    /// File header
+    class Header
+    {
+    public:
+        Header(unsigned long long fingerprintHash = 0) : version(CurrentVersion), entrySize(sizeof(Entry)), fingerprint(fingerprintHash)
+        {
+            memcpy(magic, "OBFRCACH", 8);
+        }
+
+        bool valid(unsigned long long fingerprintHash) const
+        {
+            return memcmp(magic, "OBFRCACH", 8) == 0 && version == CurrentVersion && entrySize == sizeof(Entry)
+                && fingerprint == fingerprintHash;
+        }
+
+        char               magic[8];
+        unsigned int       version;
+        unsigned int       entrySize;
+        unsigned long long fingerprint;
+    };
+
+    /// One cached event as it is on disk
+    class Entry
+    {
+    public:
+        Key             key;
+        ObfGoldenRecord result;
+    };
+
+    // Write a new file with a header and the entries in memory
+    bool rewrite(unsigned long long fingerprintHash);
+
+    typedef std::map<Key, ObfGoldenRecord> EntryMap;
+    EntryMap           m_entries;
+
+    FILE*              m_file;
+    std::string        m_fileName;
+
+    unsigned long long m_hits;
+    unsigned long long m_misses;
+    unsigned long long m_stored;
+};
+
+#endif // __ObfResultCache_H
@@ -0,0 +1,99 @@
+/** @file ObfSampler.h
+*
+* @class ObfSampler
+*
+* @brief Deterministic 1 in N selection of events by run and event number, used to run
+*        diagnostic filters and output tools on a subset of the events.
+*
+*        An event is selected when a hash of its run and event numbers is a multiple of N,
+*        so the selection does not depend on the order events are seen in, does not follow
+*        any pattern in the event numbers, and is the same for every sampler with the same
+*        rate. With rates that are multiples of each other (10 and 100, say) the smaller
+*        subset is contained in the larger.
+*
+*        The rate can be raised on the fly by a throttle factor (see ObfBudgetController.h),
+*        unless the sampler is fixed. Throttle factors are powers of two, so the subset
+*        selected when throttled is contained in the one selected before.
+*
+*        The numbers seen and selected are kept so that sampled statistics can be reweighted
+*        by weight() = seen / selected.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfSampler_H
+#define __ObfSampler_H
+
+#include <string>
+
+class ObfSampler
+{
+public:
+    ObfSampler(const std::string& name = "", int rate = 1, unsigned int target = 0) :
+               m_name(name), m_rate(rate < 1 ? 1 : rate), m_target(target), m_throttle(1), m_fixed(false),
+               m_seen(0), m_selected(0), m_current(true) {}
+
+    /// Is this event in the 1 in rate subset?
+    static bool selected(unsigned int run, unsigned long long event, int rate)
+    {
+        if (rate <= 1) return true;
+
+        // 64 bit finalizer of MurmurHash3
+        unsigned long long key = ((unsigned long long)run << 32) ^ event;
+
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+
+        return key % rate == 0;
+    }
+
+    /// Select (or not) the next event and count it
+    bool select(unsigned int run, unsigned long long event)
+    {
+        m_current = selected(run, event, effectiveRate());
+
+        m_seen++;
+        if (m_current) m_selected++;
+
+        return m_current;
+    }
+
+    const std::string& name()      const {return m_name;}
+    int                rate()      const {return m_rate;}
+    unsigned int       target()    const {return m_target;}
+    bool               fixed()     const {return m_fixed;}
+
+    /// Rate after throttling
+    int                effectiveRate() const {return m_fixed ? m_rate : m_rate * m_throttle;}
+
+    /// Throttle factor for optional work, ignored if fixed
+    void               setThrottle(int throttle) {m_throttle = throttle < 1 ? 1 : throttle;}
+
+    /// A fixed sampler is never throttled
+    void               setFixed(bool fixed)      {m_fixed = fixed;}
+    unsigned long long seen()      const {return m_seen;}
+    unsigned long long nSelected() const {return m_selected;}
+
+    /// Was the last event selected?
+    bool               current()   const {return m_current;}
+
+    /// Weight of a selected event, seen / selected
+    double             weight()    const {return m_selected ? (double)m_seen / (double)m_selected : 0.;}
+
+private:
+    std::string        m_name;
+    int                m_rate;
+    unsigned int       m_target;      // EDS_fw handler mask of a sampled filter, 0 for an output tool
+    int                m_throttle;
+    bool               m_fixed;
+    unsigned long long m_seen;
+    unsigned long long m_selected;
+    bool               m_current;
+};
+
+#endif // __ObfSampler_H
@@ -0,0 +1,274 @@
+/** @file ObfVetoReplay.h
+*
+* @class ObfVetoReplay
+*
+* @brief Re-evaluates filter accept/reject decisions offline from recorded status words,
+*        under veto masks and prescaler settings other than the ones the filter ran with.
+*        The status words must come from a run where every stage was evaluated (for the
+*        Gamma Filter, RunAllStages = true), so that every veto bit which could fire is
+*        present in the word. They are read from golden files (see ObfGoldenRecord.h).
+*
+*        The sampler is modelled on EFC_sampler with deterministic countdown counters,
+*        a counter fires when it counts down to zero and is then refreshed:
+*          - input prescaler:  fires on every Nth event, the event is accepted whatever
+*                              its veto bits
+*          - veto:             the event is rejected if (status & vetoMask) != 0
+*          - leak prescalers:  one per status bit, counts down on each rejected event with
+*                              that bit set; if any fires the rejection is flipped to accept
+*          - output prescaler: counts down on each accepted event, if it does not fire the
+*                              acceptance is flipped to reject (so 1 in N is kept)
+*        A refresh of 0 disables a prescaler.
+*
+*        Status words are held as a plain array so the veto mask evaluation, which is all
+*        that is needed when no prescalers are enabled, is a branch free loop the compiler
+*        vectorizes. The prescaler pass only visits the events it needs to.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfVetoReplay_H
+#define __ObfVetoReplay_H
+
+#include "ObfGoldenRecord.h"
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+
+class ObfVetoReplay
+{
+public:
+    /// One what-if setting of the sampler
+    class Scenario
+    {
+    public:
+        Scenario() : vetoMask(0), inPrescale(0), outPrescale(0) {memset(leakPrescale, 0, sizeof(leakPrescale));}
+
+        /// Parse "mask=0x...,in=N,out=N,leak=bit:N,..." (commas or blanks between settings)
+        bool parse(const std::string& text, std::string& error)
+        {
+            std::string settings = text;
+            for(std::string::iterator charIter = settings.begin(); charIter != settings.end(); charIter++)
+                if (*charIter == ',') *charIter = ' ';
+
+            std::istringstream settingStream(settings);
+            std::string        setting;
+
+            name = text;
+
+            while(settingStream >> setting)
+            {
+                std::string::size_type equals = setting.find('=');
+                if (equals == std::string::npos) {error = "missing '=' in " + setting; return false;}
+
+                std::string  key   = setting.substr(0, equals);
+                std::string  value = setting.substr(equals + 1);
+                char*        end   = 0;
+
+                if (key == "leak")
+                {
+                    std::string::size_type colon = value.find(':');
+                    if (colon == std::string::npos) {error = "leak needs bit:N in " + setting; return false;}
+
+                    unsigned int bit = strtoul(value.c_str(), &end, 0);
+                    if (*end != ':' || bit > 31) {error = "bad bit in " + setting; return false;}
+
+                    leakPrescale[bit] = strtoul(value.c_str() + colon + 1, &end, 0);
+                }
+                else
+                {
+                    unsigned int number = strtoul(value.c_str(), &end, 0);
+
+                    if      (key == "mask") vetoMask    = number;
+                    else if (key == "in")   inPrescale  = number;
+                    else if (key == "out")  outPrescale = number;
+                    else {error = "unknown setting " + key; return false;}
+                }
+
+                if (!end || *end != 0) {error = "bad value in " + setting; return false;}
+            }
+
+            return true;
+        }
+
+        /// True if any prescaler is enabled
+        bool prescaled() const
+        {
+            if (inPrescale || outPrescale > 1) return true;
+            for(int bit = 0; bit < 32; bit++) if (leakPrescale[bit]) return true;
+            return false;
+        }
+
+        std::string  name;
+        unsigned int vetoMask;
+        unsigned int inPrescale;
+        unsigned int outPrescale;
+        unsigned int leakPrescale[32];
+    };
+
+    /// Outcome of a scenario
+    class Result
+    {
+    public:
+        Result() : events(0), accepted(0), vetoed(0), inPassed(0), leaked(0), outRejected(0),
+                   agree(0), gained(0), lost(0) {}
+
+        unsigned long long events;
+        unsigned long long accepted;      ///< Accepted in the end
+        unsigned long long vetoed;        ///< Rejected by the veto mask (before prescaling)
+        unsigned long long inPassed;      ///< Accepted by the input prescaler
+        unsigned long long leaked;        ///< Vetoed but leaked by a bit prescaler
+        unsigned long long outRejected;   ///< Accepted but dropped by the output prescaler
+        unsigned long long agree;         ///< Same decision as recorded
+        unsigned long long gained;        ///< Accepted here, recorded as rejected
+        unsigned long long lost;          ///< Rejected here, recorded as accepted
+    };
+
+    ObfVetoReplay() : m_haveRecorded(false) {}
+
+    /// Load the status words of one filter, events where it did not run are skipped.
+    /// Set haveRecorded if the records carry the recorded decision (golden file version 2 on)
+    void load(const std::vector<ObfGoldenRecord>& records, int filter, bool haveRecorded, unsigned int ignoreBits = 0)
+    {
+        m_status.clear();
+        m_recorded.clear();
+        m_status.reserve(records.size());
+        m_recorded.reserve(records.size());
+
+        for(std::vector<ObfGoldenRecord>::const_iterator recIter = records.begin(); recIter != records.end(); recIter++)
+        {
+            if (!(recIter->present & (1 << filter))) continue;
+
+            m_status.push_back(recIter->status[filter] & ~ignoreBits);
+            m_recorded.push_back((recIter->passed >> filter) & 1);
+        }
+
+        m_haveRecorded = haveRecorded;
+    }
+
+    size_t size()         const {return m_status.size();}
+    bool   haveRecorded() const {return m_haveRecorded;}
+
+    /// Evaluate one scenario. If decisions is given it is filled with 1 for accepted events
+    Result evaluate(const Scenario& scenario, std::vector<unsigned char>* decisions = 0) const
+    {
+        Result result;
+        size_t nEvents = m_status.size();
+
+        result.events = nEvents;
+
+        if (nEvents == 0) return result;
+
+        std::vector<unsigned char> localDecisions;
+        std::vector<unsigned char>& accept = decisions ? *decisions : localDecisions;
+        accept.resize(nEvents);
+
+        // Veto mask, the hot loop
+        const unsigned int* status   = &m_status[0];
+        unsigned char*      decision = &accept[0];
+        unsigned int        mask     = scenario.vetoMask;
+
+        for(size_t idx = 0; idx < nEvents; idx++) decision[idx] = (status[idx] & mask) == 0;
+
+        for(size_t idx = 0; idx < nEvents; idx++) result.accepted += decision[idx];
+
+        result.vetoed = nEvents - result.accepted;
+
+        // Prescalers, done in event order so the counters are deterministic
+        if (scenario.prescaled())
+        {
+            unsigned int inCount  = scenario.inPrescale;
+            unsigned int outCount = scenario.outPrescale;
+            unsigned int leakCount[32];
+            unsigned int leakMask = 0;
+
+            for(int bit = 0; bit < 32; bit++)
+            {
+                leakCount[bit] = scenario.leakPrescale[bit];
+                if (leakCount[bit]) leakMask |= 1u << bit;
+            }
+
+            for(size_t idx = 0; idx < nEvents; idx++)
+            {
+                bool inFired = false;
+
+                if (scenario.inPrescale && --inCount == 0)
+                {
+                    inCount = scenario.inPrescale;
+                    inFired = true;
+                }
+
+                if (!decision[idx])
+                {
+                    // Count down the prescaler of every enabled bit that is set
+                    bool         leak = false;
+                    unsigned int bits = status[idx] & leakMask;
+
+                    while(bits)
+                    {
+                        int bit = lowestBit(bits);
+                        bits &= bits - 1;
+
+                        if (--leakCount[bit] == 0)
+                        {
+                            leakCount[bit] = scenario.leakPrescale[bit];
+                            leak           = true;
+                        }
+                    }
+
+                    if      (inFired) result.inPassed++;
+                    else if (leak)    result.leaked++;
+
+                    if (inFired || leak) decision[idx] = 1;
+                }
+
+                if (decision[idx] && scenario.outPrescale > 1 && !inFired)
+                {
+                    if (--outCount == 0) outCount = scenario.outPrescale;
+                    else
+                    {
+                        decision[idx] = 0;
+                        result.outRejected++;
+                    }
+                }
+            }
+
+            result.accepted = 0;
+            for(size_t idx = 0; idx < nEvents; idx++) result.accepted += decision[idx];
+        }
+
+        // Compare with what was recorded
+        if (m_haveRecorded)
+        {
+            const unsigned char* recorded = &m_recorded[0];
+
+            for(size_t idx = 0; idx < nEvents; idx++)
+            {
+                result.gained += decision[idx] & (recorded[idx] ^ 1);
+                result.lost   += (decision[idx] ^ 1) & recorded[idx];
+            }
+
+            result.agree = nEvents - result.gained - result.lost;
+        }
+
+        return result;
+    }
+
+private:
+    static int lowestBit(unsigned int bits)
+    {
+        int bit = 0;
+        while(!(bits & 1)) {bits >>= 1; bit++;}
+        return bit;
+    }
+
+    std::vector<unsigned int>  m_status;
+    std::vector<unsigned char> m_recorded;
+    bool                       m_haveRecorded;
+};
+
+#endif // __ObfVetoReplay_H
@@ -0,0 +1,137 @@
+/**  @file ObfWarmStart.cxx
+    @brief implementation of class ObfWarmStart
+
+  $Header$
+*/
+
+#include "ObfWarmStart.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+std::string ObfWarmStart::makeKey(const std::string& release, unsigned int mootKey, unsigned long long joHash)
+{
+    std::ostringstream key;
+
+    key << release << "/" << mootKey << "/" << std::hex << std::setw(16) << std::setfill('0') << joHash;
+
+    return key.str();
+}
+
+unsigned long long ObfWarmStart::hash(const std::string& text, unsigned long long seed)
+{
+    unsigned long long value = seed;
+
+    for(std::string::const_iterator charIter = text.begin(); charIter != text.end(); charIter++)
+    {
+        value ^= (unsigned char)*charIter;
+        value *= 1099511628211ULL;
+    }
+
+    return value;
+}
+
+const std::vector<int>* ObfWarmStart::modeConfigs(unsigned short int schemaId) const
+{
+    ModeConfigMap::const_iterator configIter = m_modeConfigs.find(schemaId);
+
+    return configIter != m_modeConfigs.end() ? &configIter->second : 0;
+}
+
+bool ObfWarmStart::write(const std::string& fileName) const
+{
+    // Write to the side and rename, so a concurrent job never reads half a snapshot
+    std::ostringstream tempName;
+    tempName << fileName << ".tmp" << getpid();
+
+    std::ofstream file(tempName.str().c_str());
+
+    if (!file.is_open()) return false;
+
+    file << "# OnboardFilter warm start\n"
+         << "version " << CurrentVersion << "\n"
+         << "key " << m_key << "\n";
+
+    for(std::vector<std::string>::const_iterator libIter = m_libraries.begin(); libIter != m_libraries.end(); libIter++)
+        file << "library " << *libIter << "\n";
+
+    for(ModeConfigMap::const_iterator configIter = m_modeConfigs.begin(); configIter != m_modeConfigs.end(); configIter++)
+    {
+        file << "modes " << configIter->first;
+        for(std::vector<int>::const_iterator modeIter = configIter->second.begin(); modeIter != configIter->second.end(); modeIter++)
+            file << " " << *modeIter;
+        file << "\n";
+    }
+
+    for(std::vector<unsigned int>::const_iterator activeIter = m_activeFilters.begin(); activeIter != m_activeFilters.end(); activeIter++)
+        file << "active " << *activeIter << "\n";
+
+    file.close();
+
+    if (file.fail() || rename(tempName.str().c_str(), fileName.c_str()) != 0)
+    {
+        remove(tempName.str().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ObfWarmStart::read(const std::string& fileName, const std::string& key)
+{
+    std::ifstream file(fileName.c_str());
+
+    if (!file.is_open()) return false;
+
+    ObfWarmStart snapshot;
+    int          version = 0;
+    std::string  line;
+
+    while(std::getline(file, line))
+    {
+        std::istringstream lineStream(line);
+        std::string        item;
+
+        if (!(lineStream >> item) || item[0] == '#') continue;
+
+        if      (item == "version") lineStream >> version;
+        else if (item == "key")     lineStream >> snapshot.m_key;
+        else if (item == "library")
+        {
+            // File names may hold blanks, take the rest of the line
+            std::string library;
+            std::getline(lineStream >> std::ws, library);
+            snapshot.m_libraries.push_back(library);
+        }
+        else if (item == "modes")
+        {
+            unsigned short int schemaId = 0;
+            int                config   = 0;
+            std::vector<int>   configs;
+
+            lineStream >> schemaId;
+            while(lineStream >> config) configs.push_back(config);
+
+            snapshot.m_modeConfigs[schemaId] = configs;
+        }
+        else if (item == "active")
+        {
+            unsigned int activeFilter = 0;
+            if (lineStream >> activeFilter) snapshot.m_activeFilters.push_back(activeFilter);
+        }
+    }
+
+    if (version != CurrentVersion || snapshot.m_key != key) return false;
+
+    *this = snapshot;
+
+    return true;
+}
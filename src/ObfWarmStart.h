@@ -0,0 +1,75 @@
+/** @file ObfWarmStart.h
+*
+* @class ObfWarmStart
+*
+* @brief Snapshot of what initializing the filters worked out, so that a later job with the
+*        same FSW release, Moot key and job options can start warm.
+*
+*        The EDS_fw and EFC structures themselves are not saved: they hold pointers into the
+*        FSW libraries, which are mapped at different addresses in every process, into CDM
+*        and CMX registries filled by the library constructors, and the EDS_fw handler
+*        tables with the routines registered by each filter. None of that can be restored
+*        from a file. What is saved is everything that took lookups to decide:
+*          - the libraries loaded, in load order, so a warm job prefetches all of them at
+*            once before the first is needed
+*          - the configuration each filter associated with each mode, so the filter tools
+*            do not query Moot again
+*          - the active filter list
+*
+*        The file is plain text, one item per line, and is only used if its key matches.
+*
+*        No dependence on Gaudi or the flight software.
+*
+* $Header$
+*/
+
+#ifndef __ObfWarmStart_H
+#define __ObfWarmStart_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+class ObfWarmStart
+{
+public:
+    enum {CurrentVersion = 1};
+
+    typedef std::map<unsigned short int, std::vector<int> > ModeConfigMap;
+
+    ObfWarmStart() {}
+
+    /// Key from the release, Moot key and a hash of the job options
+    static std::string makeKey(const std::string& release, unsigned int mootKey, unsigned long long joHash);
+
+    /// FNV-1a hash, for job option strings
+    static unsigned long long hash(const std::string& text, unsigned long long seed = 14695981039346656037ULL);
+
+    void               setKey(const std::string& key)       {m_key = key;}
+    const std::string& key() const                          {return m_key;}
+
+    void setLibraries(const std::vector<std::string>& libraries) {m_libraries = libraries;}
+    const std::vector<std::string>& libraries() const            {return m_libraries;}
+
+    /// Configuration associated with each mode, -1 if none, by filter schema id
+    void setModeConfigs(unsigned short int schemaId, const std::vector<int>& configs) {m_modeConfigs[schemaId] = configs;}
+    const std::vector<int>* modeConfigs(unsigned short int schemaId) const;
+    const ModeConfigMap&    modeConfigMap() const {return m_modeConfigs;}
+
+    void setActiveFilters(const std::vector<unsigned int>& activeFilters) {m_activeFilters = activeFilters;}
+    const std::vector<unsigned int>& activeFilters() const                {return m_activeFilters;}
+
+    /// Write the snapshot, returns false on failure
+    bool write(const std::string& fileName) const;
+
+    /// Read a snapshot, returns false if there is none or its key is not the one given
+    bool read(const std::string& fileName, const std::string& key);
+
+private:
+    std::string               m_key;
+    std::vector<std::string>  m_libraries;
+    ModeConfigMap             m_modeConfigs;
+    std::vector<unsigned int> m_activeFilters;
+};
+
+#endif // __ObfWarmStart_H
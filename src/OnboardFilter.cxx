@@ -14,6 +14,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
  
 #include "GaudiKernel/Algorithm.h"
 #include "GaudiKernel/MsgStream.h"
@@ -21,6 +24,8 @@
 #include "GaudiKernel/IDataProviderSvc.h"
 #include "GaudiKernel/SmartDataPtr.h"
 #include "GaudiKernel/Property.h"
+#include "GaudiKernel/IJobOptionsSvc.h"
+#include "GaudiKernel/DataObject.h"
 
 // Moot stuff for discerning filter configurations
 #include "CalibData/Moot/MootData.h"
@@ -34,11 +39,31 @@
 #include "facilities/commonUtilities.h"
 
 #include "Event/TopLevel/EventModel.h"
+#include "Event/TopLevel/Event.h"
 #include "EbfWriter/Ebf.h"
 //#include "OnboardFilterTds/FilterStatus.h"
 #include "OnboardFilterTds/ObfFilterStatus.h"
+#include "OnboardFilterTds/ObfFilterTrack.h"
+
+// For the mode definitions
+#include "EFC_DB/EFC_DB_schema.h"
+
+// For the GEM summary the pre-veto reads
+#include "EFC/EFC_edsFw.h"
+#include "EDS/EBF_dir.h"
+#include "EDS/EBF_cid.h"
+#include "EDS/EBF_gem.h"
 
 #include "ObfInterface.h"
+#include "ObfPerfMonitor.h"
+#include "ObfWarmStart.h"
+#include "ObfMootConfigCache.h"
+#include "ObfDecisionEngine.h"
+#include "ObfSampler.h"
+#include "ObfBudgetController.h"
+#include "ObfAdaptiveOrder.h"
+#include "ObfGemPreVeto.h"
+#include "ObfResultCache.h"
 #include "IFilterTool.h"
 
 class OnboardFilter:public Algorithm
@@ -62,6 +87,53 @@ private:
 
     StatusCode initFilters();
 
+    // Accept/reject decision for a filter from its summary byte
+    static bool filterAccepts(unsigned char sb);
+
+    // Schema id of an entry in the active filter list
+    unsigned int activeFilterSchema(unsigned int activeFilter) const;
+
+    // Compile the accept expression, by default any active filter accepting
+    StatusCode compileDecision();
+
+    // Decision engine input bits of a filter from its summary byte
+    static unsigned int decisionBits(int slot, unsigned char sb);
+
+    // Accept decision for the current event from the filter results, made once per event
+    bool decideEvent();
+
+    // End of event call back giving the decision to the "accepted events only" output tools
+    static bool eovDecision(void* prm);
+
+    // Is the decision fixed by the adaptively ordered filters run so far?
+    static bool partialDecision(void* prm, unsigned int ranFilters, const unsigned char* sbs, bool& decision);
+
+    // Run the filters the decision uses from the sweep, in adaptive order and/or after the GEM pre-veto
+    StatusCode setupFilterSweep();
+
+    // Name of the first filter the decision uses which prescales events in the current mode, "" if none
+    std::string prescalingFilter();
+
+    // Refuse to skip filters which prescale, or to take their results from the cache, checked
+    // at set up and on each mode change
+    StatusCode checkPrescalers();
+
+    // Decide the event from its GEM summary if a pre-veto rule can
+    static bool gemPreDecision(void* prm, EDS_fwIxb* ixb);
+
+    // Open the result cache for this setup
+    StatusCode setupResultCache();
+
+    // Filter results of the current event to and from a result cache entry
+    void cacheRecord(ObfGoldenRecord& record);
+    void restoreRecord(const ObfGoldenRecord& record);
+
+    // Evaluate the current event under every mode
+    void evaluateAllModes();
+
+    // Key a warm start snapshot must match: FSW release, Moot key and our job options
+    std::string warmStartKey();
+
     /* ====================================================================== */
     /* Member variables                                                       */
     /* ====================================================================== */
@@ -74,6 +146,27 @@ private:
     BooleanProperty m_passThrough;     // Set up the passthrough filter?
     BooleanProperty m_rejectEvents;    // Enables rejection of events from list of "active" filters
     IntegerProperty m_gamBitsToIgnore; // This sets a mask of gamma filter veto bits to ignore
+    BooleanProperty m_timeKernels;     // Time the filter call and the veto decision loop
+    BooleanProperty m_evaluateAllModes;// Decide every event under the configuration of every mode
+    StringProperty  m_modeMatrixFile;  // Output of the per event mode decision matrix
+    BooleanProperty m_deferConfigLoad; // Only load the configuration libraries the modes use
+    StringProperty  m_libraryBundle;   // Bundle of all the FSW libraries to load from
+    StringProperty  m_libraryCacheDir; // Node local directory for the bundled libraries
+    StringProperty  m_warmStartFile;   // Snapshot of the filter initialization to start from
+    StringProperty  m_acceptExpression;// Which filter results accept an event, see ObfDecisionEngine.h
+    DoubleProperty  m_eventBudgetUs;   // Filter time budget per event, throttles the optional work
+    DoubleProperty  m_budgetSmoothing; // Weight of each event in the moving average cost
+    IntegerProperty m_budgetInterval;  // Events between throttle adjustments
+    IntegerProperty m_maxThrottle;     // Largest factor the sample rates are throttled by
+    StringProperty  m_budgetLogFile;   // Record of the throttle changes, for reweighting
+    DoubleProperty  m_eventTimeLimitUs;// Watchdog limit on the filter time of a single event
+    BooleanProperty m_adaptiveOrder;   // Run the deciding filters cheapest first, only until decided
+    IntegerProperty m_adaptiveVerify;  // Events between full runs checking the adaptive order
+    BooleanProperty m_gemPreVetoOn;    // Learn GEM summary rules and check every firing against the filters
+    BooleanProperty m_gemPreVetoLossy; // Let the GEM rules decide events unchecked
+    IntegerProperty m_gemTraining;     // Events a GEM signature needs before its rule is used
+    IntegerProperty m_gemCheckInterval;// Firings of a lossy GEM rule between checks against the filters
+    StringProperty  m_resultCacheDir;  // Where filter results are cached by event content
 
     // Filters to configure and run, not necessarily the "active" filters...
     StringArrayProperty m_filterList;
@@ -86,6 +179,7 @@ private:
     int              m_events;          // # events run through filter
     int              m_rejected;        // # events rejected by filters
     int              m_noEbfData;       // # events with no ebf data (MC only? Trigger reject)
+    int              m_timeouts;        // # events which ran out of time
     bool             m_failNoEbfData;   // If we don't have ebf data should we crash?
 
     // Now to member variables
@@ -102,8 +196,50 @@ private:
     // Cache the "current mode" we are running
     enums::Lsf::Mode m_curMode;
 
+    // Tools to set the mode of on a mode change, looked up once in initFilters
+    typedef std::vector<IFilterTool*> FilterToolVec;
+    FilterToolVec    m_modeTools;
+
     // Cache our initialization status
     bool             m_initialized;
+
+    // Timing of the filter call and veto loop when TimeKernels is set
+    ObfKernelStats   m_filterEventStats;
+    ObfKernelStats   m_vetoLoopStats;
+
+    // Relate the TDS keys in the active filter list to filter schema ids
+    typedef std::map<unsigned int, unsigned int> KeyToSchemaMap;
+    KeyToSchemaMap   m_keyToSchemaMap;
+
+    // Filters the accept expression can name, TDS key and name by decision engine slot
+    std::vector<unsigned int> m_decisionKeys;
+    std::vector<std::string>  m_decisionNames;
+    ObfDecisionEngine         m_decision;
+
+    // Decision engine slot of each adaptively ordered filter
+    std::vector<unsigned int> m_orderedSlots;
+
+    // GEM pre-veto rules, the current event's signature and what they made of it
+    ObfGemPreVeto             m_gemPreVeto;
+    unsigned long long        m_gemKey;
+    bool                      m_gemKeyValid;
+    ObfGemPreVeto::Verdict    m_gemVerdict;
+
+    // Filter results of events seen before
+    ObfResultCache            m_resultCache;
+
+    // Current event's filter status and its decision, once made
+    OnboardFilterTds::ObfFilterStatus* m_curStatus;
+    bool                      m_decided;
+    bool                      m_accepted;
+
+    // Control of the optional work against the time budget, and its record
+    ObfBudgetController       m_budget;
+    std::ofstream             m_budgetLog;
+
+    // All modes evaluation, events accepted in each mode and the output matrix
+    int              m_modeAccepted[EFC_DB_MODE_K_CNT];
+    std::ofstream    m_modeMatrix;
 };
 
 
@@ -115,7 +251,9 @@ private:
 DECLARE_ALGORITHM_FACTORY(OnboardFilter);
 
 OnboardFilter::OnboardFilter(const std::string& name, ISvcLocator *pSvcLocator) : Algorithm(name,pSvcLocator), 
-          m_events(0), m_rejected(0), m_noEbfData(0), m_curMode(enums::Lsf::NoMode), m_mootSvc(0), m_initialized(false)
+          m_events(0), m_rejected(0), m_noEbfData(0), m_timeouts(0), m_curMode(enums::Lsf::NoMode), m_mootSvc(0), m_initialized(false),
+          m_filterEventStats("ObfInterface::filterEvent"), m_vetoLoopStats("OnboardFilter veto loop"),
+          m_gemKey(0), m_gemKeyValid(false), m_gemVerdict(ObfGemPreVeto::Open), m_curStatus(0), m_decided(false), m_accepted(true)
 {
 
     // Properties for this algorithm
@@ -138,6 +276,71 @@ OnboardFilter::OnboardFilter(const std::string& name, ISvcLocator *pSvcLocator)
     // Paramter: FilterList
     // This contains the list of filters which will be configured and run by this algorithm
     declareProperty("FilterList",       m_filterList);
+    // Parameter: TimeKernels
+    // Default is TO NOT time the filter call and the veto decision loop
+    declareProperty("TimeKernels",      m_timeKernels        = false);
+    // Parameter: EvaluateAllModes
+    // Default is TO NOT also evaluate each event under the configuration of every mode
+    declareProperty("EvaluateAllModes", m_evaluateAllModes   = false);
+    // Parameter: ModeMatrixFile
+    // If set (and EvaluateAllModes), one line per event with the accept decision in each mode
+    declareProperty("ModeMatrixFile",   m_modeMatrixFile     = "");
+    // Parameter: DeferConfigLoading
+    // Default is TO load only the configuration libraries set up or associated with a mode,
+    // set false to load every instance listed in each filter's master configuration
+    declareProperty("DeferConfigLoading", m_deferConfigLoad  = true);
+    // Parameter: LibraryBundle
+    // If set, FSW libraries found in this bundle (made by obfBundle) are loaded from a node
+    // local copy instead of their own location
+    declareProperty("LibraryBundle",    m_libraryBundle      = "");
+    // Parameter: LibraryCacheDir
+    // Where the bundled libraries are copied to, default is $TMPDIR or /tmp
+    declareProperty("LibraryCacheDir",  m_libraryCacheDir    = "");
+    // Parameter: WarmStartFile
+    // If set, the filter initialization is read from this file when it matches the FSW release,
+    // Moot key and job options of this job, and is written to it otherwise
+    declareProperty("WarmStartFile",    m_warmStartFile      = "");
+    // Parameter: AcceptExpression
+    // Boolean expression over the filter results deciding which events are accepted when
+    // RejectEvents is set, e.g. "Gamma | (HIP & !DGN)". Default is any active filter accepting
+    declareProperty("AcceptExpression", m_acceptExpression   = "");
+    // Parameter: EventBudgetUs
+    // If set, the filter time per event (in microseconds) is kept under this on average by
+    // throttling the sampling of optional filters and output tools, see ObfBudgetController.h
+    declareProperty("EventBudgetUs",    m_eventBudgetUs      = 0.);
+    declareProperty("BudgetSmoothing",  m_budgetSmoothing    = 0.02);
+    declareProperty("BudgetInterval",   m_budgetInterval     = 100);
+    declareProperty("MaxThrottle",      m_maxThrottle        = 64);
+    // Parameter: BudgetLogFile
+    // One line per throttle change: events seen, run, event, average cost and new factor
+    declareProperty("BudgetLogFile",    m_budgetLogFile      = "");
+    // Parameter: EventTimeLimitUs
+    // If set, an event taking longer than this (in microseconds) gets only the filter results
+    // and decision, no output tools, and is marked by /Event/Filter/ObfWatchdogTimeout
+    declareProperty("EventTimeLimitUs", m_eventTimeLimitUs   = 0.);
+    // Parameter: AdaptiveOrder
+    // If set (with RejectEvents), the filters the accept decision uses run cheapest first and
+    // only until the decision is fixed, the others give no result for the event
+    declareProperty("AdaptiveOrder",    m_adaptiveOrder      = false);
+    // Parameter: AdaptiveVerifyInterval
+    // Every this many events all of them run, to measure them and check the early stop
+    declareProperty("AdaptiveVerifyInterval", m_adaptiveVerify = 1000);
+    // Parameter: GemPreVeto
+    // If set (with RejectEvents), rules are learned for which GEM summaries always lead to the
+    // same decision and each firing is checked against the filters, which still decide every
+    // event. Measures what a pre-veto would do, see ObfGemPreVeto.h
+    declareProperty("GemPreVeto",       m_gemPreVetoOn       = false);
+    // Parameter: GemPreVetoLossy
+    // LOSSY: with GemPreVeto, a rule in use decides its events without running the filters, but
+    // for every GemPreVetoCheckInterval-th firing. Events decided unchecked may be decided wrong
+    declareProperty("GemPreVetoLossy",  m_gemPreVetoLossy    = false);
+    declareProperty("GemPreVetoTraining",      m_gemTraining      = 1000);
+    declareProperty("GemPreVetoCheckInterval", m_gemCheckInterval = 100);
+    // Parameter: ResultCacheDir
+    // If set, the filter results of each event are kept in a file there for the FSW release,
+    // libraries and job options of this job, and an event already in it is not filtered
+    // again. A hit restores ObfFilterStatus and ObfFilterTrack only, see ObfResultCache.h
+    declareProperty("ResultCacheDir",   m_resultCacheDir     = "");
 
     // Set up default list of filters to configure for running 
     // This should not normally be changed by JO parameters! 
@@ -163,15 +366,31 @@ OnboardFilter::OnboardFilter(const std::string& name, ISvcLocator *pSvcLocator)
     m_idToToolNameMap[HIP_DB_SCHEMA]   = "HIPFilterTool";
     m_idToToolNameMap[MIP_DB_SCHEMA]   = "MIPFilterTool";
     m_idToToolNameMap[DGN_DB_SCHEMA]   = "DGNFilterTool";
+
+    // And the TDS keys
+    m_keyToSchemaMap[OnboardFilterTds::ObfFilterStatus::GammaFilter] = GAMMA_DB_SCHEMA;
+    m_keyToSchemaMap[OnboardFilterTds::ObfFilterStatus::HIPFilter]   = HIP_DB_SCHEMA;
+    m_keyToSchemaMap[OnboardFilterTds::ObfFilterStatus::MIPFilter]   = MIP_DB_SCHEMA;
+    m_keyToSchemaMap[OnboardFilterTds::ObfFilterStatus::DGNFilter]   = DGN_DB_SCHEMA;
+
+    // And the names the accept expression knows them by
+    m_decisionKeys.push_back(OnboardFilterTds::ObfFilterStatus::GammaFilter);
+    m_decisionNames.push_back("Gamma");
+    m_decisionKeys.push_back(OnboardFilterTds::ObfFilterStatus::HIPFilter);
+    m_decisionNames.push_back("HIP");
+    m_decisionKeys.push_back(OnboardFilterTds::ObfFilterStatus::MIPFilter);
+    m_decisionNames.push_back("MIP");
+    m_decisionKeys.push_back(OnboardFilterTds::ObfFilterStatus::DGNFilter);
+    m_decisionNames.push_back("DGN");
+
+    memset(m_modeAccepted, 0, EFC_DB_MODE_K_CNT*sizeof(int));
 }
 /* --------------------------------------------------------------------- */
 
 
 StatusCode OnboardFilter::initialize()
 {
-    // Some shenanigans to get a persistent stream reference to pass to obfInterface...
-    MsgStream* logPtr = new MsgStream(msgSvc(), name());
-    MsgStream& log    = (*logPtr);
+    MsgStream  log(msgSvc(), name());
 
     StatusCode sc     = StatusCode::SUCCESS;
 
@@ -182,6 +401,25 @@ StatusCode OnboardFilter::initialize()
     // Get an instance of the filter interface
     m_obfInterface = ObfInterface::instance();
 
+    // Before any filter tool loads its libraries
+    m_obfInterface->setDeferConfigLoading(m_deferConfigLoad.value());
+
+    // Watchdog on the time of each event
+    m_obfInterface->setEventTimeBudget((long long)(1000. * m_eventTimeLimitUs.value()));
+
+    if (m_libraryBundle.value() != "")
+    {
+        std::string error;
+
+        if (!m_obfInterface->setLibraryBundle(m_libraryBundle.value(), m_libraryCacheDir.value(), error))
+        {
+            log << MSG::ERROR << "Unable to use library bundle: " << error << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        log << MSG::INFO << "Loading FSW libraries from bundle " << m_libraryBundle.value() << endreq;
+    }
+
 #ifdef SCons
     using facilities::commonUtilities;
     std::string obfldpath("$(OBFLDPATH)");
@@ -310,22 +548,50 @@ StatusCode OnboardFilter::initFilters()
 
     log << MSG::INFO << "Initializing Filter Settings" << endreq;
 
+    // Start from a snapshot of an earlier job if there is one for this setup
+    std::string  warmStartFile = m_warmStartFile.value();
+    std::string  warmStartKey  = "";
+    ObfWarmStart warmStart;
+    bool         warm          = false;
+
+    if (warmStartFile != "")
+    {
+        facilities::Util::expandEnvVar(&warmStartFile);
+
+        warmStartKey = this->warmStartKey();
+        warm         = warmStart.read(warmStartFile, warmStartKey);
+
+        if (warm)
+        {
+            log << MSG::INFO << "Warm start from " << warmStartFile << ", " << warmStart.libraries().size() 
+                << " libraries" << endreq;
+
+            m_obfInterface->setWarmStart(warmStart);
+            m_obfInterface->prefetchFiles(warmStart.libraries());
+        }
+        else log << MSG::INFO << "No warm start for key " << warmStartKey << " in " << warmStartFile << endreq;
+    }
+
+    // The active filters Moot gave the earlier job
+    if (warm && m_mootConfig.value())
+    {
+        m_activeFilters = warmStart.activeFilters();
+    }
     // If using moot to configure for the filter configuration then do here
-    if (m_mootConfig.value())
+    else if (m_mootConfig.value())
     {
-        // Get back the list of active filters
-        std::vector<CalibData::MootFilterCfg> filterCfgVec;
-        unsigned int filterCnt = m_mootSvc->getActiveFilters(filterCfgVec);
+        // Get back the list of active filters, the filter tools share the same lookup
+        const ObfMootConfigCache::ActiveFilterVec& mootFilters = ObfMootConfigCache::instance()->activeFilters(m_mootSvc);
 
         // Clear the active filter list and re-populate from Moot...
         m_activeFilters.clear();
 
         // Loop through the available moot configurations. 
-        for(std::vector<CalibData::MootFilterCfg>::const_iterator filterIter = filterCfgVec.begin();
-            filterIter != filterCfgVec.end(); filterIter++)
+        for(ObfMootConfigCache::ActiveFilterVec::const_iterator filterIter = mootFilters.begin();
+            filterIter != mootFilters.end(); filterIter++)
         {
-            log << MSG::INFO << "Moot has filter " <<  filterIter->getName() << " as active" << endreq;
-            m_activeFilters.push_back(filterIter->getSchemaId());
+            log << MSG::INFO << "Moot has filter " <<  filterIter->m_name << " as active" << endreq;
+            m_activeFilters.push_back(filterIter->m_schemaId);
         }
     }
 
@@ -346,9 +612,72 @@ StatusCode OnboardFilter::initFilters()
         // Dump the initialized configuration
         toolPtr->dumpConfiguration();
 
+        // Without moot all the filters we have set up follow the mode
+        if (!m_mootConfig.value()) m_modeTools.push_back(toolPtr);
+
         nFilters++;
     }
 
+    // With moot only the active filters follow the mode
+    if (m_mootConfig.value())
+    {
+        for(ActiveFilterVec::const_iterator activeIter = m_activeFilters.begin(); activeIter != m_activeFilters.end(); activeIter++)
+        {
+            // Use the schema id to retrieve the tool name to change the mode for 
+            IdToNameMap::iterator nameIter = m_idToToolNameMap.find(*activeIter);
+
+            // Ok, this just can't happen, right?
+            if (nameIter == m_idToToolNameMap.end())
+            {
+                log << MSG::ERROR << "Cannot translate Moot schema id " << *activeIter << endreq;
+                return StatusCode::FAILURE;
+            }
+
+            // Look up the tool and check we found it... just in case...
+            if (StatusCode sc = toolSvc()->retrieveTool(nameIter->second, toolPtr, this) == StatusCode::FAILURE)
+            {
+                log << MSG::ERROR << "Failed to find the " << nameIter->second << " tool" << endreq;
+                return sc;
+            }
+
+            m_modeTools.push_back(toolPtr);
+        }
+    }
+
+    // Now the active filters are known we can work out the decision
+    if (compileDecision().isFailure()) return StatusCode::FAILURE;
+
+    // When rejecting events the output tools can skip the rejects
+    if (m_rejectEvents) m_obfInterface->setEovDecision(eovDecision, this);
+
+    // And the filters deciding need only run until the decision is made
+    if ((m_adaptiveOrder.value() || m_gemPreVetoOn.value()) && setupFilterSweep().isFailure()) return StatusCode::FAILURE;
+
+    // Keep to a time budget if asked
+    if (m_eventBudgetUs.value() > 0.)
+    {
+        m_budget = ObfBudgetController(1000. * m_eventBudgetUs.value(), m_budgetSmoothing.value(), 
+                                       m_budgetInterval.value(), m_maxThrottle.value());
+
+        log << MSG::INFO << "Throttling optional filter work to " << m_eventBudgetUs.value() << " us per event" << endreq;
+
+        if (m_budgetLogFile.value() != "")
+        {
+            std::string fileName = m_budgetLogFile.value();
+            facilities::Util::expandEnvVar(&fileName);
+
+            m_budgetLog.open(fileName.c_str());
+
+            if (!m_budgetLog.is_open())
+            {
+                log << MSG::ERROR << "Unable to open budget log file " << fileName << endreq;
+                return StatusCode::FAILURE;
+            }
+
+            m_budgetLog << "# Throttle changes: events seen, run, event, average ns per event, new throttle factor\n";
+        }
+    }
+
     // Set up a "passthrough" filter which allows us to always retrieve results from 
     // the filters after they have run
     if (!m_obfInterface->setupPassThrough(0))
@@ -356,6 +685,52 @@ StatusCode OnboardFilter::initFilters()
         log << MSG::ERROR << "Failed to initialize pass through Filter" << endreq;
     }
 
+    // Set up a copy of each filter for every mode if asked
+    if (m_evaluateAllModes.value())
+    {
+        int nShadows = m_obfInterface->setupModeShadows();
+
+        log << MSG::INFO << "Evaluating all modes with " << nShadows << " filter copies" << endreq;
+
+        if (m_modeMatrixFile.value() != "")
+        {
+            std::string fileName = m_modeMatrixFile.value();
+            facilities::Util::expandEnvVar(&fileName);
+
+            m_modeMatrix.open(fileName.c_str());
+
+            if (!m_modeMatrix.is_open())
+            {
+                log << MSG::ERROR << "Unable to open mode matrix file " << fileName << endreq;
+                return StatusCode::FAILURE;
+            }
+
+            m_modeMatrix << "# Accept (1) or reject (0) by the active filters in each mode\n# run event";
+            for(int mode = 0; mode < EFC_DB_MODE_K_CNT; mode++) m_modeMatrix << " mode" << mode;
+            m_modeMatrix << "\n";
+        }
+    }
+
+    // Save what we worked out for the next job
+    if (warmStartFile != "" && !warm)
+    {
+        warmStart.setKey(warmStartKey);
+        warmStart.setLibraries(m_obfInterface->loadedLibraries());
+        warmStart.setActiveFilters(m_activeFilters);
+
+        for(IdToNameMap::const_iterator idIter = m_idToToolNameMap.begin(); idIter != m_idToToolNameMap.end(); idIter++)
+        {
+            if (const std::vector<int>* modeConfigs = m_obfInterface->getModeConfigs(idIter->first))
+                warmStart.setModeConfigs(idIter->first, *modeConfigs);
+        }
+
+        if (warmStart.write(warmStartFile)) log << MSG::INFO << "Wrote warm start to " << warmStartFile << endreq;
+        else                                log << MSG::WARNING << "Unable to write warm start to " << warmStartFile << endreq;
+    }
+
+    // Results already worked out for this setup
+    if (m_resultCacheDir.value() != "" && setupResultCache().isFailure()) return StatusCode::FAILURE;
+
     // Ok, if here we are initialized!
     m_initialized = true;
   
@@ -409,72 +784,16 @@ StatusCode OnboardFilter::execute()
             log << MSG::INFO << "Detected a mode change from MetaEvent datagram, changing from " << m_curMode 
                 << " to " << mode << endreq;
 
-            // If moot is controlling the configuration, then go through here to set the modes
-            if (m_mootConfig.value())
+            // The filters have everything for each mode set up already, so this only selects it
+            for(FilterToolVec::iterator toolIter = m_modeTools.begin(); toolIter != m_modeTools.end(); toolIter++)
             {
-                // Look up from MootSvc the list of active filters (in case it changes) 
-                std::vector<CalibData::MootFilterCfg> filterCfgVec;
-                unsigned int filterCnt = m_mootSvc->getActiveFilters(filterCfgVec);
-
-                // Clear the active filter list and re-populate from Moot...
-                m_activeFilters.clear();
-
-                // Filter Tool pointer...
-                IFilterTool* toolPtr = 0;
-
-                // Loop through the available moot configurations. 
-                for(std::vector<CalibData::MootFilterCfg>::const_iterator filterIter = filterCfgVec.begin();
-                    filterIter != filterCfgVec.end(); filterIter++)
-                {
-                    log << MSG::INFO << "Moot has filter " <<  filterIter->getName() << " as active" << endreq;
-                    m_activeFilters.push_back(filterIter->getSchemaId());
-
-                    // Use the schema id to retrieve the tool name to change the mode for 
-                    IdToNameMap::iterator nameIter = m_idToToolNameMap.find(filterIter->getSchemaId());
-
-                    // Ok, this just can't happen, right?
-                    if (nameIter == m_idToToolNameMap.end())
-                    {
-                        log << MSG::ERROR << "Cannot translate Moot schema id " << filterIter->getSchemaId() << endreq;
-                        return StatusCode::FAILURE;
-                    }
-
-                    std::string filterTool = nameIter->second;
-
-                    // Look up the tool and check we found it... just in case...
-                    if (StatusCode sc = toolSvc()->retrieveTool(filterTool, toolPtr, this) == StatusCode::FAILURE)
-                    {
-                        log << MSG::ERROR << "Failed to find the " << filterTool << " tool" << endreq;
-                        return sc;
-                    }
-
-                    // Finally... set the new mode
-                    toolPtr->setMode(mode);
-                }
-            }
-            // If no moot, then set the mode for all the filters we have set up
-            else
-            {
-                // Loop through the list of filters to configure
-                IFilterTool* toolPtr    = 0;
-                int          nFilters   = 0;
-                const std::vector<std::string>& filterList = m_filterList;
-                for(std::vector<std::string>::const_iterator filterIter = filterList.begin(); filterIter != filterList.end(); filterIter++)
-                {
-                    std::string filterTool = *filterIter + "Tool";
-
-                    if (StatusCode sc = toolSvc()->retrieveTool(filterTool, toolPtr, this) == StatusCode::FAILURE)
-                    {
-                        log << MSG::ERROR << "Failed to initialize the " << *filterIter << " tool" << endreq;
-                        return sc;
-                    }
-
-                    // Dump the initialized configuration
-                    toolPtr->setMode(mode);
-                }
+                (*toolIter)->setMode(mode);
             }
 
             m_curMode = mode;
+
+            // The new mode's configurations may prescale
+            if (checkPrescalers().isFailure()) return StatusCode::FAILURE;
         }
     }
 
@@ -502,49 +821,118 @@ StatusCode OnboardFilter::execute()
         log << MSG::ERROR << "Could not register new ObfFilterStatus object in TDS" << endreq;
     }
 
-    try
+    // The decision may be asked for at end of event, before the filter call returns
+    m_curStatus = obfStatus;
+    m_decided   = false;
+
+    // Set if the GEM pre-veto looks at the event
+    m_gemKeyValid = false;
+    m_gemVerdict  = ObfGemPreVeto::Open;
+
+    // Pick the sampled filters and tools to run on this event
+    SmartDataPtr<Event::EventHeader> header(eventSvc(), EventModel::EventHeader);
+
+    // Seen this event before?
+    ObfResultCache::Key cacheKey;
+    ObfGoldenRecord     cached;
+    bool                cacheHit = false;
+
+    if (m_resultCache.isOpen())
     {
-        // Call the filter
-        unsigned int fate = m_obfInterface->filterEvent(ebfData);
+        unsigned int length = 0;
+        char*        data   = ebfData->get(length);
+
+        cacheKey = ObfResultCache::key(data, length, m_curMode);
+        cacheHit = m_resultCache.find(cacheKey, cached);
+
+        if (cacheHit) restoreRecord(cached);
+    }
 
-        if (fate != 4)
+    m_obfInterface->selectSampledEvent(header ? header->run() : 0, header ? header->event() : m_events);
+
+    long long startNs = m_budget.enabled() ? ObfPerfMonitor::wallTimeNs() : 0;
+
+    if (!cacheHit)
+    {
+        try
         {
-            log << MSG::ERROR << "Error in filter processing, fate = " << fate << endreq;
+            // Call the filter
+            if (m_timeKernels) m_filterEventStats.start();
+            unsigned int fate = m_obfInterface->filterEvent(ebfData);
+            if (m_timeKernels) m_filterEventStats.stop();
+
+            if (fate != 4)
+            {
+                log << MSG::ERROR << "Error in filter processing, fate = " << fate << endreq;
+            }
+
+            // Keep the results for the next time round
+            if (m_resultCache.isOpen())
+            {
+                cacheRecord(cached);
+
+                if (!m_resultCache.store(cacheKey, cached))
+                {
+                    log << MSG::WARNING << "Unable to write to result cache " << m_resultCache.fileName() << ", no longer caching" << endreq;
+                    m_resultCache.close();
+                }
+            }
+        }
+        catch(ObfInterface::ObfException& obfException)
+        {
+            log << MSG::INFO << obfException.m_what << endreq;
         }
     }
-    catch(ObfInterface::ObfException& obfException)
+
+    // Mark an event which ran out of time, it only has the filter results
+    if (m_obfInterface->eventTimedOut())
     {
-        log << MSG::INFO << obfException.m_what << endreq;
+        m_timeouts++;
+
+        log << MSG::WARNING << "Run " << (header ? header->run() : 0) << " event " << (header ? header->event() : m_events) 
+            << " exceeded the filter time limit of " << m_eventTimeLimitUs.value() << " us" << endreq;
+
+        if (eventSvc()->registerObject("/Event/Filter/ObfWatchdogTimeout", new DataObject()).isFailure())
+        {
+            log << MSG::ERROR << "Could not register ObfWatchdogTimeout marker in TDS" << endreq;
+        }
     }
 
-    // Check to see if we are vetoing events at this stage
-    if (m_rejectEvents)
+    // Adjust the optional work for the next events to the budget
+    if (m_budget.enabled() && m_budget.addEvent(ObfPerfMonitor::wallTimeNs() - startNs, 
+                                                header ? header->run() : 0, header ? header->event() : m_events))
     {
-        bool rejectEvent = true;
+        const ObfBudgetController::Change& change = m_budget.changes().back();
 
-        // Loop through the list of filters to apply
-        for(ActiveFilterVec::iterator filtItr = m_activeFilters.begin(); filtItr != m_activeFilters.end(); filtItr++)
-        {
-            // Retrieve enum
-            OnboardFilterTds::ObfFilterStatus::FilterKeys key = (OnboardFilterTds::ObfFilterStatus::FilterKeys)(*filtItr);
+        m_obfInterface->setSampleThrottle(change.m_to);
 
-            // Look up the information for this filter
-            const OnboardFilterTds::IObfStatus* filterStat = obfStatus->getFilterStatus(key);
+        log << MSG::DEBUG << "Average " << change.m_averageNs << " ns per event, optional work throttled by " 
+            << change.m_to << endreq;
 
-            // Make sure the filter ran
-            if (!filterStat) continue;
+        if (m_budgetLog.is_open()) 
+            m_budgetLog << change.m_eventCount << " " << change.m_run << " " << change.m_event << " " 
+                        << change.m_averageNs << " " << change.m_to << "\n";
+    }
 
-            // Look at sb to determine how to handle the event
-            unsigned char sb = filterStat->getFiltersb();
+    // Decide the event in every mode
+    if (m_evaluateAllModes.value()) evaluateAllModes();
 
-            // Two cases: event was accepted and no prescale or event was rejected and prescale
-            sb = (sb & (EDS_RSD_SB_M_VETOED | EDS_RSD_SB_M_PRESCALE_OUT)) >> EDS_RSD_SB_V_PRESCALE_OUT;
+    // Check to see if we are vetoing events at this stage
+    if (m_rejectEvents)
+    {
+        // Made already if the output tools asked for it
+        bool rejectEvent = !decideEvent();
 
-            if (  (sb == 0)   // Event accepted and prescale does not flip the decision
-               || (sb == 3) ) // Event rejected and prescale flips the decision (making it accepted)
+        // Events the filters decided train or check the GEM rules
+        if (m_gemKeyValid && (m_gemVerdict == ObfGemPreVeto::Open || m_gemVerdict == ObfGemPreVeto::Check))
+            m_gemPreVeto.addDecision(m_gemKey, !rejectEvent, m_gemVerdict);
+
+        // Mark an event decided by the GEM pre-veto, it has no filter results
+        if (m_gemVerdict == ObfGemPreVeto::Accept || m_gemVerdict == ObfGemPreVeto::Reject)
+        {
+            if (eventSvc()->registerObject("/Event/Filter/ObfGemPreVeto", new DataObject()).isFailure())
             {
-                rejectEvent = false;
-                break;
+                log << MSG::ERROR << "Could not register ObfGemPreVeto marker in TDS" << endreq;
             }
         }
 
@@ -561,14 +949,610 @@ StatusCode OnboardFilter::execute()
 
 /* --------------------------------------------------------------------- */
 
+bool OnboardFilter::filterAccepts(unsigned char sb)
+{
+    // Two cases: event was accepted and no prescale or event was rejected and prescale
+    sb = (sb & (EDS_RSD_SB_M_VETOED | EDS_RSD_SB_M_PRESCALE_OUT)) >> EDS_RSD_SB_V_PRESCALE_OUT;
+
+    return (sb == 0)   // Event accepted and prescale does not flip the decision
+        || (sb == 3);  // Event rejected and prescale flips the decision (making it accepted)
+}
+
+unsigned int OnboardFilter::activeFilterSchema(unsigned int activeFilter) const
+{
+    // Moot fills the active filter list with schema ids, job options with TDS keys
+    KeyToSchemaMap::const_iterator keyIter = m_keyToSchemaMap.find(activeFilter);
+
+    return keyIter != m_keyToSchemaMap.end() ? keyIter->second : activeFilter;
+}
+
+StatusCode OnboardFilter::compileDecision()
+{
+    MsgStream log(msgSvc(), name());
+
+    std::string expression = m_acceptExpression.value();
+
+    // Default is the original rule, the event is accepted if any active filter accepts it
+    if (expression == "")
+    {
+        for(ActiveFilterVec::const_iterator filtItr = m_activeFilters.begin(); filtItr != m_activeFilters.end(); filtItr++)
+        {
+            unsigned int schemaId = activeFilterSchema(*filtItr);
+
+            for(unsigned int slot = 0; slot < m_decisionKeys.size(); slot++)
+            {
+                if (m_keyToSchemaMap[m_decisionKeys[slot]] != schemaId) continue;
+
+                if (expression != "") expression += " | ";
+                expression += m_decisionNames[slot];
+            }
+        }
+    }
+
+    std::string error;
+
+    if (!m_decision.compile(expression, m_decisionNames, error))
+    {
+        log << MSG::ERROR << error << ": " << expression << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    log << MSG::INFO << "Accepting events with " << (expression != "" ? expression : "no filter") 
+        << " (" << m_decision.nVariables() << " conditions)" << endreq;
+
+    // A filter the decision depends on has to run on every event, and is never throttled
+    for(unsigned int slot = 0; slot < m_decisionKeys.size(); slot++)
+    {
+        if (!m_decision.usesFilter(slot)) continue;
+
+        if (m_obfInterface->getSampleRate(m_keyToSchemaMap[m_decisionKeys[slot]]) > 1)
+        {
+            log << MSG::ERROR << "The " << m_decisionNames[slot] << " filter decides events, it cannot be sampled" << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        m_obfInterface->setSampleFixed(m_keyToSchemaMap[m_decisionKeys[slot]]);
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+bool OnboardFilter::decideEvent()
+{
+    if (m_decided) return m_accepted;
+
+    // Decided by the GEM pre-veto, the filters did not run
+    if (m_gemVerdict == ObfGemPreVeto::Accept || m_gemVerdict == ObfGemPreVeto::Reject)
+    {
+        m_accepted = m_gemVerdict == ObfGemPreVeto::Accept;
+        m_decided  = true;
+
+        return m_accepted;
+    }
+
+    if (m_timeKernels) m_vetoLoopStats.start();
+
+    unsigned int inputs = 0;
+
+    // Gather the results of the filters the decision can refer to
+    for(unsigned int slot = 0; slot < m_decisionKeys.size(); slot++)
+    {
+        // Retrieve enum
+        OnboardFilterTds::ObfFilterStatus::FilterKeys key = (OnboardFilterTds::ObfFilterStatus::FilterKeys)(m_decisionKeys[slot]);
+
+        // Look up the information for this filter, it may not have run
+        const OnboardFilterTds::IObfStatus* filterStat = m_curStatus->getFilterStatus(key);
+
+        if (filterStat) inputs |= decisionBits(slot, filterStat->getFiltersb());
+    }
+
+    m_accepted = m_decision.accept(inputs);
+    m_decided  = true;
+
+    if (m_timeKernels) m_vetoLoopStats.stop();
+
+    return m_accepted;
+}
+
+bool OnboardFilter::eovDecision(void* prm)
+{
+    return reinterpret_cast<OnboardFilter*>(prm)->decideEvent();
+}
+
+StatusCode OnboardFilter::setupFilterSweep()
+{
+    MsgStream log(msgSvc(), name());
+
+    // Without rejection every filter result is wanted
+    if (!m_rejectEvents)
+    {
+        log << MSG::ERROR << "AdaptiveOrder and GemPreVeto need RejectEvents" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    // Each mode would be decided on a different subset
+    if (m_evaluateAllModes.value())
+    {
+        log << MSG::ERROR << "AdaptiveOrder and GemPreVeto cannot be used with EvaluateAllModes" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    std::vector<unsigned short int> schemaIds;
+
+    m_orderedSlots.clear();
+
+    for(unsigned int slot = 0; slot < m_decisionKeys.size(); slot++)
+    {
+        if (!m_decision.usesFilter(slot)) continue;
+
+        schemaIds.push_back(m_keyToSchemaMap[m_decisionKeys[slot]]);
+        m_orderedSlots.push_back(slot);
+    }
+
+    if (checkPrescalers().isFailure()) return StatusCode::FAILURE;
+
+    std::string error;
+
+    // Without the adaptive order they all run, in a fixed order, unless the pre-veto decides
+    int verifyInterval = m_adaptiveOrder.value() ? m_adaptiveVerify.value() : 0;
+
+    if (!m_obfInterface->setAdaptiveOrder(schemaIds, partialDecision, this, verifyInterval, error))
+    {
+        log << MSG::ERROR << "Cannot take over the filters: " << error << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    const ObfAdaptiveOrder* order = m_obfInterface->adaptiveOrder();
+
+    log << MSG::INFO << "Running";
+    for(unsigned int idx = 0; idx < m_orderedSlots.size(); idx++) 
+        if (order->ordered(idx)) log << " " << m_decisionNames[m_orderedSlots[idx]];
+    if (m_adaptiveOrder.value()) log << " in adaptive order, all of them every " << m_adaptiveVerify.value() << " events";
+    else                         log << " in a fixed order";
+    if (m_gemPreVetoOn.value())  log << ", after the GEM pre-veto";
+    log << endreq;
+
+    if (m_gemPreVetoOn.value())
+    {
+        // Unless asked to lose events, every firing is checked
+        m_gemPreVeto = ObfGemPreVeto(m_gemTraining.value(), m_gemPreVetoLossy.value() ? m_gemCheckInterval.value() : 1);
+
+        if (m_gemPreVeto.lossy())
+        {
+            log << MSG::WARNING << "GemPreVetoLossy: GEM rules decide events unchecked between every " 
+                << m_gemCheckInterval.value() << " firings, some events will be decided wrong" << endreq;
+        }
+
+        m_obfInterface->setPreDecision(gemPreDecision, this);
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+std::string OnboardFilter::prescalingFilter()
+{
+    for(unsigned int slot = 0; slot < m_decisionKeys.size(); slot++)
+    {
+        if (m_decision.usesFilter(slot) && m_obfInterface->prescalesEvents(m_keyToSchemaMap[m_decisionKeys[slot]]))
+            return m_decisionNames[slot];
+    }
+
+    return "";
+}
+
+StatusCode OnboardFilter::checkPrescalers()
+{
+    MsgStream log(msgSvc(), name());
+
+    // A prescaler counts the events its filter sees, skipping the filter on some events shifts which it passes
+    std::string prescaling = prescalingFilter();
+
+    if (m_adaptiveOrder.value() && prescaling != "")
+    {
+        log << MSG::ERROR << "AdaptiveOrder cannot be used, the " << prescaling << " filter prescales events in the current mode" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    // Checked GEM rules still run the filters on every event, only lossy ones skip them
+    if (m_gemPreVetoOn.value() && m_gemPreVetoLossy.value() && m_gemCheckInterval.value() > 1 && prescaling != "")
+    {
+        log << MSG::ERROR << "GemPreVetoLossy cannot be used, the " << prescaling << " filter prescales events in the current mode" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    // A cache hit skips every filter, deciding or not
+    if (m_resultCacheDir.value() == "") return StatusCode::SUCCESS;
+
+    for(IdToNameMap::const_iterator idIter = m_idToToolNameMap.begin(); idIter != m_idToToolNameMap.end(); idIter++)
+    {
+        if (m_obfInterface->prescalesEvents(idIter->first))
+        {
+            log << MSG::ERROR << "ResultCacheDir cannot be used, the " << idIter->second << " prescales events in the current mode" << endreq;
+            return StatusCode::FAILURE;
+        }
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode OnboardFilter::setupResultCache()
+{
+    MsgStream log(msgSvc(), name());
+
+    // A hit gives the same results only if every filter runs in full on every event
+    std::string conflict = "";
+
+    if      (m_evaluateAllModes.value())         conflict = "EvaluateAllModes";
+    else if (m_adaptiveOrder.value())            conflict = "AdaptiveOrder";
+    else if (m_gemPreVetoOn.value())             conflict = "GemPreVeto";
+    else if (m_eventBudgetUs.value() > 0.)       conflict = "EventBudgetUs";
+    else if (m_eventTimeLimitUs.value() > 0.)    conflict = "EventTimeLimitUs";
+
+    for(IdToNameMap::const_iterator idIter = m_idToToolNameMap.begin(); idIter != m_idToToolNameMap.end(); idIter++)
+    {
+        if (conflict == "" && m_obfInterface->getSampleRate(idIter->first) > 1) conflict = "a sampled " + idIter->second;
+    }
+
+    // Nor can it restore what the output tools put in the TDS
+    for(std::vector<std::string>::const_iterator filterIter = m_filterList.value().begin(); filterIter != m_filterList.value().end(); filterIter++)
+    {
+        if (conflict == "" && (*filterIter == "TkrOutput" || *filterIter == "CalOutput" || *filterIter == "GemOutput")) conflict = *filterIter;
+    }
+
+    if (conflict != "")
+    {
+        log << MSG::ERROR << "ResultCacheDir cannot be used with " << conflict << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    // Nor with prescalers, a hit would leave them uncounted
+    if (checkPrescalers().isFailure()) return StatusCode::FAILURE;
+
+    // Everything deciding the results: release, Moot key, job options and the contents of the
+    // libraries loaded, so a library rebuilt under the same name starts a fresh cache
+    std::ostringstream fingerprint;
+
+    fingerprint << warmStartKey();
+
+    const std::vector<std::string>& libraries = m_obfInterface->openedLibraries();
+    for(std::vector<std::string>::const_iterator libIter = libraries.begin(); libIter != libraries.end(); libIter++)
+    {
+        std::string libraryPrint = ObfResultCache::fileFingerprint(*libIter);
+
+        if (libraryPrint == "")
+        {
+            log << MSG::ERROR << "Cannot use the result cache: unable to read loaded library " << *libIter << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        fingerprint << "\n" << libraryPrint;
+    }
+
+    if (libraries.empty())
+    {
+        log << MSG::ERROR << "Cannot use the result cache: no FSW libraries were recorded as loaded" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    std::string directory = m_resultCacheDir.value();
+    facilities::Util::expandEnvVar(&directory);
+
+    std::string error;
+
+    if (!m_resultCache.open(directory, fingerprint.str(), error))
+    {
+        log << MSG::ERROR << "Cannot use the result cache: " << error << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    log << MSG::INFO << "Result cache " << m_resultCache.fileName() << " holds " << m_resultCache.entries() << " events" << endreq;
+
+    return StatusCode::SUCCESS;
+}
+
+void OnboardFilter::cacheRecord(ObfGoldenRecord& record)
+{
+    record.clear();
+
+    // The filters by golden record slot, which follows the decision slots
+    for(unsigned int slot = 0; slot < m_decisionKeys.size() && slot < ObfGoldenRecord::NumFilters; slot++)
+    {
+        OnboardFilterTds::ObfFilterStatus::FilterKeys key = (OnboardFilterTds::ObfFilterStatus::FilterKeys)(m_decisionKeys[slot]);
+
+        const OnboardFilterTds::IObfStatus* filterStat = m_curStatus->getFilterStatus(key);
+
+        if (!filterStat) continue;
+
+        record.present     |= 1 << slot;
+        record.status[slot] = filterStat->getStatusWord();
+        record.id[slot]     = static_cast<unsigned char>(filterStat->getFilterId());
+        record.sb[slot]     = static_cast<unsigned char>(filterStat->getFiltersb());
+
+        if (filterAccepts(record.sb[slot])) record.passed |= 1 << slot;
+
+        if (const OnboardFilterTds::ObfGammaStatus* gammaStat = dynamic_cast<const OnboardFilterTds::ObfGammaStatus*>(filterStat))
+            record.gammaEnergy = static_cast<unsigned int>(gammaStat->getEnergy());
+    }
+
+    SmartDataPtr<OnboardFilterTds::ObfFilterTrack> filterTrack(eventSvc(), "/Event/Filter/ObfFilterTrack");
+
+    if (filterTrack)
+    {
+        record.present |= ObfGoldenRecord::TrackPresent;
+        record.nXhits   = filterTrack->get_nXhits();
+        record.nYhits   = filterTrack->get_nYhits();
+        record.xInt     = filterTrack->get_xInt();
+        record.yInt     = filterTrack->get_yInt();
+        record.zInt     = filterTrack->get_zInt();
+        record.slpXZ    = filterTrack->get_slpXZ();
+        record.slpYZ    = filterTrack->get_slpYZ();
+    }
+
+    return;
+}
+
+void OnboardFilter::restoreRecord(const ObfGoldenRecord& record)
+{
+    MsgStream log(msgSvc(), name());
+
+    // As the filter tools make them
+    if (record.present & (1 << ObfGoldenRecord::Gamma))
+        m_curStatus->addFilterStatus(OnboardFilterTds::ObfFilterStatus::GammaFilter, 
+            new OnboardFilterTds::ObfGammaStatus(record.id[ObfGoldenRecord::Gamma], record.status[ObfGoldenRecord::Gamma], 
+                                                 record.sb[ObfGoldenRecord::Gamma], 0, record.gammaEnergy));
+    if (record.present & (1 << ObfGoldenRecord::HIP))
+        m_curStatus->addFilterStatus(OnboardFilterTds::ObfFilterStatus::HIPFilter, 
+            new OnboardFilterTds::ObfHipStatus(record.id[ObfGoldenRecord::HIP], record.status[ObfGoldenRecord::HIP], record.sb[ObfGoldenRecord::HIP], 0));
+    if (record.present & (1 << ObfGoldenRecord::MIP))
+        m_curStatus->addFilterStatus(OnboardFilterTds::ObfFilterStatus::MIPFilter, 
+            new OnboardFilterTds::ObfMipStatus(record.id[ObfGoldenRecord::MIP], record.status[ObfGoldenRecord::MIP], record.sb[ObfGoldenRecord::MIP], 0));
+    if (record.present & (1 << ObfGoldenRecord::DGN))
+        m_curStatus->addFilterStatus(OnboardFilterTds::ObfFilterStatus::DGNFilter, 
+            new OnboardFilterTds::ObfDgnStatus(record.id[ObfGoldenRecord::DGN], record.status[ObfGoldenRecord::DGN], record.sb[ObfGoldenRecord::DGN], 0));
+
+    if (record.present & ObfGoldenRecord::TrackPresent)
+    {
+        OnboardFilterTds::ObfFilterTrack* filterTrack = new OnboardFilterTds::ObfFilterTrack();
+
+        // FilterTrack leaves it empty if it found no track
+        if (record.nXhits || record.nYhits)
+            filterTrack->initialize(record.nXhits, record.nYhits, record.xInt, record.yInt, record.zInt, record.slpXZ, record.slpYZ);
+
+        if (eventSvc()->registerObject("/Event/Filter/ObfFilterTrack", filterTrack).isFailure())
+        {
+            log << MSG::ERROR << "Could not register ObfFilterTrack from the result cache" << endreq;
+        }
+    }
+
+    return;
+}
+
+bool OnboardFilter::gemPreDecision(void* prm, EDS_fwIxb* ixb)
+{
+    OnboardFilter* filter = reinterpret_cast<OnboardFilter*>(prm);
+
+    const EBF_dir* dir = ixb->blk.evt.dir;
+
+    if (!dir->ctbs[EBF_CID_K_GEM].ctb) return false;
+
+    // The same GEM summary GemOutputTool records
+    const EBF_gem* gem = (const EBF_gem *)dir->ctbs[EBF_CID_K_GEM].ctb->dat;
+
+    bool acdVeto = gem->acd.vetoes[EBF_GEM_ACD_VETO_K_XZ] || gem->acd.vetoes[EBF_GEM_ACD_VETO_K_YZ]
+                || gem->acd.vetoes[EBF_GEM_ACD_VETO_K_XY] || gem->acd.vetoes[EBF_GEM_ACD_VETO_K_RU];
+
+    filter->m_gemKey      = ObfGemPreVeto::key(gem->condsumCno, gem->thrTkr, gem->calHiLo, acdVeto);
+    filter->m_gemKeyValid = true;
+    filter->m_gemVerdict  = filter->m_gemPreVeto.decide(filter->m_gemKey);
+
+    return filter->m_gemVerdict == ObfGemPreVeto::Accept || filter->m_gemVerdict == ObfGemPreVeto::Reject;
+}
+
+bool OnboardFilter::partialDecision(void* prm, unsigned int ranFilters, const unsigned char* sbs, bool& decision)
+{
+    OnboardFilter* filter = reinterpret_cast<OnboardFilter*>(prm);
+
+    unsigned int slotMask = 0;
+    unsigned int inputs   = 0;
+
+    for(unsigned int idx = 0; idx < filter->m_orderedSlots.size(); idx++)
+    {
+        if (!(ranFilters & (1 << idx))) continue;
+
+        unsigned int slot = filter->m_orderedSlots[idx];
+
+        slotMask |= 1 << slot;
+        inputs   |= decisionBits(slot, sbs[idx]);
+    }
+
+    return filter->m_decision.decidedBy(slotMask, inputs, decision);
+}
+
+unsigned int OnboardFilter::decisionBits(int slot, unsigned char sb)
+{
+    return ObfDecisionEngine::filterBits(slot, true, filterAccepts(sb), 
+                                         (sb & EDS_RSD_SB_M_VETOED) != 0, (sb & EDS_RSD_SB_M_PRESCALE_OUT) != 0);
+}
+
+std::string OnboardFilter::warmStartKey()
+{
+#if defined(OBF_B1_1_3)
+    std::string release = "B1-1-3";
+#elif defined(OBF_B3_0_0)
+    std::string release = "B3-0-0";
+#elif defined(OBF_B3_1_0)
+    std::string release = "B3-1-0";
+#elif defined(OBF_B3_1_1)
+    std::string release = "B3-1-1";
+#elif defined(OBF_B3_1_3)
+    std::string release = "B3-1-3";
+#else
+    std::string release = "unknown";
+#endif
+
+    unsigned int mootKey = m_mootConfig.value() ? m_mootSvc->getMootConfigKey() : 0;
+
+    // Job options of ourselves and of the tools which set up the filters
+    std::vector<std::string> clients;
+    clients.push_back(name());
+    clients.push_back("ToolSvc.FSWAuxLibsTool");
+
+    for(std::vector<std::string>::const_iterator filterIter = m_filterList.value().begin(); filterIter != m_filterList.value().end(); filterIter++)
+    {
+        clients.push_back("ToolSvc." + *filterIter + "Tool");
+        clients.push_back(name() + "." + *filterIter + "Tool");
+    }
+
+    unsigned long long joHash  = ObfWarmStart::hash(release);
+    IJobOptionsSvc*    jobSvc  = 0;
+
+    if (service("JobOptionsSvc", jobSvc, true).isSuccess())
+    {
+        for(std::vector<std::string>::const_iterator clientIter = clients.begin(); clientIter != clients.end(); clientIter++)
+        {
+            const std::vector<const Property*>* properties = jobSvc->getProperties(*clientIter);
+
+            if (!properties) continue;
+
+            for(std::vector<const Property*>::const_iterator propIter = properties->begin(); propIter != properties->end(); propIter++)
+            {
+                joHash = ObfWarmStart::hash(*clientIter + "." + (*propIter)->name() + "=" + (*propIter)->toString(), joHash);
+            }
+        }
+    }
+
+    return ObfWarmStart::makeKey(release, mootKey, joHash);
+}
+
+void OnboardFilter::evaluateAllModes()
+{
+    bool accepted[EFC_DB_MODE_K_CNT];
+
+    for(int mode = 0; mode < EFC_DB_MODE_K_CNT; mode++)
+    {
+        unsigned int inputs = 0;
+
+        // Same decision as the veto loop
+        for(unsigned int slot = 0; slot < m_decisionKeys.size(); slot++)
+        {
+            unsigned char sb = 0;
+
+            if (m_obfInterface->getModeResult(m_keyToSchemaMap[m_decisionKeys[slot]], mode, sb)) inputs |= decisionBits(slot, sb);
+        }
+
+        accepted[mode] = m_decision.accept(inputs);
+
+        if (accepted[mode]) m_modeAccepted[mode]++;
+    }
+
+    if (m_modeMatrix.is_open())
+    {
+        SmartDataPtr<Event::EventHeader> header(eventSvc(), EventModel::EventHeader);
+
+        m_modeMatrix << (header ? header->run() : 0) << " " << (header ? header->event() : 0);
+        for(int mode = 0; mode < EFC_DB_MODE_K_CNT; mode++) m_modeMatrix << " " << (accepted[mode] ? 1 : 0);
+        m_modeMatrix << "\n";
+    }
+
+    return;
+}
+
+/* --------------------------------------------------------------------- */
+
 StatusCode OnboardFilter::finalize()
 {
     m_obfInterface->dumpCounters();
 
+    if (m_modeMatrix.is_open()) m_modeMatrix.close();
+
     MsgStream log(msgSvc(), name());
     log << MSG::INFO << "Encountered " << m_noEbfData << " events with no ebf data"
         << endreq;
-    if (m_rejectEvents) log << MSG::INFO << "Rejected " << m_rejected << endreq;
+    if (m_eventTimeLimitUs.value() > 0.) log << MSG::INFO << m_timeouts << " events exceeded the time limit" << endreq;
+    if (m_rejectEvents) log << MSG::INFO << "Rejected " << m_rejected << ", output tools skipped for " 
+                            << m_obfInterface->getOutputSkipped() << endreq;
+
+    // Sampled filters and tools, with the weights to scale their statistics by
+    std::vector<ObfSampler> samplers;
+    m_obfInterface->getSampling(samplers);
+
+    for(std::vector<ObfSampler>::const_iterator samplerIter = samplers.begin(); samplerIter != samplers.end(); samplerIter++)
+    {
+        if (samplerIter->nSelected() == samplerIter->seen()) continue;
+
+        log << MSG::INFO << samplerIter->name() << " sampled 1 in " << samplerIter->rate() << " (before throttling): ran on " 
+            << samplerIter->nSelected() << " of " << samplerIter->seen() << " events, weight " << samplerIter->weight() << endreq;
+    }
+
+    if (m_budget.enabled())
+    {
+        log << MSG::INFO << "Time budget " << m_budget.budget() << " ns per event, average now " << m_budget.average() 
+            << ", " << m_budget.changes().size() << " throttle changes, events at each factor:";
+        const std::map<int, unsigned long long>& byThrottle = m_budget.eventsByThrottle();
+        for(std::map<int, unsigned long long>::const_iterator throttleIter = byThrottle.begin(); throttleIter != byThrottle.end(); throttleIter++)
+            log << " " << throttleIter->first << ": " << throttleIter->second;
+        log << endreq;
+    }
+
+    if (m_budgetLog.is_open()) m_budgetLog.close();
+
+    const ObfAdaptiveOrder* order = m_obfInterface->adaptiveOrder();
+
+    if (order && m_adaptiveOrder.value())
+    {
+        log << MSG::INFO << "Adaptive order over " << order->events() << " events, " << order->fullEvents() << " run in full, "
+            << order->mismatches() << " early stops disagreed";
+        if (!order->enabled()) log << ", switched off: " << order->reason();
+        for(std::vector<int>::const_iterator orderIter = order->order().begin(); orderIter != order->order().end(); orderIter++)
+        {
+            log << "\n    " << m_decisionNames[m_orderedSlots[*orderIter]] << ": ran " << order->runs(*orderIter) 
+                << ", skipped " << order->skipped(*orderIter) << ", " << order->costNs(*orderIter) << " ns per run, decides alone " 
+                << 100. * order->decisive(*orderIter) << "%";
+        }
+        log << endreq;
+    }
+
+    if (m_resultCache.isOpen())
+    {
+        log << MSG::INFO << "Result cache: " << m_resultCache.hits() << " hits, " << m_resultCache.misses() << " misses, " 
+            << m_resultCache.stored() << " events added, " << m_resultCache.entries() << " in " << m_resultCache.fileName() << endreq;
+        m_resultCache.close();
+    }
+
+    if (m_gemPreVetoOn.value())
+    {
+        unsigned long long fired = m_gemPreVeto.accepted() + m_gemPreVeto.rejected();
+
+        log << MSG::INFO << (m_gemPreVeto.lossy() ? "Lossy GEM pre-veto" : "Checked GEM pre-veto") << " decided " << fired 
+            << " of " << m_gemPreVeto.events() << " events unchecked (" 
+            << (m_gemPreVeto.events() ? 100. * fired / m_gemPreVeto.events() : 0.) << "%), accepted " << m_gemPreVeto.accepted() 
+            << ", rejected " << m_gemPreVeto.rejected() << "; " << m_gemPreVeto.signatures() << " GEM signatures, " 
+            << m_gemPreVeto.active() << " rules in use, " << m_gemPreVeto.retired() << " retired; checked " 
+            << m_gemPreVeto.checked() << " times against the filters, " << m_gemPreVeto.disagreed() << " disagreed";
+        if (!m_gemPreVeto.enabled()) log << "; switched off: " << m_gemPreVeto.reason();
+        log << endreq;
+    }
+
+    if (m_mootConfig.value())
+    {
+        ObfMootConfigCache* mootCache = ObfMootConfigCache::instance();
+        log << MSG::INFO << "Moot filter configuration: " << mootCache->mootQueries() << " queries, " 
+            << mootCache->cacheHits() << " answered from the cache" << endreq;
+    }
+
+    if (m_evaluateAllModes.value())
+    {
+        log << MSG::INFO << "Events accepted in each mode:";
+        for(int mode = 0; mode < EFC_DB_MODE_K_CNT; mode++) log << " " << mode << ": " << m_modeAccepted[mode];
+        log << endreq;
+    }
+
+    if (m_timeKernels)
+    {
+        log << MSG::INFO << "Kernel timing over " << m_events << " events" << endreq;
+        log << MSG::INFO << m_filterEventStats.summary(m_events) << endreq;
+        if (m_rejectEvents) log << MSG::INFO << m_vetoLoopStats.summary(m_events) << endreq;
+    }
 
     return StatusCode::SUCCESS;
 }
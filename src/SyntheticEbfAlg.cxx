@@ -0,0 +1,382 @@
+/**  @file SyntheticEbfAlg.cxx
+    @brief implementation of class SyntheticEbfAlg
+    
+  $Header$  
+*/
+
+#include "GaudiKernel/Algorithm.h"
+#include "GaudiKernel/MsgStream.h"
+#include "GaudiKernel/AlgFactory.h"
+#include "GaudiKernel/IDataProviderSvc.h"
+#include "GaudiKernel/SmartDataPtr.h"
+#include "GaudiKernel/Property.h"
+
+#include "Event/TopLevel/EventModel.h"
+#include "Event/TopLevel/Event.h"
+#include "Event/TopLevel/DigiEvent.h"
+#include "Event/Digi/TkrDigi.h"
+#include "Event/Digi/CalDigi.h"
+#include "Event/Digi/AcdDigi.h"
+#include "EbfWriter/Ebf.h"
+
+#include "idents/TowerId.h"
+#include "idents/CalXtalId.h"
+#include "idents/AcdId.h"
+#include "idents/GlastAxis.h"
+
+#include "facilities/Util.h"
+
+#include "SyntheticEbfGenerator.h"
+
+#include <map>
+#include <set>
+#include <fstream>
+
+/** @class SyntheticEbfAlg
+    @brief Feeds seeded synthetic events into the standard digi -> Trigger -> EbfWriter chain
+           so the OnboardFilter can be load tested without real data. 
+
+           With Stage = "Generate" (the default) the algorithm replaces the simulation: it
+           generates an event with SyntheticEbfGenerator and registers the Tkr, Cal and Acd
+           digi collections. TriggerInfoAlg, TriggerAlg and EbfWriter then build the GEM, TEM 
+           and ACD contributors and the EBF packet as usual.
+
+           With Stage = "Write" it appends the EBF of each event to OutputFile, giving a
+           raw EBF stream which can be replayed later or on another release.
+*/
+class SyntheticEbfAlg : public Algorithm
+{
+public:
+    SyntheticEbfAlg(const std::string& name, ISvcLocator *pSvcLocator);
+    ~SyntheticEbfAlg() {}
+
+    StatusCode initialize();
+    StatusCode execute();
+    StatusCode finalize();
+
+private:
+    StatusCode generateEvent(MsgStream& log);
+    StatusCode writeEvent(MsgStream& log);
+
+    //****** This section for defining JO parameters
+    StringProperty  m_stage;
+    StringProperty  m_outputFile;
+
+    // Generator distributions
+    IntegerProperty m_seed;
+    DoubleProperty  m_emptyFraction;
+    DoubleProperty  m_heavyIonFraction;
+    DoubleProperty  m_showerFraction;
+    DoubleProperty  m_towerOccupancy;
+    DoubleProperty  m_tracksPerEvent;
+    DoubleProperty  m_hitsPerLayer;
+    DoubleProperty  m_hitEfficiency;
+    DoubleProperty  m_calLogsPerTrack;
+    DoubleProperty  m_acdTilesPerEvent;
+    DoubleProperty  m_showerTracks;
+    DoubleProperty  m_showerCalLogs;
+
+    //****** This section contains various useful member variables
+    SyntheticEbfGenerator*        m_generator;
+    SyntheticEbfGenerator::Event  m_event;
+    std::ofstream*                m_outFile;
+
+    // Counters
+    int                m_events;
+    int                m_typeCount[4];
+    unsigned long long m_tkrHits;
+    unsigned long long m_calLogs;
+    unsigned long long m_bytesWritten;
+};
+
+DECLARE_ALGORITHM_FACTORY(SyntheticEbfAlg);
+
+SyntheticEbfAlg::SyntheticEbfAlg(const std::string& name, ISvcLocator *pSvcLocator) : 
+                 Algorithm(name, pSvcLocator), m_generator(0), m_outFile(0), m_events(0), 
+                 m_tkrHits(0), m_calLogs(0), m_bytesWritten(0)
+{
+    SyntheticEbfGenerator::Config defaults;
+
+    declareProperty("Stage",            m_stage            = "Generate");
+    declareProperty("OutputFile",       m_outputFile       = "");
+    declareProperty("Seed",             m_seed             = static_cast<int>(defaults.seed));
+    declareProperty("EmptyFraction",    m_emptyFraction    = defaults.emptyFraction);
+    declareProperty("HeavyIonFraction", m_heavyIonFraction = defaults.heavyIonFraction);
+    declareProperty("ShowerFraction",   m_showerFraction   = defaults.showerFraction);
+    declareProperty("TowerOccupancy",   m_towerOccupancy   = defaults.towerOccupancy);
+    declareProperty("TracksPerEvent",   m_tracksPerEvent   = defaults.tracksPerEvent);
+    declareProperty("HitsPerLayer",     m_hitsPerLayer     = defaults.hitsPerLayer);
+    declareProperty("HitEfficiency",    m_hitEfficiency    = defaults.hitEfficiency);
+    declareProperty("CalLogsPerTrack",  m_calLogsPerTrack  = defaults.calLogsPerTrack);
+    declareProperty("AcdTilesPerEvent", m_acdTilesPerEvent = defaults.acdTilesPerEvent);
+    declareProperty("ShowerTracks",     m_showerTracks     = defaults.showerTracks);
+    declareProperty("ShowerCalLogs",    m_showerCalLogs    = defaults.showerCalLogs);
+
+    for(int idx = 0; idx < 4; idx++) m_typeCount[idx] = 0;
+}
+
+StatusCode SyntheticEbfAlg::initialize()
+{
+    MsgStream log(msgSvc(), name());
+
+    setProperties();
+
+    if (m_stage.value() == "Generate")
+    {
+        SyntheticEbfGenerator::Config config;
+
+        config.seed             = static_cast<unsigned int>(m_seed.value());
+        config.emptyFraction    = m_emptyFraction;
+        config.heavyIonFraction = m_heavyIonFraction;
+        config.showerFraction   = m_showerFraction;
+        config.towerOccupancy   = m_towerOccupancy;
+        config.tracksPerEvent   = m_tracksPerEvent;
+        config.hitsPerLayer     = m_hitsPerLayer;
+        config.hitEfficiency    = m_hitEfficiency;
+        config.calLogsPerTrack  = m_calLogsPerTrack;
+        config.acdTilesPerEvent = m_acdTilesPerEvent;
+        config.showerTracks     = m_showerTracks;
+        config.showerCalLogs    = m_showerCalLogs;
+
+        m_generator = new SyntheticEbfGenerator(config);
+
+        log << MSG::INFO << "Generating synthetic events with seed " << m_seed.value() << endreq;
+    }
+    else if (m_stage.value() == "Write")
+    {
+        std::string fileName = m_outputFile.value();
+        facilities::Util::expandEnvVar(&fileName);
+
+        if (fileName.empty())
+        {
+            log << MSG::ERROR << "Stage Write requires an OutputFile" << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        m_outFile = new std::ofstream(fileName.c_str(), std::ios::out | std::ios::binary);
+
+        if (!m_outFile->good())
+        {
+            log << MSG::ERROR << "Cannot open " << fileName << " for output" << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        log << MSG::INFO << "Writing ebf stream to " << fileName << endreq;
+    }
+    else
+    {
+        log << MSG::ERROR << "Stage must be Generate or Write, found " << m_stage.value() << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode SyntheticEbfAlg::execute()
+{
+    MsgStream log(msgSvc(), name());
+
+    if (m_generator) return generateEvent(log);
+
+    return writeEvent(log);
+}
+
+StatusCode SyntheticEbfAlg::generateEvent(MsgStream& log)
+{
+    m_generator->generate(m_event);
+
+    m_events++;
+    m_typeCount[m_event.type]++;
+
+    // Label the event header if there is one
+    SmartDataPtr<Event::EventHeader> header(eventSvc(), EventModel::EventHeader);
+    if (header) header->setEvent(m_events);
+
+    // Digi top level
+    SmartDataPtr<Event::DigiEvent> digiEvent(eventSvc(), EventModel::Digi::Event);
+    if (!digiEvent)
+    {
+        if (eventSvc()->registerObject(EventModel::Digi::Event, new Event::DigiEvent).isFailure())
+        {
+            log << MSG::ERROR << "Could not register " << EventModel::Digi::Event << endreq;
+            return StatusCode::FAILURE;
+        }
+    }
+
+    // Tracker: collect the strips by (tower, layer, view), removing duplicates from overlapping clusters
+    typedef std::map<int, std::set<int> > PlaneStripMap;
+    PlaneStripMap planeStrips;
+
+    for(std::vector<SyntheticEbfGenerator::TkrHit>::const_iterator hitIter = m_event.tkrHits.begin();
+        hitIter != m_event.tkrHits.end(); hitIter++)
+    {
+        int planeKey = (hitIter->tower * SyntheticEbfGenerator::NumTkrLayers + hitIter->layer) * 2 + hitIter->view;
+        planeStrips[planeKey].insert(hitIter->strip);
+    }
+
+    Event::TkrDigiCol* tkrDigis = new Event::TkrDigiCol;
+
+    for(PlaneStripMap::const_iterator planeIter = planeStrips.begin(); planeIter != planeStrips.end(); planeIter++)
+    {
+        int view  = planeIter->first % 2;
+        int layer = (planeIter->first / 2) % SyntheticEbfGenerator::NumTkrLayers;
+        int tower = (planeIter->first / 2) / SyntheticEbfGenerator::NumTkrLayers;
+        // Time over threshold grows with the number of strips, one per controller with hits
+        int nStrips = static_cast<int>(planeIter->second.size());
+        int totVal  = 5 + 2 * nStrips < 250 ? 5 + 2 * nStrips : 250;
+        int halfway = SyntheticEbfGenerator::NumStrips / 2;
+        int tot[]   = {0, 0};
+
+        if (*planeIter->second.begin()  <  halfway) tot[0] = totVal;
+        if (*planeIter->second.rbegin() >= halfway) tot[1] = totVal;
+
+        idents::GlastAxis::axis axis = view == 0 ? idents::GlastAxis::X : idents::GlastAxis::Y;
+
+        Event::TkrDigi* digi = new Event::TkrDigi(layer, axis, idents::TowerId(tower), tot);
+
+        // Strips in the lower half are read out by controller 0, the upper half by controller 1
+        for(std::set<int>::const_iterator stripIter = planeIter->second.begin(); 
+            stripIter != planeIter->second.end(); stripIter++)
+        {
+            if (*stripIter < halfway) digi->addC0Hit(*stripIter);
+            else                      digi->addC1Hit(*stripIter);
+        }
+
+        tkrDigis->push_back(digi);
+    }
+
+    m_tkrHits += m_event.tkrHits.size();
+
+    if (eventSvc()->registerObject(EventModel::Digi::TkrDigiCol, tkrDigis).isFailure())
+    {
+        log << MSG::ERROR << "Could not register " << EventModel::Digi::TkrDigiCol << endreq;
+        delete tkrDigis;
+        return StatusCode::FAILURE;
+    }
+
+    // Calorimeter, one digi per log, last readout wins if generated twice
+    typedef std::map<int, const SyntheticEbfGenerator::CalHit*> LogMap;
+    LogMap logs;
+
+    for(std::vector<SyntheticEbfGenerator::CalHit>::const_iterator hitIter = m_event.calHits.begin();
+        hitIter != m_event.calHits.end(); hitIter++)
+    {
+        int logKey = (hitIter->tower * SyntheticEbfGenerator::NumCalLayers + hitIter->layer) 
+                   * SyntheticEbfGenerator::NumCalColumns + hitIter->column;
+        logs[logKey] = &(*hitIter);
+    }
+
+    Event::CalDigiCol* calDigis = new Event::CalDigiCol;
+
+    for(LogMap::const_iterator logIter = logs.begin(); logIter != logs.end(); logIter++)
+    {
+        const SyntheticEbfGenerator::CalHit* hit = logIter->second;
+
+        idents::CalXtalId xtalId(hit->tower, hit->layer, hit->column);
+        Event::CalDigi*   digi = new Event::CalDigi(idents::CalXtalId::BESTRANGE, xtalId);
+
+        Event::CalDigi::CalXtalReadout readout(hit->rangeP, hit->adcP, hit->rangeM, hit->adcM);
+        digi->addReadout(readout);
+
+        calDigis->push_back(digi);
+    }
+
+    m_calLogs += logs.size();
+
+    if (eventSvc()->registerObject(EventModel::Digi::CalDigiCol, calDigis).isFailure())
+    {
+        log << MSG::ERROR << "Could not register " << EventModel::Digi::CalDigiCol << endreq;
+        delete calDigis;
+        return StatusCode::FAILURE;
+    }
+
+    // ACD
+    Event::AcdDigiCol* acdDigis = new Event::AcdDigiCol;
+    std::set<int>      tilesHit;
+
+    for(std::vector<SyntheticEbfGenerator::AcdHit>::const_iterator hitIter = m_event.acdHits.begin();
+        hitIter != m_event.acdHits.end(); hitIter++)
+    {
+        int tileKey = (hitIter->face * 5 + hitIter->row) * 5 + hitIter->column;
+        if (!tilesHit.insert(tileKey).second) continue;
+
+        idents::AcdId  acdId(0, hitIter->face, hitIter->row, hitIter->column);
+        unsigned short pha[]      = {static_cast<unsigned short>(hitIter->pha), static_cast<unsigned short>(hitIter->pha)};
+        bool           veto[]     = {true, true};
+        bool           lowDisc[]  = {true, true};
+        bool           highDisc[] = {hitIter->pha > 4000, hitIter->pha > 4000};
+        double         energy     = 0.002 * hitIter->pha;   // MeV, roughly a MIP at 1 MeV
+
+        acdDigis->push_back(new Event::AcdDigi(acdId, energy, pha, veto, lowDisc, highDisc));
+    }
+
+    if (eventSvc()->registerObject(EventModel::Digi::AcdDigiCol, acdDigis).isFailure())
+    {
+        log << MSG::ERROR << "Could not register " << EventModel::Digi::AcdDigiCol << endreq;
+        delete acdDigis;
+        return StatusCode::FAILURE;
+    }
+
+    log << MSG::DEBUG << "Event " << m_events << " type " << SyntheticEbfGenerator::typeName(m_event.type)
+        << " tracks " << m_event.nTracks << " tkr digis " << tkrDigis->size() << " cal logs " << calDigis->size() 
+        << " acd tiles " << acdDigis->size() << endreq;
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode SyntheticEbfAlg::writeEvent(MsgStream& log)
+{
+    SmartDataPtr<EbfWriterTds::Ebf> ebfData(eventSvc(), "/Event/Filter/Ebf");
+
+    // Events which did not trigger have no ebf, nothing to write
+    if (!ebfData) return StatusCode::SUCCESS;
+
+    unsigned int length = 0;
+    char*        data   = ebfData->get(length);
+
+    if (length > 0)
+    {
+        m_outFile->write(data, length);
+        m_bytesWritten += length;
+        m_events++;
+    }
+
+    if (!m_outFile->good())
+    {
+        log << MSG::ERROR << "Error writing ebf output" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusCode SyntheticEbfAlg::finalize()
+{
+    MsgStream log(msgSvc(), name());
+
+    if (m_generator)
+    {
+        log << MSG::INFO << "Generated " << m_events << " events: ";
+        for(int type = 0; type < 4; type++)
+        {
+            log << SyntheticEbfGenerator::typeName(static_cast<SyntheticEbfGenerator::EventType>(type)) 
+                << " " << m_typeCount[type] << " ";
+        }
+        log << endreq;
+        log << MSG::INFO << "Tracker strips generated: " << m_tkrHits << ", cal logs: " << m_calLogs << endreq;
+
+        delete m_generator;
+        m_generator = 0;
+    }
+
+    if (m_outFile)
+    {
+        log << MSG::INFO << "Wrote " << m_events << " events, " << m_bytesWritten << " bytes of ebf" << endreq;
+
+        m_outFile->close();
+        delete m_outFile;
+        m_outFile = 0;
+    }
+
+    return StatusCode::SUCCESS;
+}
@@ -0,0 +1,259 @@
+/**  @file SyntheticEbfGenerator.cxx
+    @brief implementation of class SyntheticEbfGenerator
+    
+  $Header$  
+*/
+
+#include "SyntheticEbfGenerator.h"
+
+#include <cmath>
+
+SyntheticEbfGenerator::SyntheticEbfGenerator(const Config& config) : m_config(config)
+{
+    reset();
+}
+
+void SyntheticEbfGenerator::reset()
+{
+    // xorshift must not start from zero
+    m_state = m_config.seed ? m_config.seed : 0x9E3779B97F4A7C15ULL;
+
+    return;
+}
+
+const char* SyntheticEbfGenerator::typeName(EventType type)
+{
+    switch(type)
+    {
+        case Empty:    return "Empty";
+        case Normal:   return "Normal";
+        case HeavyIon: return "HeavyIon";
+        case Shower:   return "Shower";
+    }
+
+    return "Unknown";
+}
+
+unsigned long long SyntheticEbfGenerator::next()
+{
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+
+    return m_state * 2685821657736338717ULL;
+}
+
+double SyntheticEbfGenerator::uniform()
+{
+    // 53 random bits into [0,1)
+    return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int SyntheticEbfGenerator::poisson(double mean)
+{
+    if (mean <= 0.) return 0;
+
+    // Knuth for small means, gaussian approximation for large ones
+    if (mean < 30.)
+    {
+        double limit = std::exp(-mean);
+        double prod  = uniform();
+        int    n     = 0;
+
+        while(prod > limit)
+        {
+            prod *= uniform();
+            n++;
+        }
+
+        return n;
+    }
+
+    double u1 = uniform();
+    double u2 = uniform();
+    double g  = std::sqrt(-2. * std::log(u1 > 0. ? u1 : 1.e-300)) * std::cos(6.283185307179586 * u2);
+    int    n  = static_cast<int>(mean + std::sqrt(mean) * g + 0.5);
+
+    return n > 0 ? n : 0;
+}
+
+void SyntheticEbfGenerator::generate(Event& event)
+{
+    event.clear();
+
+    // Decide what kind of event this is
+    double selector = uniform();
+
+    if      (selector < m_config.emptyFraction)                                                        event.type = Empty;
+    else if (selector < m_config.emptyFraction + m_config.heavyIonFraction)                            event.type = HeavyIon;
+    else if (selector < m_config.emptyFraction + m_config.heavyIonFraction + m_config.showerFraction)  event.type = Shower;
+    else                                                                                               event.type = Normal;
+
+    switch(event.type)
+    {
+        case Empty:
+        {
+            // Nothing in the tracker or cal, perhaps an ACD hit
+            addAcdHits(event, poisson(m_config.acdTilesPerEvent), false);
+            break;
+        }
+        case HeavyIon:
+        {
+            // One steep track through every layer, big clusters, saturated cal and acd
+            int tower = uniformInt(NumTowers);
+
+            addTrack(event, tower, NumTkrLayers - 1, 4. * m_config.hitsPerLayer, true);
+            addCalLogs(event, tower, NumCalLayers, true);
+            addAcdHits(event, 1 + poisson(m_config.acdTilesPerEvent), true);
+            event.nTracks = 1;
+            break;
+        }
+        case Shower:
+        {
+            // Lots of towers, tracks and logs
+            int nTracks = 1 + poisson(m_config.showerTracks);
+            int tower   = uniformInt(NumTowers);
+
+            for(int trk = 0; trk < nTracks; trk++)
+            {
+                // Spread the shower around the central tower
+                int twrX = (tower % 4) + uniformInt(3) - 1;
+                int twrY = (tower / 4) + uniformInt(3) - 1;
+
+                if (twrX < 0) twrX = 0;
+                if (twrX > 3) twrX = 3;
+                if (twrY < 0) twrY = 0;
+                if (twrY > 3) twrY = 3;
+
+                addTrack(event, 4 * twrY + twrX, uniformInt(6), m_config.hitsPerLayer, false);
+            }
+
+            int nLogs = poisson(m_config.showerCalLogs);
+            for(int twr = 0; twr < NumTowers && nLogs > 0; twr++)
+            {
+                int twrLogs = twr == tower ? nLogs / 2 : nLogs / 8;
+                addCalLogs(event, twr, twrLogs, false);
+                nLogs -= twrLogs;
+            }
+
+            addAcdHits(event, poisson(4. * m_config.acdTilesPerEvent), false);
+            event.nTracks = nTracks;
+            break;
+        }
+        case Normal:
+        {
+            int nTracks = poisson(m_config.tracksPerEvent);
+
+            if (nTracks < 1) nTracks = 1;
+
+            for(int trk = 0; trk < nTracks; trk++)
+            {
+                int tower    = uniformInt(NumTowers);
+                int topLayer = 3 + uniformInt(NumTkrLayers - 3);
+
+                addTrack(event, tower, topLayer, m_config.hitsPerLayer, false);
+
+                // Tracks starting low in the tracker make it to the cal
+                if (topLayer < 12) addCalLogs(event, tower, poisson(m_config.calLogsPerTrack), false);
+            }
+
+            addAcdHits(event, poisson(m_config.acdTilesPerEvent), false);
+            event.nTracks = nTracks;
+            break;
+        }
+    }
+
+    // Noise towers
+    int nNoise = poisson(m_config.towerOccupancy);
+    for(int idx = 0; idx < nNoise; idx++) addNoiseTower(event, uniformInt(NumTowers));
+
+    return;
+}
+
+void SyntheticEbfGenerator::addTrack(Event& event, int tower, int topLayer, double clusterMean, bool heavy)
+{
+    // Starting strips and slopes in strips per bilayer (about +/- 45 degrees max)
+    double stripX = uniformInt(NumStrips);
+    double stripY = uniformInt(NumStrips);
+    double slopeX = heavy ? 20. * (uniform() - 0.5) : 280. * (uniform() - 0.5);
+    double slopeY = heavy ? 20. * (uniform() - 0.5) : 280. * (uniform() - 0.5);
+    int    twrX   = tower % 4;
+    int    twrY   = tower / 4;
+
+    for(int layer = topLayer; layer >= 0; layer--)
+    {
+        // Step across tower boundaries, stop if we leave the LAT
+        while(stripX <  0.)        {stripX += NumStrips; twrX--;}
+        while(stripX >= NumStrips) {stripX -= NumStrips; twrX++;}
+        while(stripY <  0.)        {stripY += NumStrips; twrY--;}
+        while(stripY >= NumStrips) {stripY -= NumStrips; twrY++;}
+
+        if (twrX < 0 || twrX > 3 || twrY < 0 || twrY > 3) break;
+
+        int twr = 4 * twrY + twrX;
+
+        for(int view = 0; view < 2; view++)
+        {
+            if (!heavy && uniform() > m_config.hitEfficiency) continue;
+
+            int    nStrips = 1 + poisson(clusterMean - 1.);
+            int    center  = static_cast<int>(view == 0 ? stripX : stripY);
+            int    first   = center - nStrips / 2;
+
+            for(int strip = first; strip < first + nStrips; strip++)
+            {
+                if (strip >= 0 && strip < NumStrips) event.tkrHits.push_back(TkrHit(twr, layer, view, strip));
+            }
+        }
+
+        stripX += slopeX;
+        stripY += slopeY;
+    }
+
+    return;
+}
+
+void SyntheticEbfGenerator::addNoiseTower(Event& event, int tower)
+{
+    // A few isolated hits scattered through the tower
+    int nHits = 1 + poisson(2.);
+
+    for(int idx = 0; idx < nHits; idx++)
+    {
+        event.tkrHits.push_back(TkrHit(tower, uniformInt(NumTkrLayers), uniformInt(2), uniformInt(NumStrips)));
+    }
+
+    return;
+}
+
+void SyntheticEbfGenerator::addCalLogs(Event& event, int tower, int nLogs, bool saturate)
+{
+    for(int idx = 0; idx < nLogs; idx++)
+    {
+        int layer  = saturate ? idx % NumCalLayers : uniformInt(NumCalLayers);
+        int column = uniformInt(NumCalColumns);
+        int range  = saturate ? 3 : uniformInt(2);
+        int adcP   = saturate ? 4000 + uniformInt(95) : 100 + uniformInt(2000);
+        int adcM   = saturate ? 4000 + uniformInt(95) : 100 + uniformInt(2000);
+
+        event.calHits.push_back(CalHit(tower, layer, column, range, adcP, range, adcM));
+    }
+
+    return;
+}
+
+void SyntheticEbfGenerator::addAcdHits(Event& event, int nTiles, bool saturate)
+{
+    for(int idx = 0; idx < nTiles; idx++)
+    {
+        // Top is 5x5, sides 3 rows (plus the row 4 strip ignored here) of 5
+        int face   = uniformInt(5);
+        int row    = face == 0 ? uniformInt(5) : uniformInt(3);
+        int column = uniformInt(5);
+        int pha    = saturate ? 4095 : 200 + uniformInt(1500);
+
+        event.acdHits.push_back(AcdHit(face, row, column, pha));
+    }
+
+    return;
+}
@@ -0,0 +1,146 @@
+/** @file SyntheticEbfGenerator.h
+*
+* @class SyntheticEbfGenerator
+*
+* @brief Seeded generator of synthetic LAT events for deterministic load testing of the
+*        OnboardFilter. Produces lists of tracker strip hits, calorimeter log readouts and
+*        ACD tile hits with tunable distributions (tower occupancy, hits per layer, cal logs,
+*        projection multiplicity) plus heavy ion and shower like extremes. The SyntheticEbfAlg
+*        algorithm turns these into digis which the standard Trigger and EbfWriter chain
+*        then packs into EBF, so the filter sees a correctly formed packet stream.
+*
+*        There is no dependence on Gaudi here, the same seed and configuration always
+*        produce the same sequence of events.
+*
+* $Header$
+*/
+
+#ifndef __SyntheticEbfGenerator_H
+#define __SyntheticEbfGenerator_H
+
+#include <vector>
+#include <string>
+
+class SyntheticEbfGenerator
+{
+public:
+    /// Event classes the generator can produce
+    enum EventType {Empty = 0, Normal = 1, HeavyIon = 2, Shower = 3};
+
+    /// Distribution parameters, defaults give something roughly like on orbit background
+    class Config
+    {
+    public:
+        Config() : seed(12345),
+                   emptyFraction(0.02),
+                   heavyIonFraction(0.01),
+                   showerFraction(0.05),
+                   towerOccupancy(0.5),
+                   tracksPerEvent(1.5),
+                   hitsPerLayer(1.3),
+                   hitEfficiency(0.98),
+                   calLogsPerTrack(6.),
+                   acdTilesPerEvent(1.),
+                   showerTracks(20.),
+                   showerCalLogs(200.) {}
+
+        unsigned long long seed;
+        double emptyFraction;     ///< Fraction of events with no tracker/cal activity
+        double heavyIonFraction;  ///< Fraction of heavy ion events (all layers, saturated cal/acd)
+        double showerFraction;    ///< Fraction of shower like events (many towers, tracks and logs)
+        double towerOccupancy;    ///< Mean number of extra (noise) towers with tracker hits
+        double tracksPerEvent;    ///< Mean number of tracks in a normal event (projection multiplicity)
+        double hitsPerLayer;      ///< Mean cluster size per layer crossed
+        double hitEfficiency;     ///< Probability a track leaves a hit in a given plane
+        double calLogsPerTrack;   ///< Mean number of cal logs hit per track reaching the cal
+        double acdTilesPerEvent;  ///< Mean number of ACD tiles hit
+        double showerTracks;      ///< Mean number of tracks in a shower like event
+        double showerCalLogs;     ///< Mean number of cal logs in a shower like event
+    };
+
+    /// One tracker strip hit. Layer is the bilayer (0 = bottom, 17 = top), view 0 = X, 1 = Y
+    class TkrHit
+    {
+    public:
+        TkrHit(int twr, int lyr, int vw, int str) : tower(twr), layer(lyr), view(vw), strip(str) {}
+        int tower;
+        int layer;
+        int view;
+        int strip;
+    };
+
+    /// One calorimeter log readout (both ends)
+    class CalHit
+    {
+    public:
+        CalHit(int twr, int lyr, int col, int rngP, int adcPlus, int rngM, int adcMinus) :
+               tower(twr), layer(lyr), column(col), rangeP(rngP), adcP(adcPlus), rangeM(rngM), adcM(adcMinus) {}
+        int tower;
+        int layer;
+        int column;
+        int rangeP;
+        int adcP;
+        int rangeM;
+        int adcM;
+    };
+
+    /// One ACD tile hit, face 0 is the top
+    class AcdHit
+    {
+    public:
+        AcdHit(int fc, int rw, int col, int phaVal) : face(fc), row(rw), column(col), pha(phaVal) {}
+        int face;
+        int row;
+        int column;
+        int pha;
+    };
+
+    /// A generated event
+    class Event
+    {
+    public:
+        Event() : type(Empty), nTracks(0) {}
+        void clear() {type = Empty; nTracks = 0; tkrHits.clear(); calHits.clear(); acdHits.clear();}
+
+        EventType           type;
+        int                 nTracks;
+        std::vector<TkrHit> tkrHits;
+        std::vector<CalHit> calHits;
+        std::vector<AcdHit> acdHits;
+    };
+
+    SyntheticEbfGenerator(const Config& config = Config());
+    ~SyntheticEbfGenerator() {}
+
+    /// Generate the next event
+    void generate(Event& event);
+
+    /// Restart the sequence from the configured seed
+    void reset();
+
+    /// Access the configuration
+    const Config& getConfig() const {return m_config;}
+
+    /// Name of an event type
+    static const char* typeName(EventType type);
+
+    // Detector constants used by the generator
+    enum {NumTowers = 16, NumTkrLayers = 18, NumStrips = 1536, NumCalLayers = 8, NumCalColumns = 12};
+
+private:
+    // xorshift64* - small, fast and good enough for load generation
+    unsigned long long next();
+    double             uniform();
+    int                poisson(double mean);
+    int                uniformInt(int n) {return static_cast<int>(uniform() * n) % n;}
+
+    void addTrack(Event& event, int tower, int topLayer, double clusterMean, bool heavy);
+    void addNoiseTower(Event& event, int tower);
+    void addCalLogs(Event& event, int tower, int nLogs, bool saturate);
+    void addAcdHits(Event& event, int nTiles, bool saturate);
+
+    Config             m_config;
+    unsigned long long m_state;
+};
+
+#endif // __SyntheticEbfGenerator_H
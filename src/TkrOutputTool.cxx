@@ -21,6 +21,7 @@
 
 #include "trackProj.h"
 #include "GrbTrack.h"
+#include "ObfPerfMonitor.h"
 #include "OnboardFilterTds/FilterStatus.h"
 #include "OnboardFilterTds/Obf_TFC_prjs.h"
 
@@ -61,6 +62,7 @@
 
 // Useful stuff! 
 #include <map>
+#include <vector>
 #include <stdexcept>
 #include <sstream>
 #include <stdexcept>
@@ -91,6 +93,9 @@ public:
     // This defines the method called for end of event processing
     virtual void eoeProcessing(EDS_fwIxb* ixb);
 
+    // Events without tracker data only get the calorimeter layer energies
+    virtual void eoeBypassed(EDS_fwIxb* ixb);
+
     // This for end of run processing
     virtual void eorProcessing();
 
@@ -109,11 +114,31 @@ private:
     //****** This section for defining JO parameters
     // This is somewhat useless but if set will be passed to the CDM utility to print info
     BooleanProperty   m_towerHits;
+    /// If set, time the tracker kernels and report per call numbers at end of run
+    BooleanProperty   m_timeKernels;
+    /// If set, only run for events OnboardFilter accepts (when it rejects events)
+    BooleanProperty   m_acceptedOnly;
+    /// Only run for a 1 in N subset of the events (see ObfSampler.h)
+    IntegerProperty   m_sampleRate;
+    /// If set, events without tracker data skip track finding and the projection copies
+    BooleanProperty   m_routeByClass;
 
     // Local track variables
     trackProj*        m_trackProj;
     GrbFindTrack*     m_grbTrack;
 
+    // Storage for the TowerHits hit lists. The TDS object only lives for the event
+    // so its hit pointers refer into this buffer, which is reused event to event
+    std::vector<TFC_hit> m_hitArena;
+
+    // Kernel timing when TimeKernels is set
+    unsigned long long m_nEvents;
+    unsigned long long m_nBypassed;
+    ObfKernelStats     m_trackProjStats;
+    ObfKernelStats     m_findTrackStats;
+    ObfKernelStats     m_tkrInfoStats;
+    ObfKernelStats     m_twrHitStats;
+
     //****** This section contains various useful member variables
     /// Pointer to the Gaudi data provider service
     IDataProviderSvc* m_dataSvc;
@@ -128,19 +153,33 @@ DECLARE_TOOL_FACTORY(TkrOutputTool);
 TkrOutputTool::TkrOutputTool(const std::string& type, 
                                  const std::string& name, 
                                  const IInterface* parent) :
-                                 AlgTool(type, name, parent)
+                                 AlgTool(type, name, parent),
+                                 m_trackProj(0),
+                                 m_grbTrack(0),
+                                 m_nEvents(0),
+                                 m_nBypassed(0),
+                                 m_trackProjStats("trackProj::execute"),
+                                 m_findTrackStats("GrbFindTrack::findTrack"),
+                                 m_tkrInfoStats("extractFilterTkrInfo"),
+                                 m_twrHitStats("extractTkrTwrHitInfo")
 {
     //Declare the additional interface
     declareInterface<IFilterTool>(this);
 
     // declare properties with setProperties calls
     declareProperty("FillTowerHits",   m_towerHits = true);
+    declareProperty("TimeKernels",     m_timeKernels = false);
+    declareProperty("AcceptedEventsOnly", m_acceptedOnly = true);
+    declareProperty("SampleRate",      m_sampleRate = 1);
+    declareProperty("RouteByEventClass", m_routeByClass = true);
 
     return;
 }
 //------------------------------------------------------------------------
 TkrOutputTool::~TkrOutputTool()
 {
+    delete m_trackProj;
+    delete m_grbTrack;
 }
 
 StatusCode TkrOutputTool::initialize()
@@ -176,7 +215,9 @@ StatusCode TkrOutputTool::initialize()
         m_grbTrack  = new GrbFindTrack(cfgParms->cfg);
 
         // Register this as an output routine
-        obf->setEovOutputCallBack(this);
+        obf->setEovOutputCallBack(this, m_acceptedOnly.value());
+        obf->setSampleRate(this, name(), m_sampleRate.value());
+        if (m_routeByClass) obf->setEventClassNeeds(this, ObfInterface::TkrEvent);
     }
     catch(ObfInterface::ObfException& obfException)
     {
@@ -213,6 +254,8 @@ void TkrOutputTool::eoeProcessing(EDS_fwIxb* ixb)
         throw std::runtime_error("TkrOutputTool cannot find FilterStatus in the TDS");
     }
 
+    m_nEvents++;
+
     // Store the track information
     storeTrackInfo(ixb);
 
@@ -220,7 +263,9 @@ void TkrOutputTool::eoeProcessing(EDS_fwIxb* ixb)
     extractBestTrackInfo(filterStatus, ixb);
 
     // Get the standard tracker information
+    if (m_timeKernels) m_tkrInfoStats.start();
     extractFilterTkrInfo(filterStatus, ixb);
+    if (m_timeKernels) m_tkrInfoStats.stop();
 
     // If we have a hit info block then get that too
     if (m_towerHits) 
@@ -229,9 +274,31 @@ void TkrOutputTool::eoeProcessing(EDS_fwIxb* ixb)
         OnboardFilterTds::TowerHits *towerHits = new OnboardFilterTds::TowerHits;
         m_dataSvc->registerObject("/Event/Filter/TowerHits", towerHits);
 
+        if (m_timeKernels) m_twrHitStats.start();
         extractTkrTwrHitInfo(towerHits, ixb);
+        if (m_timeKernels) m_twrHitStats.stop();
+    }
+
+    return;
+}
+
+void TkrOutputTool::eoeBypassed(EDS_fwIxb* ixb)
+{
+    SmartDataPtr<OnboardFilterTds::FilterStatus> filterStatus(m_dataSvc,"/Event/Filter/FilterStatus");
+
+    if (!filterStatus)
+    {
+        throw std::runtime_error("TkrOutputTool cannot find FilterStatus in the TDS");
     }
 
+    m_nBypassed++;
+
+    // What eoeProcessing leaves for an event with no projections
+    filterStatus->setLayerEnergy(ixb->blk.evt.cal->layerEnergies);
+    filterStatus->setBestTrack(0, 0, 0., 0., 0., 0., 0, 0, 0., 0.);
+
+    if (m_towerHits) m_dataSvc->registerObject("/Event/Filter/TowerHits", new OnboardFilterTds::TowerHits);
+
     return;
 }
 
@@ -240,6 +307,17 @@ void TkrOutputTool::eorProcessing()
 {
     MsgStream log(msgSvc(), name());
 
+    if (m_nBypassed) log << MSG::INFO << m_nBypassed << " events without tracker data bypassed" << endreq;
+
+    if (m_timeKernels)
+    {
+        log << MSG::INFO << "Kernel timing over " << m_nEvents << " events" << endreq;
+        log << MSG::INFO << m_trackProjStats.summary(m_nEvents) << endreq;
+        log << MSG::INFO << m_findTrackStats.summary(m_nEvents) << endreq;
+        log << MSG::INFO << m_tkrInfoStats.summary(m_nEvents)   << endreq;
+        log << MSG::INFO << m_twrHitStats.summary(m_nEvents)    << endreq;
+    }
+
     return;
 }
 
@@ -254,7 +332,9 @@ void TkrOutputTool::storeTrackInfo(EDS_fwIxb* ixb)
         TFC_prjs *prjs = (TFC_prjs *)ixb->blk.ptrs[EFC_EDS_FW_OBJ_K_TFC_PRJS];
 
         // Try mating XZ and YZ projections to form "best" tracks
+        if (m_timeKernels) m_findTrackStats.start();
         GrbTrack track = m_grbTrack->findTrack(prjs);
+        if (m_timeKernels) m_findTrackStats.stop();
 
         // Test...
         OnboardFilterTds::Obf_TFC_prjs reconObjects(prjs);
@@ -478,8 +558,13 @@ void TkrOutputTool::extractBestTrackInfo(OnboardFilterTds::FilterStatus* filterS
     //if (filterStatus->getTcids()) 
     if (prjs->curCnt > 0) 
     {
+        if (m_timeKernels) m_trackProjStats.start();
         m_trackProj->execute(prjs, xHits, yHits, slopeXZ, slopeYZ, intXZ, intYZ);
+        if (m_timeKernels) m_trackProjStats.stop();
+
+        if (m_timeKernels) m_findTrackStats.start();
         GrbTrack track = m_grbTrack->findTrack(prjs);
+        if (m_timeKernels) m_findTrackStats.stop();
 
         if (track.valid())
         {
@@ -506,6 +591,22 @@ void TkrOutputTool::extractTkrTwrHitInfo(OnboardFilterTds::TowerHits* towerHits,
 
     EDR_tkrUnpack (tkr, dir, twrMsk);
     EDR_tkrTower *ttrs = tkr->twrs;
+
+    // First pass to size the hit buffer, it must not move once pointers are handed out
+    size_t       nHits   = 0;
+    unsigned int cntMsk  = twrMsk;
+    while (cntMsk)
+    {
+        int towerId = FFS (cntMsk);
+
+        for(int layers=0; layers<36; layers++) nHits += ttrs[towerId].layers[layers].cnt;
+
+        cntMsk = FFS_eliminate (cntMsk, towerId);
+    }
+
+    if (m_hitArena.size() < nHits) m_hitArena.resize(nHits);
+
+    TFC_hit* nextHit = nHits > 0 ? &m_hitArena[0] : 0;
 //
     // Look over towers
     while (twrMsk)
@@ -526,12 +627,13 @@ void TkrOutputTool::extractTkrTwrHitInfo(OnboardFilterTds::TowerHits* towerHits,
             if (ttr->layers[layers].cnt > 0)
             {
                 towerHits->m_hits[towerId].cnt[layers] = ttr->layers[layers].cnt;
-                towerHits->m_hits[towerId].beg[layers] = 
-                    (TFC_hit*)malloc(towerHits->m_hits[towerId].cnt[layers]*sizeof(TFC_hit));
+                towerHits->m_hits[towerId].beg[layers] = nextHit;
             
                 memcpy(towerHits->m_hits[towerId].beg[layers],
                    ttr->layers[layers].beg,
                    towerHits->m_hits[towerId].cnt[layers]*sizeof(TFC_hit));
+
+                nextHit += towerHits->m_hits[towerId].cnt[layers];
             }
         }
 
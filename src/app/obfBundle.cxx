@@ -0,0 +1,102 @@
+/**  @file obfBundle.cxx
+    @brief Builds and lists FSW library bundles (see ObfLibraryBundle.h)
+
+    usage: obfBundle -r release -o bundle library [library ...]
+           obfBundle -l bundle
+
+      -r   FSW release the libraries belong to, part of the node cache directory name
+      -o   bundle file to write from the listed library files
+      -l   list the contents of a bundle and check every image against its hash
+
+    Typically every library a job loads is bundled, e.g. for B3-1-3
+      obfBundle -r B3-1-3 -o obf-B3-1-3.bundle $OBFGFC_DBBINDIR/lib*.so $OBFCOG_DBBINDIR/lib*.so ...
+    and the job pointed at it with OnboardFilter.LibraryBundle.
+
+    Exit status is 0 on success and 2 on error.
+
+  $Header$
+*/
+
+#include "../ObfLibraryBundle.h"
+
+#include <cstring>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+namespace
+{
+    const char* usage = "usage: obfBundle -r release -o bundle library [library ...]\n       obfBundle -l bundle";
+
+    int listBundle(const char* fileName)
+    {
+        ObfLibraryBundle bundle;
+        std::string      error;
+
+        if (!bundle.open(fileName, error))
+        {
+            std::cerr << "obfBundle: " << error << std::endl;
+            return 2;
+        }
+
+        const ObfLibraryBundle::Header& header = bundle.header();
+        int                             nBad   = 0;
+
+        std::cout << fileName << ": release " << header.release << ", " << header.nEntries << " libraries, hash "
+                  << std::hex << std::setw(16) << std::setfill('0') << header.hash << std::dec << std::setfill(' ') << std::endl;
+
+        for(unsigned int idx = 0; idx < header.nEntries; idx++)
+        {
+            const ObfLibraryBundle::Entry& entry = bundle.entries()[idx];
+            bool                           good  = ObfLibraryBundle::hash(bundle.image(entry), entry.size) == entry.hash;
+
+            std::cout << std::setw(12) << entry.size << "  " << entry.name << (good ? "" : "  (CORRUPT)") << std::endl;
+
+            if (!good) nBad++;
+        }
+
+        return nBad ? 2 : 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char*              release  = 0;
+    const char*              output   = 0;
+    const char*              list     = 0;
+    std::vector<std::string> libraries;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if      (!strcmp(argv[arg], "-r") && arg + 1 < argc) release = argv[++arg];
+        else if (!strcmp(argv[arg], "-o") && arg + 1 < argc) output  = argv[++arg];
+        else if (!strcmp(argv[arg], "-l") && arg + 1 < argc) list    = argv[++arg];
+        else if (argv[arg][0] != '-')                        libraries.push_back(argv[arg]);
+        else
+        {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+    }
+
+    if (list) return listBundle(list);
+
+    if (!release || !output || libraries.empty())
+    {
+        std::cerr << usage << std::endl;
+        return 2;
+    }
+
+    std::string error;
+
+    if (!ObfLibraryBundle::write(output, release, libraries, error))
+    {
+        std::cerr << "obfBundle: " << error << std::endl;
+        return 2;
+    }
+
+    std::cout << "Wrote " << libraries.size() << " libraries to " << output << std::endl;
+
+    return 0;
+}
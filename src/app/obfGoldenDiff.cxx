@@ -0,0 +1,221 @@
+/**  @file obfGoldenDiff.cxx
+    @brief Compares two OnboardFilter golden files (see ObfGoldenRecord.h)
+
+    usage: obfGoldenDiff [-u] [-n maxReports] [-c context] reference.gold test.gold
+
+      -u   unordered: sort both files on (run, eventId) before comparing, use this to 
+           check output of parallel drivers against a serial reference
+      -n   number of divergent events to report in detail (default 10)
+      -c   number of records of context printed before each divergence (default 2)
+
+    Exit status is 0 if the decisions are identical, 1 if they differ and 2 on error.
+
+    Records are compared in blocks with memcmp, only blocks which differ are examined
+    record by record, so the comparison runs at close to disk speed.
+
+  $Header$  
+*/
+
+#include "../ObfGoldenRecord.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+namespace
+{
+    // Read a whole golden file into memory
+    bool readGolden(const char* fileName, ObfGoldenHeader& header, std::vector<ObfGoldenRecord>& records)
+    {
+        FILE* file = fopen(fileName, "rb");
+
+        if (!file)
+        {
+            std::cerr << "obfGoldenDiff: cannot open " << fileName << std::endl;
+            return false;
+        }
+
+        if (fread(&header, sizeof(header), 1, file) != 1 || !header.valid())
+        {
+            std::cerr << "obfGoldenDiff: " << fileName << " is not a golden file (or has a different record size)" << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, sizeof(header), SEEK_SET);
+
+        size_t nRecords = (fileSize - sizeof(header)) / sizeof(ObfGoldenRecord);
+
+        records.resize(nRecords);
+
+        if (nRecords > 0 && fread(&records[0], sizeof(ObfGoldenRecord), nRecords, file) != nRecords)
+        {
+            std::cerr << "obfGoldenDiff: short read on " << fileName << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        if ((fileSize - sizeof(header)) % sizeof(ObfGoldenRecord))
+        {
+            std::cerr << "obfGoldenDiff: warning, " << fileName << " ends with a partial record" << std::endl;
+        }
+
+        fclose(file);
+
+        return true;
+    }
+
+    void printRecord(const char* tag, const ObfGoldenRecord& rec)
+    {
+        static const char* names[] = {"Gam", "HIP", "MIP", "DGN"};
+
+        std::cout << "  " << tag << " run " << rec.run << " evt " << rec.eventId << " seq " << rec.sequence;
+
+        for(int filter = 0; filter < ObfGoldenRecord::NumFilters; filter++)
+        {
+            if (rec.present & (1 << filter))
+            {
+                std::cout << " " << names[filter] << "[" << static_cast<int>(rec.id[filter]) << "] " 
+                          << std::hex << std::setw(8) << std::setfill('0') << rec.status[filter] 
+                          << "/" << std::setw(2) << static_cast<int>(rec.sb[filter]) << std::dec << std::setfill(' ');
+            }
+            else std::cout << " " << names[filter] << " -";
+        }
+
+        std::cout << " E " << rec.gammaEnergy;
+
+        if (rec.present & ObfGoldenRecord::TrackPresent)
+        {
+            std::cout << " trk " << rec.nXhits << "/" << rec.nYhits << " int (" << rec.xInt << "," << rec.yInt << "," 
+                      << rec.zInt << ") slp (" << rec.slpXZ << "," << rec.slpYZ << ")";
+        }
+
+        std::cout << std::endl;
+    }
+
+    // Name the fields which differ
+    void printDifferences(const ObfGoldenRecord& ref, const ObfGoldenRecord& test)
+    {
+        std::cout << "  differs in:";
+        if (ref.eventId != test.eventId || ref.run != test.run) std::cout << " event-id";
+        if (ref.present != test.present)                        std::cout << " filters-run";
+        for(int filter = 0; filter < ObfGoldenRecord::NumFilters; filter++)
+        {
+            if (ref.status[filter] != test.status[filter]) std::cout << " status[" << filter << "]";
+            if (ref.id[filter]     != test.id[filter])     std::cout << " id["     << filter << "]";
+            if (ref.sb[filter]     != test.sb[filter])     std::cout << " sb["     << filter << "]";
+        }
+        if (ref.gammaEnergy != test.gammaEnergy) std::cout << " gamma-energy";
+        if (ref.nXhits != test.nXhits || ref.nYhits != test.nYhits) std::cout << " track-hits";
+        if (memcmp(&ref.xInt, &test.xInt, 5 * sizeof(float)))       std::cout << " track-params";
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool        unordered  = false;
+    int         maxReports = 10;
+    int         context    = 2;
+    const char* files[2]   = {0, 0};
+    int         nFiles     = 0;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if      (!strcmp(argv[arg], "-u"))                    unordered  = true;
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc)  maxReports = atoi(argv[++arg]);
+        else if (!strcmp(argv[arg], "-c") && arg + 1 < argc)  context    = atoi(argv[++arg]);
+        else if (argv[arg][0] != '-' && nFiles < 2)           files[nFiles++] = argv[arg];
+        else
+        {
+            std::cerr << "usage: obfGoldenDiff [-u] [-n maxReports] [-c context] reference.gold test.gold" << std::endl;
+            return 2;
+        }
+    }
+
+    if (nFiles != 2)
+    {
+        std::cerr << "usage: obfGoldenDiff [-u] [-n maxReports] [-c context] reference.gold test.gold" << std::endl;
+        return 2;
+    }
+
+    ObfGoldenHeader              refHeader, testHeader;
+    std::vector<ObfGoldenRecord> refRecords, testRecords;
+
+    if (!readGolden(files[0], refHeader, refRecords) || !readGolden(files[1], testHeader, testRecords)) return 2;
+
+    std::cout << "reference: " << files[0] << " (" << refRecords.size()  << " records, release " << refHeader.release  << ")" << std::endl;
+    std::cout << "test:      " << files[1] << " (" << testRecords.size() << " records, release " << testHeader.release << ")" << std::endl;
+
+    if (unordered)
+    {
+        std::stable_sort(refRecords.begin(),  refRecords.end());
+        std::stable_sort(testRecords.begin(), testRecords.end());
+    }
+
+    size_t nCommon   = std::min(refRecords.size(), testRecords.size());
+    size_t nDiffer   = 0;
+    int    nReported = 0;
+
+    // Compare in blocks, sequence numbers are excluded so blocks are compared record by record
+    // only when the fast check fails
+    const size_t blockSize = 4096;
+    size_t       compSize  = ObfGoldenRecord::compareSize();
+
+    for(size_t blockStart = 0; blockStart < nCommon; blockStart += blockSize)
+    {
+        size_t blockEnd = std::min(blockStart + blockSize, nCommon);
+        bool   same     = true;
+
+        // Sequence numbers match in the ordered case when both runs saw the same events in 
+        // the same order, which is the common case, so try the whole block first
+        if (!unordered)
+        {
+            same = memcmp(&refRecords[blockStart], &testRecords[blockStart], 
+                          (blockEnd - blockStart) * sizeof(ObfGoldenRecord)) == 0;
+        }
+        else same = false;
+
+        if (same) continue;
+
+        for(size_t idx = blockStart; idx < blockEnd; idx++)
+        {
+            if (memcmp(&refRecords[idx], &testRecords[idx], compSize) == 0) continue;
+
+            nDiffer++;
+
+            if (nReported < maxReports)
+            {
+                std::cout << "Divergence at record " << idx << std::endl;
+
+                size_t first = idx > static_cast<size_t>(context) ? idx - context : 0;
+                for(size_t ctx = first; ctx < idx; ctx++) printRecord("  ref ", refRecords[ctx]);
+
+                printRecord("> ref ", refRecords[idx]);
+                printRecord("> test", testRecords[idx]);
+                printDifferences(refRecords[idx], testRecords[idx]);
+
+                nReported++;
+            }
+        }
+    }
+
+    bool identical = nDiffer == 0 && refRecords.size() == testRecords.size();
+
+    if (refRecords.size() != testRecords.size())
+    {
+        std::cout << "Record counts differ: " << refRecords.size() << " vs " << testRecords.size() << std::endl;
+    }
+
+    std::cout << nCommon << " records compared, " << nDiffer << " differ" << std::endl;
+    std::cout << (identical ? "IDENTICAL" : "DIFFERENT") << std::endl;
+
+    return identical ? 0 : 1;
+}
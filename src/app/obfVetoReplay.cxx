@@ -0,0 +1,184 @@
+/**  @file obfVetoReplay.cxx
+    @brief What-if replay of filter veto masks and prescalers from recorded status words
+
+    usage: obfVetoReplay [-f gamma|hip|mip|dgn] [-x ignoreBits] [-d] -s scenario [-s scenario ...] run.gold
+
+      -f   filter whose status words are replayed (default gamma)
+      -x   bits cleared from every status word before evaluation, e.g. the summary
+           "vetoed" bit the Gamma Filter sets in its own status word
+      -s   a scenario: "mask=0x...,in=N,out=N,leak=bit:N,..." (see ObfVetoReplay.h),
+           may be repeated, each one is evaluated over every event
+      -d   also print the time taken per scenario
+
+    The golden file should come from a run with every filter stage evaluated (RunAllStages
+    for the Gamma Filter) so that all the veto bits are in the status words. Each scenario
+    reports the accepted fraction and, when the file records the decisions (version 2 on),
+    how many decisions agree with, were gained over or were lost from the recorded run.
+
+    Exit status is 0 on success and 2 on error.
+
+  $Header$
+*/
+
+#include "../ObfVetoReplay.h"
+#include "../ObfPerfMonitor.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+namespace
+{
+    const char* usage = "usage: obfVetoReplay [-f gamma|hip|mip|dgn] [-x ignoreBits] [-d] -s scenario [-s scenario ...] run.gold";
+
+    // Read a whole golden file into memory
+    bool readGolden(const char* fileName, ObfGoldenHeader& header, std::vector<ObfGoldenRecord>& records)
+    {
+        FILE* file = fopen(fileName, "rb");
+
+        if (!file)
+        {
+            std::cerr << "obfVetoReplay: cannot open " << fileName << std::endl;
+            return false;
+        }
+
+        if (fread(&header, sizeof(header), 1, file) != 1 || !header.valid())
+        {
+            std::cerr << "obfVetoReplay: " << fileName << " is not a golden file (or has a different record size)" << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, sizeof(header), SEEK_SET);
+
+        size_t nRecords = (fileSize - sizeof(header)) / sizeof(ObfGoldenRecord);
+
+        records.resize(nRecords);
+
+        if (nRecords > 0 && fread(&records[0], sizeof(ObfGoldenRecord), nRecords, file) != nRecords)
+        {
+            std::cerr << "obfVetoReplay: short read on " << fileName << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        fclose(file);
+
+        return true;
+    }
+
+    double percent(unsigned long long count, unsigned long long total)
+    {
+        return total ? 100. * static_cast<double>(count) / static_cast<double>(total) : 0.;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int                                 filter     = ObfGoldenRecord::Gamma;
+    unsigned int                        ignoreBits = 0;
+    bool                                timing     = false;
+    const char*                         fileName   = 0;
+    std::vector<ObfVetoReplay::Scenario> scenarios;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if (!strcmp(argv[arg], "-f") && arg + 1 < argc)
+        {
+            std::string name = argv[++arg];
+
+            if      (name == "gamma") filter = ObfGoldenRecord::Gamma;
+            else if (name == "hip")   filter = ObfGoldenRecord::HIP;
+            else if (name == "mip")   filter = ObfGoldenRecord::MIP;
+            else if (name == "dgn")   filter = ObfGoldenRecord::DGN;
+            else
+            {
+                std::cerr << "obfVetoReplay: unknown filter " << name << std::endl;
+                return 2;
+            }
+        }
+        else if (!strcmp(argv[arg], "-x") && arg + 1 < argc) ignoreBits = strtoul(argv[++arg], 0, 0);
+        else if (!strcmp(argv[arg], "-d"))                   timing     = true;
+        else if (!strcmp(argv[arg], "-s") && arg + 1 < argc)
+        {
+            ObfVetoReplay::Scenario scenario;
+            std::string             error;
+
+            if (!scenario.parse(argv[++arg], error))
+            {
+                std::cerr << "obfVetoReplay: bad scenario \"" << argv[arg] << "\": " << error << std::endl;
+                return 2;
+            }
+
+            scenarios.push_back(scenario);
+        }
+        else if (argv[arg][0] != '-' && !fileName) fileName = argv[arg];
+        else
+        {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+    }
+
+    if (!fileName || scenarios.empty())
+    {
+        std::cerr << usage << std::endl;
+        return 2;
+    }
+
+    ObfGoldenHeader              header;
+    std::vector<ObfGoldenRecord> records;
+
+    if (!readGolden(fileName, header, records)) return 2;
+
+    ObfVetoReplay replay;
+
+    replay.load(records, filter, header.version >= 2, ignoreBits);
+
+    // Done with the records
+    std::vector<ObfGoldenRecord>().swap(records);
+
+    std::cout << fileName << ": " << replay.size() << " events with status (release " << header.release << ")" << std::endl;
+
+    if (!replay.haveRecorded())
+        std::cout << "File predates recorded decisions, no comparison with the recorded run" << std::endl;
+
+    for(std::vector<ObfVetoReplay::Scenario>::const_iterator scenIter = scenarios.begin(); scenIter != scenarios.end(); scenIter++)
+    {
+        long long startNs = ObfPerfMonitor::wallTimeNs();
+
+        ObfVetoReplay::Result result = replay.evaluate(*scenIter);
+
+        long long elapsedNs = ObfPerfMonitor::wallTimeNs() - startNs;
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "[" << scenIter->name << "]\n"
+                  << "  accepted " << result.accepted << " (" << percent(result.accepted, result.events) << "%)"
+                  << " vetoed " << result.vetoed
+                  << " in-prescaled " << result.inPassed
+                  << " leaked " << result.leaked
+                  << " out-prescaled " << result.outRejected << "\n";
+
+        if (replay.haveRecorded())
+        {
+            std::cout << "  vs recorded: agree " << result.agree << " (" << percent(result.agree, result.events) << "%)"
+                      << " gained " << result.gained << " lost " << result.lost << "\n";
+        }
+
+        if (timing && elapsedNs > 0)
+        {
+            std::cout << "  " << std::setprecision(1) << 1.e3 * static_cast<double>(result.events) / elapsedNs
+                      << " M events/s\n";
+        }
+    }
+
+    std::cout << std::flush;
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+// $Header$
+// Include files
+// Gaudi system includes
+#include "GaudiKernel/MsgStream.h"
+#include "GaudiKernel/AlgFactory.h"
+#include "GaudiKernel/IDataProviderSvc.h"
+#include "GaudiKernel/SmartDataPtr.h"
+#include "GaudiKernel/Algorithm.h"
+#include "GaudiKernel/Property.h"
+
+// TDS class declarations
+#include "Event/TopLevel/EventModel.h"
+#include "EbfWriter/Ebf.h"
+#include "OnboardFilterTds/FilterStatus.h"
+
+#include "../ObfPerfMonitor.h"
+
+// Define the class here instead of in a header file: 
+//  not needed anywhere but here!
+//----------------------------------------------------
+/** 
+* bench_OnboardFilter
+*
+* @brief  Brackets the OnboardFilter algorithm (and its output tools) to measure the
+*         cost per event. One instance is placed before OnboardFilter with Stage = "Start"
+*         and one after with Stage = "Stop"; the Stop instance reports at finalize:
+*         ns/event (wall), cpu ns/event, heap allocations/event and peak RSS.
+*
+*         The Start instance also creates the FilterStatus TDS object which the
+*         TkrOutput and CalOutput tools need in order to run, so their kernels can be 
+*         included in a benchmark job.
+*
+*         Heap allocation counts require the ObfAllocHook library, which is linked 
+*         into this program.
+*
+* $Header$
+*/
+
+class bench_OnboardFilter : public Algorithm {
+public:
+    bench_OnboardFilter(const std::string& name, ISvcLocator* pSvcLocator);
+    StatusCode initialize();
+    StatusCode execute();
+    StatusCode finalize();
+    
+private: 
+    /// "Start" or "Stop"
+    StringProperty  m_stage;
+    /// Number of events to skip before accumulating (library loading, first touch of pages)
+    IntegerProperty m_warmUpEvents;
+    /// Create the FilterStatus TDS object if not present (Start stage only)
+    BooleanProperty m_makeFilterStatus;
+
+    //! number of times called
+    int m_count; 
+
+    // State shared between the Start and Stop instances
+    struct BenchState
+    {
+        long long          startWallNs;
+        long long          startCpuNs;
+        unsigned long long startAllocs;
+        unsigned long long startBytes;
+        bool               started;
+
+        unsigned long long events;
+        unsigned long long withEbf;
+        long long          wallNs;
+        long long          cpuNs;
+        unsigned long long allocs;
+        unsigned long long bytes;
+        long long          minNs;
+        long long          maxNs;
+    };
+    static BenchState s_state;
+};
+//------------------------------------------------------------------------
+
+bench_OnboardFilter::BenchState bench_OnboardFilter::s_state = {0, 0, 0, 0, false, 0, 0, 0, 0, 0, 0, 0, 0};
+
+DECLARE_ALGORITHM_FACTORY(bench_OnboardFilter);
+//------------------------------------------------------------------------
+//! ctor
+bench_OnboardFilter::bench_OnboardFilter(const std::string& name, 
+                                         ISvcLocator* pSvcLocator)
+:Algorithm(name, pSvcLocator)
+,m_count(0)
+{
+    declareProperty("Stage",            m_stage            = "Start");
+    declareProperty("WarmUpEvents",     m_warmUpEvents     = 10);
+    declareProperty("MakeFilterStatus", m_makeFilterStatus = true);
+}
+
+//------------------------------------------------------------------------
+//! set parameters and attach to various perhaps useful services.
+StatusCode bench_OnboardFilter::initialize(){
+    StatusCode  sc = StatusCode::SUCCESS;
+    MsgStream log(msgSvc(), name());
+
+    setProperties();
+
+    if (m_stage.value() != "Start" && m_stage.value() != "Stop")
+    {
+        log << MSG::ERROR << "Stage must be Start or Stop, found " << m_stage.value() << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    log << MSG::INFO << "initialize, stage " << m_stage.value() << endreq;
+
+    if (m_stage.value() == "Stop" && !ObfPerfMonitor::allocCountersAvailable())
+    {
+        log << MSG::WARNING << "ObfAllocHook not present, allocations will not be counted" << endreq;
+    }
+    
+    return sc;
+}
+
+//------------------------------------------------------------------------
+//! process an event
+StatusCode bench_OnboardFilter::execute()
+{
+    StatusCode  sc = StatusCode::SUCCESS;
+    MsgStream   log( msgSvc(), name() );
+
+    m_count++;
+
+    if (m_stage.value() == "Start")
+    {
+        if (m_makeFilterStatus)
+        {
+            SmartDataPtr<OnboardFilterTds::FilterStatus> filterStatus(eventSvc(), "/Event/Filter/FilterStatus");
+
+            if (!filterStatus)
+            {
+                OnboardFilterTds::FilterStatus* newStatus = new OnboardFilterTds::FilterStatus;
+
+                if (eventSvc()->registerObject("/Event/Filter/FilterStatus", newStatus).isFailure())
+                {
+                    log << MSG::ERROR << "Could not register FilterStatus in the TDS" << endreq;
+                    delete newStatus;
+                }
+            }
+        }
+
+        s_state.started = m_count > m_warmUpEvents;
+
+        // Take the start readings last so we measure as little of ourselves as possible
+        s_state.startAllocs = ObfPerfMonitor::allocCount();
+        s_state.startBytes  = ObfPerfMonitor::allocBytes();
+        s_state.startCpuNs  = ObfPerfMonitor::cpuTimeNs();
+        s_state.startWallNs = ObfPerfMonitor::wallTimeNs();
+    }
+    else
+    {
+        long long          wallNs = ObfPerfMonitor::wallTimeNs() - s_state.startWallNs;
+        long long          cpuNs  = ObfPerfMonitor::cpuTimeNs()  - s_state.startCpuNs;
+        unsigned long long allocs = ObfPerfMonitor::allocCount() - s_state.startAllocs;
+        unsigned long long bytes  = ObfPerfMonitor::allocBytes() - s_state.startBytes;
+
+        if (!s_state.started) return sc;
+
+        s_state.started = false;
+
+        SmartDataPtr<EbfWriterTds::Ebf> ebfData(eventSvc(), "/Event/Filter/Ebf");
+        if (ebfData) s_state.withEbf++;
+
+        if (s_state.events == 0 || wallNs < s_state.minNs) s_state.minNs = wallNs;
+        if (s_state.events == 0 || wallNs > s_state.maxNs) s_state.maxNs = wallNs;
+
+        s_state.events++;
+        s_state.wallNs += wallNs;
+        s_state.cpuNs  += cpuNs;
+        s_state.allocs += allocs;
+        s_state.bytes  += bytes;
+    }
+
+    return sc;
+}
+
+//------------------------------------------------------------------------
+//! clean up, summarize
+StatusCode bench_OnboardFilter::finalize(){
+    StatusCode  sc = StatusCode::SUCCESS;
+    MsgStream log(msgSvc(), name());
+
+    if (m_stage.value() != "Stop") return sc;
+
+    double nEvents = s_state.events > 0 ? static_cast<double>(s_state.events) : 1.;
+
+    log << MSG::INFO << "Benchmark over " << s_state.events << " events (" << s_state.withEbf 
+        << " with ebf data), " << m_warmUpEvents << " warm up events skipped" << endreq;
+    log << MSG::INFO << "    wall ns/event:   " << static_cast<double>(s_state.wallNs) / nEvents 
+        << " (min " << s_state.minNs << ", max " << s_state.maxNs << ")" << endreq;
+    log << MSG::INFO << "    cpu  ns/event:   " << static_cast<double>(s_state.cpuNs) / nEvents << endreq;
+
+    if (ObfPerfMonitor::allocCountersAvailable())
+    {
+        log << MSG::INFO << "    allocs/event:    " << static_cast<double>(s_state.allocs) / nEvents << endreq;
+        log << MSG::INFO << "    bytes/event:     " << static_cast<double>(s_state.bytes) / nEvents << endreq;
+    }
+    else
+    {
+        log << MSG::INFO << "    allocs/event:    n/a" << endreq;
+    }
+
+    log << MSG::INFO << "    peak RSS (kB):   " << ObfPerfMonitor::peakRssKb() << endreq;
+    
+    return sc;
+}
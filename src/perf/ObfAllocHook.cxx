@@ -0,0 +1,132 @@
+/**  @file ObfAllocHook.cxx
+    @brief Heap allocation counters for the OnboardFilter benchmark programs
+
+    Linking this library into an executable (or LD_PRELOAD'ing it) interposes the
+    C heap entry points and counts every allocation and free made by the process,
+    including those made by the FSW libraries. The counts are read back through
+    ObfAllocHook_counts(), which ObfPerfMonitor locates at run time with dlsym, so
+    nothing else needs to link against this library.
+
+    Only meaningful with glibc, where the real allocator is reachable via the
+    __libc_* entry points. Not built on Windows.
+
+  $Header$
+*/
+
+#include <cstddef>
+#include <cerrno>
+
+extern "C"
+{
+    // The glibc allocator proper
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t nmemb, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void* __libc_valloc(size_t size);
+    void* __libc_pvalloc(size_t size);
+    void  __libc_free(void* ptr);
+}
+
+namespace
+{
+    volatile unsigned long long s_allocs = 0;
+    volatile unsigned long long s_frees  = 0;
+    volatile unsigned long long s_bytes  = 0;
+
+    inline void countAlloc(size_t size)
+    {
+        __sync_fetch_and_add(&s_allocs, 1ULL);
+        __sync_fetch_and_add(&s_bytes,  static_cast<unsigned long long>(size));
+    }
+
+    inline void countFree()
+    {
+        __sync_fetch_and_add(&s_frees, 1ULL);
+    }
+}
+
+extern "C"
+{
+    /// Returns the running number of allocations, frees and bytes requested
+    void ObfAllocHook_counts(unsigned long long* allocs, unsigned long long* frees, unsigned long long* bytes)
+    {
+        if (allocs) *allocs = __sync_fetch_and_add(&s_allocs, 0ULL);
+        if (frees)  *frees  = __sync_fetch_and_add(&s_frees,  0ULL);
+        if (bytes)  *bytes  = __sync_fetch_and_add(&s_bytes,  0ULL);
+    }
+
+    void* malloc(size_t size)
+    {
+        void* ptr = __libc_malloc(size);
+        if (ptr) countAlloc(size);
+        return ptr;
+    }
+
+    void* calloc(size_t nmemb, size_t size)
+    {
+        void* ptr = __libc_calloc(nmemb, size);
+        if (ptr) countAlloc(nmemb * size);
+        return ptr;
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        void* newPtr = __libc_realloc(ptr, size);
+
+        // realloc is a malloc when ptr is null and a free when size is zero
+        if      (!ptr)            {if (newPtr) countAlloc(size);}
+        else if (size == 0)       countFree();
+        else if (newPtr != ptr && newPtr) {countFree(); countAlloc(size);}
+
+        return newPtr;
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        void* ptr = __libc_memalign(alignment, size);
+        if (ptr) countAlloc(size);
+        return ptr;
+    }
+
+    int posix_memalign(void** memptr, size_t alignment, size_t size)
+    {
+        // A power of two multiple of sizeof(void*)
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void*) != 0) return EINVAL;
+
+        void* ptr = __libc_memalign(alignment, size);
+        if (!ptr) return ENOMEM;
+        countAlloc(size);
+        *memptr = ptr;
+        return 0;
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        // glibc's own aligned_alloc is memalign
+        void* ptr = __libc_memalign(alignment, size);
+        if (ptr) countAlloc(size);
+        return ptr;
+    }
+
+    void* valloc(size_t size)
+    {
+        void* ptr = __libc_valloc(size);
+        if (ptr) countAlloc(size);
+        return ptr;
+    }
+
+    void* pvalloc(size_t size)
+    {
+        void* ptr = __libc_pvalloc(size);
+        if (ptr) countAlloc(size);
+        return ptr;
+    }
+
+    void free(void* ptr)
+    {
+        if (!ptr) return;
+        countFree();
+        __libc_free(ptr);
+    }
+}
@@ -0,0 +1,339 @@
+/**  @file ObfReleaseEngine.cxx
+    @brief Implementation of the plain C release engine interface (see ObfReleaseEngine.h)
+
+    Built into its own shared library for the FSW release the package is configured
+    against, together with ObfInterface and that release's filter library tables.
+
+  $Header$
+*/
+
+#include "ObfReleaseEngine.h"
+
+#include "../ObfInterface.h"
+#include "../IFilterLibs.h"
+
+#include "facilities/Util.h"
+#include "facilities/commonUtilities.h"
+
+// FSW includes go here
+#ifdef OBF_B1_1_3
+#include "FSWHeaders/EFC.h"
+#endif
+#if defined(OBF_B3_0_0) || defined(OBF_B3_1_0) || defined(OBF_B3_1_1) || defined(OBF_B3_1_3)
+#include "EFC/EFC.h"
+#endif
+#include "EFC_DB/EFC_DB_schema.h"
+
+// Contains all info for a particular filter's release
+#if defined(OBF_B3_0_0) || defined(OBF_B3_1_0) || defined(OBF_B3_1_1) || defined(OBF_B3_1_3)
+#include "../GammaFilterLibsB3-0-0.h"
+#include "../HIPFilterLibsB3-0-0.h"
+#include "../MIPFilterLibsB3-0-0.h"
+#include "../DGNFilterLibsB3-0-0.h"
+#endif
+#ifdef OBF_B1_1_3
+#include "../GammaFilterLibsB1-1-3.h"
+#include "../HIPFilterLibsB1-1-3.h"
+#include "../MIPFilterLibsB1-1-3.h"
+#include "../DGNFilterLibsB1-1-3.h"
+#endif
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+
+namespace
+{
+    /// One engine per library (and so per link namespace), ObfInterface is a singleton
+    class ObfReleaseEngine
+    {
+    public:
+        ObfReleaseEngine() : m_obf(0), m_result(0)
+        {
+            for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+            {
+                m_filterLibs[slot] = 0;
+                m_handlerIds[slot] = -1;
+            }
+        }
+
+        ~ObfReleaseEngine()
+        {
+            for(int slot = 0; slot < ObfRelease_NumFilters; slot++) delete m_filterLibs[slot];
+        }
+
+        ObfInterface*     m_obf;
+        IFilterLibs*      m_filterLibs[ObfRelease_NumFilters];
+        int               m_handlerIds[ObfRelease_NumFilters];
+        ObfReleaseResult* m_result;          // Result for the event being processed
+        std::string       m_release;
+    };
+
+    ObfReleaseEngine* s_engine = 0;
+
+    // Point a $(OBF...BINDIR) variable at a package of this release, as OnboardFilter::initialize
+    void setPackagePath(const std::string& variable, const std::string& package, const std::string& version)
+    {
+        using facilities::commonUtilities;
+
+        std::string obfldpath("$(OBFLDPATH)");
+        std::string pkgpath = commonUtilities::joinPath(package, version);
+
+        commonUtilities::setEnvironment(variable, commonUtilities::joinPath(obfldpath, pkgpath));
+    }
+
+    // The compiled in package versions are those of the release the engine was built against
+    void setReleasePaths()
+    {
+#ifdef OBFCOG_DB
+        setPackagePath("OBFCOG_DBBINDIR", "COG_DB", OBFCOG_DB);
+#endif
+#ifdef OBFCGB_DB
+        setPackagePath("OBFCGB_DBBINDIR", "CGB_DB", OBFCGB_DB);
+#endif
+#ifdef OBFCOP_DB
+        setPackagePath("OBFCOP_DBBINDIR", "COP_DB", OBFCOP_DB);
+#endif
+#ifdef OBFCPP_DB
+        setPackagePath("OBFCPP_DBBINDIR", "CPP_DB", OBFCPP_DB);
+#endif
+#ifdef OBFCPG_DB
+        setPackagePath("OBFCPG_DBBINDIR", "CPG_DB", OBFCPG_DB);
+#endif
+#ifdef OBFGFC_DB
+        setPackagePath("OBFGFC_DBBINDIR", "GFC_DB", OBFGFC_DB);
+#endif
+#ifdef OBFGGF_DB
+        setPackagePath("OBFGGF_DBBINDIR", "GGF_DB", OBFGGF_DB);
+#endif
+#ifdef OBFXFC_DB
+        setPackagePath("OBFXFC_DBBINDIR", "XFC_DB", OBFXFC_DB);
+#endif
+#ifdef OBFXFC
+        setPackagePath("OBFXFCBINDIR",    "XFC",    OBFXFC);
+#endif
+#ifdef OBFEFC
+        setPackagePath("OBFEFCBINDIR",    "EFC",    OBFEFC);
+#endif
+        return;
+    }
+
+    // Apply the NAME=value;NAME=value options
+    void setOptions(const std::string& options)
+    {
+        std::string::size_type start = 0;
+
+        while(start < options.size())
+        {
+            std::string::size_type end = options.find(';', start);
+            if (end == std::string::npos) end = options.size();
+
+            std::string            setting = options.substr(start, end - start);
+            std::string::size_type equals  = setting.find('=');
+
+            if (equals != std::string::npos)
+                facilities::commonUtilities::setEnvironment(setting.substr(0, equals), setting.substr(equals + 1));
+
+            start = end + 1;
+        }
+
+        return;
+    }
+
+    // Create the release specific filter library tables
+    void createFilterLibs(IFilterLibs* filterLibs[])
+    {
+#if defined(OBF_B3_0_0)
+        filterLibs[ObfRelease_Gamma] = new GammaFilterLibsB3_0_0();
+        filterLibs[ObfRelease_HIP]   = new HIPFilterLibsB3_0_0();
+        filterLibs[ObfRelease_MIP]   = new MIPFilterLibsB3_0_0();
+        filterLibs[ObfRelease_DGN]   = new DGNFilterLibsB3_0_0();
+#elif  defined(OBF_B3_1_0)
+        filterLibs[ObfRelease_Gamma] = new GammaFilterLibsB3_0_0("B3-1-0");
+        filterLibs[ObfRelease_HIP]   = new HIPFilterLibsB3_0_0("B3-1-0");
+        filterLibs[ObfRelease_MIP]   = new MIPFilterLibsB3_0_0("B3-1-0");
+        filterLibs[ObfRelease_DGN]   = new DGNFilterLibsB3_0_0("B3-1-0");
+#elif  defined(OBF_B3_1_1) || defined(OBF_B3_1_3)
+        filterLibs[ObfRelease_Gamma] = new GammaFilterLibsB3_0_0("B3-1-1");
+        filterLibs[ObfRelease_HIP]   = new HIPFilterLibsB3_0_0("B3-1-1");
+        filterLibs[ObfRelease_MIP]   = new MIPFilterLibsB3_0_0("B3-1-1");
+        filterLibs[ObfRelease_DGN]   = new DGNFilterLibsB3_0_0("B3-1-1");
+#endif
+#ifdef OBF_B1_1_3
+        filterLibs[ObfRelease_Gamma] = new GammaFilterLibsB1_1_3();
+        filterLibs[ObfRelease_HIP]   = new HIPFilterLibsB1_1_3();
+        filterLibs[ObfRelease_MIP]   = new MIPFilterLibsB1_1_3();
+        filterLibs[ObfRelease_DGN]   = new DGNFilterLibsB1_1_3();
+#endif
+        return;
+    }
+
+    // Set up one filter as the filter tools do without Moot
+    int setupFilter(ObfInterface* obf, IFilterLibs* filterLibs)
+    {
+        const EFC_DB_Schema& master = obf->loadFilterLibs(filterLibs, 0);
+
+        unsigned short int curMode   = EFC_DB_MODE_K_NORMAL;
+        int                handlerId = obf->setupFilter(&master, filterLibs->getMasterConfiguration().filter.mode2cfg[curMode]);
+
+        if (handlerId == -100) return handlerId;
+
+        unsigned int target = obf->getFilterTargetMask(master.filter.id);
+
+        for (int modeIdx = 0; modeIdx < EFC_DB_MODE_K_CNT; modeIdx++)
+        {
+            obf->associateConfigToMode(target, modeIdx, filterLibs->getMasterConfiguration().filter.mode2cfg[modeIdx]);
+        }
+
+        obf->enableDisableFilter(target, target);
+        obf->selectFiltermode(target, curMode);
+
+        return handlerId;
+    }
+
+    // End of event call back, copy the results out of the result descriptors
+    void extractResults(void* prm, EDS_fwIxb* ixb)
+    {
+        ObfReleaseEngine* engine = reinterpret_cast<ObfReleaseEngine*>(prm);
+
+        if (!engine->m_result) return;
+
+        for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+        {
+            if (engine->m_handlerIds[slot] < 0) continue;
+
+            EDS_rsdDsc*             rsdDsc = ixb->rsd.dscs + engine->m_handlerIds[slot];
+            unsigned int*           dscPtr = (unsigned int*)rsdDsc->ptr;
+            ObfReleaseFilterResult& result = engine->m_result->filters[slot];
+
+            if (!dscPtr) continue;
+
+            // Same rule as OnboardFilter
+            unsigned char sb = (rsdDsc->sb & (EDS_RSD_SB_M_VETOED | EDS_RSD_SB_M_PRESCALE_OUT)) >> EDS_RSD_SB_V_PRESCALE_OUT;
+
+            result.ran      = 1;
+            result.accepted = sb == 0 || sb == 3;
+            result.sb       = rsdDsc->sb;
+            result.id       = rsdDsc->id;
+            result.status   = dscPtr[0];
+            result.energy   = slot == ObfRelease_Gamma ? dscPtr[1] : 0;
+        }
+
+        return;
+    }
+}
+
+void* ObfRelease_create(const char* options, char* error, unsigned int errorSize)
+{
+    if (s_engine)
+    {
+        if (error && errorSize) snprintf(error, errorSize, "an engine already exists in this namespace");
+        return 0;
+    }
+
+    ObfReleaseEngine* engine = new ObfReleaseEngine();
+
+    try
+    {
+        setReleasePaths();
+        if (options) setOptions(options);
+
+        engine->m_obf = ObfInterface::instance();
+        engine->m_obf->setDeferConfigLoading(true);
+
+        // Calibration and geometry libraries, as FSWAuxLibsTool
+        engine->m_obf->loadLibrary("cal_db_pedestals", "$(OBFCOP_DBBINDIR)/cal_db_pedestals");
+        engine->m_obf->loadLibrary("cal_db_gains",     "$(OBFCOG_DBBINDIR)/cal_db_gains");
+        engine->m_obf->loadLibrary("geo_db_data",      "$(OBFGGF_DBBINDIR)/geo_db_data");
+
+        createFilterLibs(engine->m_filterLibs);
+
+        for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+        {
+            if (!engine->m_filterLibs[slot]) continue;
+
+            engine->m_handlerIds[slot] = setupFilter(engine->m_obf, engine->m_filterLibs[slot]);
+
+            if (engine->m_handlerIds[slot] == -100)
+            {
+                if (error && errorSize)
+                    snprintf(error, errorSize, "failed to set up filter schema %d", engine->m_filterLibs[slot]->FilterSchema());
+                delete engine;
+                return 0;
+            }
+
+            engine->m_release = engine->m_filterLibs[slot]->FlightSoftwareRelease();
+        }
+
+        engine->m_obf->setupPassThrough(0);
+        engine->m_obf->setEovOutputCallBack(extractResults, engine);
+    }
+    catch(ObfInterface::ObfException& obfException)
+    {
+        if (error && errorSize) snprintf(error, errorSize, "%s", obfException.m_what.c_str());
+        delete engine;
+        return 0;
+    }
+
+    s_engine = engine;
+
+    return engine;
+}
+
+int ObfRelease_filter(void* prm, char* data, unsigned int length, ObfReleaseResult* result)
+{
+    ObfReleaseEngine* engine = reinterpret_cast<ObfReleaseEngine*>(prm);
+
+    memset(result, 0, sizeof(ObfReleaseResult));
+
+    engine->m_result = result;
+
+    try
+    {
+        result->fate = engine->m_obf->filterEvent(data, length);
+    }
+    catch(ObfInterface::ObfException&)
+    {
+        engine->m_result = 0;
+        return 1;
+    }
+
+    engine->m_result = 0;
+
+    return 0;
+}
+
+const char* ObfRelease_release(void* prm)
+{
+    return reinterpret_cast<ObfReleaseEngine*>(prm)->m_release.c_str();
+}
+
+unsigned int ObfRelease_prescaled(void* prm)
+{
+    ObfReleaseEngine* engine    = reinterpret_cast<ObfReleaseEngine*>(prm);
+    unsigned int      prescaled = 0;
+
+    // The engine only runs the NORMAL mode configurations, so these are all there is to check
+    for(int slot = 0; slot < ObfRelease_NumFilters; slot++)
+    {
+        if (engine->m_filterLibs[slot] && engine->m_handlerIds[slot] >= 0
+            && engine->m_obf->prescalesEvents(engine->m_filterLibs[slot]->FilterSchema())) prescaled |= 1 << slot;
+    }
+
+    return prescaled;
+}
+
+void ObfRelease_destroy(void* prm)
+{
+    ObfReleaseEngine* engine = reinterpret_cast<ObfReleaseEngine*>(prm);
+
+    if (engine->m_obf) engine->m_obf->dumpCounters();
+
+    delete engine;
+
+    if (s_engine == engine) s_engine = 0;
+
+    return;
+}
@@ -0,0 +1,73 @@
+/** @file ObfReleaseEngine.h
+*
+* @brief Plain C interface to a complete flight software filter stack built against one
+*        FSW release. The engine library (libObfReleaseEngine<release>) contains its own
+*        ObfInterface and the release specific filter library tables, and is linked to that
+*        release's FSW libraries. Because the FSW code is C with global symbols and
+*        registries (CDM databases, EFC lookups), two releases cannot share a link namespace;
+*        a driver loads each engine with dlmopen into its own namespace and talks to it only
+*        through the functions below, so nothing but plain data crosses the boundary.
+*
+*        The engine runs the Gamma, HIP, MIP and DGN filters in their NORMAL mode master
+*        configurations, as the filter tools do when not using Moot.
+*
+* $Header$
+*/
+
+#ifndef __ObfReleaseEngine_H
+#define __ObfReleaseEngine_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Slots in the result, same order as ObfGoldenRecord
+enum {ObfRelease_Gamma = 0, ObfRelease_HIP = 1, ObfRelease_MIP = 2, ObfRelease_DGN = 3, ObfRelease_NumFilters = 4};
+
+/// Result of one filter on one event
+typedef struct _ObfReleaseFilterResult
+{
+    unsigned char  ran;        /*!< Non zero if the filter ran on the event            */
+    unsigned char  accepted;   /*!< Non zero if the filter accepted the event          */
+    unsigned char  sb;         /*!< Summary byte                                       */
+    unsigned char  id;         /*!< Result descriptor id                               */
+    unsigned int   status;     /*!< Status word                                        */
+    unsigned int   energy;     /*!< Energy (Gamma Filter only)                         */
+} ObfReleaseFilterResult;
+
+/// Result of all filters on one event
+typedef struct _ObfReleaseResult
+{
+    unsigned int           fate;                             /*!< Return of the EDS framework */
+    ObfReleaseFilterResult filters[ObfRelease_NumFilters];
+} ObfReleaseResult;
+
+/// Create the engine. Options are ';' separated NAME=value pairs set in the environment
+/// before any library is loaded (e.g. to point the $(OBF...BINDIR) paths at this release).
+/// Returns 0 on failure with a message in error
+typedef void*       (*ObfRelease_createFn) (const char* options, char* error, unsigned int errorSize);
+
+/// Run the filters on one event (a buffer of EBF packets), returns 0 on success
+typedef int         (*ObfRelease_filterFn) (void* engine, char* data, unsigned int length, ObfReleaseResult* result);
+
+/// Flight software release the engine was built against
+typedef const char* (*ObfRelease_releaseFn)(void* engine);
+
+/// Filters which prescale events, bit n set for slot n. A prescaler counts the events its
+/// engine has seen, so the results of these filters depend on every earlier event
+typedef unsigned int (*ObfRelease_prescaledFn)(void* engine);
+
+/// Release everything
+typedef void        (*ObfRelease_destroyFn)(void* engine);
+
+void*        ObfRelease_create   (const char* options, char* error, unsigned int errorSize);
+int          ObfRelease_filter   (void* engine, char* data, unsigned int length, ObfReleaseResult* result);
+const char*  ObfRelease_release  (void* engine);
+unsigned int ObfRelease_prescaled(void* engine);
+void         ObfRelease_destroy  (void* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ObfReleaseEngine_H
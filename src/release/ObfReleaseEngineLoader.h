@@ -0,0 +1,92 @@
+/** @file ObfReleaseEngineLoader.h
+*
+* @class ObfReleaseEngineLoader
+*
+* @brief Loads a release engine library (see ObfReleaseEngine.h) with dlmopen into a link
+*        namespace of its own and starts the engine. Each loader gets its own copy of the
+*        FSW libraries, so several engines, of the same release or not, can run side by
+*        side. glibc allows 16 namespaces in all, the main program's included. Only
+*        available on glibc platforms.
+*
+*        No dependence on Gaudi.
+*
+* $Header$
+*/
+
+#ifndef __ObfReleaseEngineLoader_H
+#define __ObfReleaseEngineLoader_H
+
+#include "release/ObfReleaseEngine.h"
+
+// dlmopen is a GNU extension (g++ defines _GNU_SOURCE)
+#ifndef _WIN32
+#  include <dlfcn.h>
+#endif
+
+#include <string>
+
+class ObfReleaseEngineLoader
+{
+public:
+    ObfReleaseEngineLoader() : handle(0), engine(0), create(0), filter(0), release(0), prescaled(0), destroy(0) {}
+
+    /// Load the library and create the engine, returns false with a message on failure
+    bool load(const std::string& fileName, const std::string& options, std::string& error)
+    {
+#ifdef _WIN32
+        error = "release engines need dlmopen, not available on this platform";
+        return false;
+#else
+        // A new link namespace, so this FSW stack does not see any other
+        handle = dlmopen(LM_ID_NEWLM, fileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+        if (!handle)
+        {
+            error = "unable to load release engine " + fileName + ": " + dlerror();
+            return false;
+        }
+
+        create    = reinterpret_cast<ObfRelease_createFn>   (dlsym(handle, "ObfRelease_create"));
+        filter    = reinterpret_cast<ObfRelease_filterFn>   (dlsym(handle, "ObfRelease_filter"));
+        release   = reinterpret_cast<ObfRelease_releaseFn>  (dlsym(handle, "ObfRelease_release"));
+        prescaled = reinterpret_cast<ObfRelease_prescaledFn>(dlsym(handle, "ObfRelease_prescaled"));
+        destroy   = reinterpret_cast<ObfRelease_destroyFn>  (dlsym(handle, "ObfRelease_destroy"));
+
+        if (!create || !filter || !release || !prescaled || !destroy)
+        {
+            error = fileName + " is not a release engine library";
+            return false;
+        }
+
+        char message[256];
+        message[0] = 0;
+
+        engine = create(options.c_str(), message, sizeof(message));
+
+        if (!engine)
+        {
+            error = "release engine " + fileName + " failed to start: " + message;
+            return false;
+        }
+
+        return true;
+#endif
+    }
+
+    /// Release the engine. The library is left open, FSW libraries do not expect to be unloaded
+    void unload()
+    {
+        if (engine) destroy(engine);
+        engine = 0;
+    }
+
+    void*                  handle;
+    void*                  engine;
+    ObfRelease_createFn    create;
+    ObfRelease_filterFn    filter;
+    ObfRelease_releaseFn   release;
+    ObfRelease_prescaledFn prescaled;
+    ObfRelease_destroyFn   destroy;
+};
+
+#endif // __ObfReleaseEngineLoader_H
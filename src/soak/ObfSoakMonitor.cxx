@@ -0,0 +1,267 @@
+// $Header$
+// Include files
+// Gaudi system includes
+#include "GaudiKernel/MsgStream.h"
+#include "GaudiKernel/AlgFactory.h"
+#include "GaudiKernel/IDataProviderSvc.h"
+#include "GaudiKernel/SmartDataPtr.h"
+#include "GaudiKernel/Algorithm.h"
+#include "GaudiKernel/Property.h"
+
+#include "OnboardFilterTds/FilterStatus.h"
+
+#include "../ObfPerfMonitor.h"
+
+// Define the class here instead of in a header file: 
+//  not needed anywhere but here!
+//----------------------------------------------------
+/** 
+* ObfSoakMonitor
+*
+* @brief  Watches a long running job for growth in memory and per event latency.
+*
+*         Every SampleInterval events the resident set size, the number of live heap
+*         allocations (needs ObfAllocHook) and the mean wall time per event over the 
+*         interval are sampled. The first sample after WarmUpEvents is the baseline.
+*         The job fails if, relative to the baseline,
+*           - RSS grows by more than MaxRssGrowthKb
+*           - live allocations grow by more than MaxLiveAllocGrowth
+*           - the mean event latency grows by more than the factor MaxLatencyDrift
+*         The check is made at every sample when FailFast is set (stopping the run at
+*         the first violation), and always at finalize.
+*
+*         When MakeFilterStatus is set (place the monitor before OnboardFilter) the
+*         FilterStatus TDS object used by the Tkr/Cal output tools is created so that
+*         the full tool chain is exercised.
+*
+* $Header$
+*/
+
+class ObfSoakMonitor : public Algorithm {
+public:
+    ObfSoakMonitor(const std::string& name, ISvcLocator* pSvcLocator);
+    StatusCode initialize();
+    StatusCode execute();
+    StatusCode finalize();
+    
+private: 
+    /// Take a sample, returns false if a threshold was exceeded
+    bool sample(MsgStream& log);
+
+    IntegerProperty m_sampleInterval;
+    IntegerProperty m_warmUpEvents;
+    IntegerProperty m_maxRssGrowthKb;
+    IntegerProperty m_maxLiveAllocGrowth;
+    DoubleProperty  m_maxLatencyDrift;
+    BooleanProperty m_failFast;
+    BooleanProperty m_makeFilterStatus;
+
+    //! number of times called
+    unsigned long long m_count; 
+
+    // Interval accounting
+    long long          m_lastNs;
+    long long          m_intervalNs;
+    unsigned long long m_intervalEvents;
+
+    // Baseline and worst values
+    bool               m_haveBaseline;
+    long               m_baseRssKb;
+    long long          m_baseLiveAllocs;
+    double             m_baseLatencyNs;
+    long               m_maxRssKb;
+    long long          m_maxLiveAllocs;
+    double             m_maxLatencyNs;
+    int                m_nSamples;
+    bool               m_violation;
+};
+//------------------------------------------------------------------------
+
+DECLARE_ALGORITHM_FACTORY(ObfSoakMonitor);
+//------------------------------------------------------------------------
+//! ctor
+ObfSoakMonitor::ObfSoakMonitor(const std::string& name, ISvcLocator* pSvcLocator)
+:Algorithm(name, pSvcLocator)
+,m_count(0)
+,m_lastNs(0)
+,m_intervalNs(0)
+,m_intervalEvents(0)
+,m_haveBaseline(false)
+,m_baseRssKb(0)
+,m_baseLiveAllocs(0)
+,m_baseLatencyNs(0.)
+,m_maxRssKb(0)
+,m_maxLiveAllocs(0)
+,m_maxLatencyNs(0.)
+,m_nSamples(0)
+,m_violation(false)
+{
+    declareProperty("SampleInterval",     m_sampleInterval     = 100000);
+    declareProperty("WarmUpEvents",       m_warmUpEvents       = 10000);
+    declareProperty("MaxRssGrowthKb",     m_maxRssGrowthKb     = 20000);
+    declareProperty("MaxLiveAllocGrowth", m_maxLiveAllocGrowth = 1000);
+    declareProperty("MaxLatencyDrift",    m_maxLatencyDrift    = 1.5);
+    declareProperty("FailFast",           m_failFast           = false);
+    declareProperty("MakeFilterStatus",   m_makeFilterStatus   = true);
+}
+
+//------------------------------------------------------------------------
+StatusCode ObfSoakMonitor::initialize(){
+    StatusCode  sc = StatusCode::SUCCESS;
+    MsgStream log(msgSvc(), name());
+
+    setProperties();
+
+    if (m_sampleInterval <= 0)
+    {
+        log << MSG::ERROR << "SampleInterval must be positive" << endreq;
+        return StatusCode::FAILURE;
+    }
+
+    if (!ObfPerfMonitor::allocCountersAvailable())
+    {
+        log << MSG::WARNING << "ObfAllocHook not present, live allocations will not be checked" << endreq;
+    }
+
+    log << MSG::INFO << "Sampling every " << m_sampleInterval << " events after " << m_warmUpEvents 
+        << " warm up events" << endreq;
+    
+    return sc;
+}
+
+//------------------------------------------------------------------------
+StatusCode ObfSoakMonitor::execute()
+{
+    StatusCode  sc = StatusCode::SUCCESS;
+    MsgStream   log( msgSvc(), name() );
+
+    // Latency is the time from our previous call, ie the cost of a full event
+    long long now = ObfPerfMonitor::wallTimeNs();
+    if (m_count > 0)
+    {
+        m_intervalNs += now - m_lastNs;
+        m_intervalEvents++;
+    }
+    m_lastNs = now;
+    m_count++;
+
+    if (m_makeFilterStatus)
+    {
+        SmartDataPtr<OnboardFilterTds::FilterStatus> filterStatus(eventSvc(), "/Event/Filter/FilterStatus");
+
+        if (!filterStatus)
+        {
+            OnboardFilterTds::FilterStatus* newStatus = new OnboardFilterTds::FilterStatus;
+
+            if (eventSvc()->registerObject("/Event/Filter/FilterStatus", newStatus).isFailure())
+            {
+                log << MSG::ERROR << "Could not register FilterStatus in the TDS" << endreq;
+                delete newStatus;
+            }
+        }
+    }
+
+    // Throw away the warm up period
+    if (m_count == static_cast<unsigned long long>(m_warmUpEvents.value()))
+    {
+        m_intervalNs     = 0;
+        m_intervalEvents = 0;
+    }
+
+    if (m_count > static_cast<unsigned long long>(m_warmUpEvents.value()) 
+        && m_intervalEvents >= static_cast<unsigned long long>(m_sampleInterval.value()))
+    {
+        if (!sample(log) && m_failFast)
+        {
+            log << MSG::ERROR << "Soak test threshold exceeded at event " << m_count << ", stopping" << endreq;
+            sc = StatusCode::FAILURE;
+        }
+    }
+
+    return sc;
+}
+
+//------------------------------------------------------------------------
+bool ObfSoakMonitor::sample(MsgStream& log)
+{
+    long      rssKb      = ObfPerfMonitor::currentRssKb();
+    long long liveAllocs = ObfPerfMonitor::liveAllocCount();
+    double    latencyNs  = static_cast<double>(m_intervalNs) / m_intervalEvents;
+
+    m_intervalNs     = 0;
+    m_intervalEvents = 0;
+    m_nSamples++;
+
+    if (!m_haveBaseline)
+    {
+        m_baseRssKb      = rssKb;
+        m_baseLiveAllocs = liveAllocs;
+        m_baseLatencyNs  = latencyNs;
+        m_haveBaseline   = true;
+    }
+
+    if (rssKb      > m_maxRssKb)      m_maxRssKb      = rssKb;
+    if (liveAllocs > m_maxLiveAllocs) m_maxLiveAllocs = liveAllocs;
+    if (latencyNs  > m_maxLatencyNs)  m_maxLatencyNs  = latencyNs;
+
+    log << MSG::INFO << "Event " << m_count << " RSS " << rssKb << " kB (" << rssKb - m_baseRssKb << ")"
+        << ", live allocs " << liveAllocs << " (" << liveAllocs - m_baseLiveAllocs << ")"
+        << ", ns/event " << latencyNs << endreq;
+
+    bool ok = true;
+
+    if (rssKb - m_baseRssKb > m_maxRssGrowthKb)
+    {
+        log << MSG::ERROR << "RSS grew by " << rssKb - m_baseRssKb << " kB, limit " << m_maxRssGrowthKb << endreq;
+        ok = false;
+    }
+
+    if (ObfPerfMonitor::allocCountersAvailable() && liveAllocs - m_baseLiveAllocs > m_maxLiveAllocGrowth)
+    {
+        log << MSG::ERROR << "Live allocations grew by " << liveAllocs - m_baseLiveAllocs 
+            << ", limit " << m_maxLiveAllocGrowth << endreq;
+        ok = false;
+    }
+
+    if (m_baseLatencyNs > 0. && latencyNs > m_maxLatencyDrift * m_baseLatencyNs)
+    {
+        log << MSG::ERROR << "Latency drifted from " << m_baseLatencyNs << " to " << latencyNs 
+            << " ns/event, limit factor " << m_maxLatencyDrift << endreq;
+        ok = false;
+    }
+
+    if (!ok) m_violation = true;
+
+    return ok;
+}
+
+//------------------------------------------------------------------------
+StatusCode ObfSoakMonitor::finalize(){
+    StatusCode  sc = StatusCode::SUCCESS;
+    MsgStream log(msgSvc(), name());
+
+    // Take a last sample for any partial interval
+    if (m_intervalEvents > 0 && m_count > static_cast<unsigned long long>(m_warmUpEvents.value())) sample(log);
+
+    log << MSG::INFO << "Soak test over " << m_count << " events, " << m_nSamples << " samples" << endreq;
+
+    if (!m_haveBaseline)
+    {
+        log << MSG::WARNING << "Not enough events for a baseline, nothing checked" << endreq;
+        return sc;
+    }
+
+    log << MSG::INFO << "    RSS (kB):       baseline " << m_baseRssKb      << ", max " << m_maxRssKb 
+        << ", peak " << ObfPerfMonitor::peakRssKb() << endreq;
+    log << MSG::INFO << "    live allocs:    baseline " << m_baseLiveAllocs << ", max " << m_maxLiveAllocs << endreq;
+    log << MSG::INFO << "    ns/event:       baseline " << m_baseLatencyNs  << ", max " << m_maxLatencyNs  << endreq;
+
+    if (m_violation)
+    {
+        log << MSG::ERROR << "Soak test FAILED" << endreq;
+        sc = StatusCode::FAILURE;
+    }
+    else log << MSG::INFO << "Soak test passed" << endreq;
+    
+    return sc;
+}
@@ -6,11 +6,22 @@
 #include "GaudiKernel/IDataProviderSvc.h"
 #include "GaudiKernel/SmartDataPtr.h"
 #include "GaudiKernel/Algorithm.h"
+#include "GaudiKernel/Property.h"
 
 // TDS class declarations: input data, and McParticle tree
 
 #include "Event/TopLevel/EventModel.h"
+#include "Event/TopLevel/Event.h"
 #include "OnboardFilterTds/ObfFilterStatus.h"
+#include "OnboardFilterTds/ObfFilterTrack.h"
+
+#include "facilities/Util.h"
+
+#include "../ObfPerfMonitor.h"
+#include "../ObfGoldenRecord.h"
+
+#include <sstream>
+#include <iomanip>
 
 // Define the class here instead of in a header file: 
 //  not needed anywhere but here!
@@ -20,6 +31,18 @@
 *
 * @brief  A miminal test of OnboardFilter, using as few other packages as possible
 *
+*         Also serves as a throughput and correctness harness: a rolling (FNV-1a) hash
+*         is accumulated over every filter's key, status word, summary byte and the 
+*         gamma filter energy, in event order. At finalize the hash, events/second, 
+*         cpu per event and peak RSS are reported and, if GoldenHash is set, the hash 
+*         is compared and the job fails on a mismatch. This way a change can be shown
+*         to leave every decision bit-identical and be timed in the same run. With
+*         RequireGoldenHash the job also fails while no GoldenHash is set; the test job
+*         options turn it on and keep the reference hash in goldenHash.txt.
+*
+*         If GoldenOutputFile is set a golden record (ObfGoldenRecord.h) is written for
+*         every event, for comparison with obfGoldenDiff.
+*
 * @author Tracy Usher
 *
 * $Header: /nfs/slac/g/glast/ground/cvs/GlastRelease-scons/OnboardFilter/src/test/test_OnboardFilter.cxx,v 1.3.290.1 2010/10/08 16:39:13 heather Exp $
@@ -33,9 +56,37 @@ public:
     StatusCode finalize();
     
 private: 
+    /// Fold a 32 bit word into the rolling hash
+    void hashWord(unsigned int word);
+    /// Fold one filter's results into the hash, optionally log them
+    void processStatus(MsgStream& log, const std::string& label, unsigned int key, int slot,
+                       const OnboardFilterTds::IObfStatus* tdsStatus);
+
     //! number of times called
     int m_count; 
     //! the GlastDetSvc used for access to detector info
+
+    /// Expected hash (hex string), empty means do not check
+    StringProperty     m_goldenHash;
+    /// Fail if there is no expected hash
+    BooleanProperty    m_requireGoldenHash;
+    /// Log the status word/summary byte of every filter for every event
+    BooleanProperty    m_printStatus;
+    /// Golden record output file, empty means none
+    StringProperty     m_goldenFile;
+
+    /// Rolling hash of the filter results
+    unsigned long long m_hash;
+    /// Number of filter results folded in
+    unsigned long long m_nResults;
+
+    /// Timing from the first event on
+    long long          m_startWallNs;
+    long long          m_startCpuNs;
+
+    /// Golden record output
+    ObfGoldenWriter    m_goldenWriter;
+    ObfGoldenRecord    m_record;
 };
 //------------------------------------------------------------------------
 
@@ -52,7 +103,15 @@ test_OnboardFilter::test_OnboardFilter(const std::string& name,
                              ISvcLocator* pSvcLocator)
 :Algorithm(name, pSvcLocator)
 ,m_count(0)
+,m_hash(14695981039346656037ULL)
+,m_nResults(0)
+,m_startWallNs(0)
+,m_startCpuNs(0)
 {
+    declareProperty("GoldenHash",  m_goldenHash  = "");
+    declareProperty("RequireGoldenHash", m_requireGoldenHash = false);
+    declareProperty("PrintStatus", m_printStatus = false);
+    declareProperty("GoldenOutputFile", m_goldenFile = "");
 }
 
 //------------------------------------------------------------------------
@@ -61,6 +120,22 @@ StatusCode test_OnboardFilter::initialize(){
     StatusCode  sc = StatusCode::SUCCESS;
     MsgStream log(msgSvc(), name());
     log << MSG::INFO << "initialize" << endreq;
+
+    setProperties();
+
+    if (!m_goldenFile.value().empty())
+    {
+        std::string fileName = m_goldenFile.value();
+        facilities::Util::expandEnvVar(&fileName);
+
+        if (!m_goldenWriter.open(fileName))
+        {
+            log << MSG::ERROR << "Cannot open golden output file " << fileName << endreq;
+            return StatusCode::FAILURE;
+        }
+
+        log << MSG::INFO << "Writing golden records to " << fileName << endreq;
+    }
     
     return sc;
 }
@@ -87,47 +162,60 @@ StatusCode test_OnboardFilter::execute()
         return StatusCode::FAILURE;
     }
 
-    // Now step through and initialize the status objects one by one
-    const OnboardFilterTds::IObfStatus* tdsStatus = 0;
-
-    // We do this one by one explicitly for now. Start with the results of the gamma filter
-    if ((tdsStatus = obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::GammaFilter)))
+    // Start the clock on the first event so initialization is not counted
+    if (m_count == 1)
     {
-        unsigned int status  = tdsStatus->getStatusWord();
-        unsigned int summary = tdsStatus->getFiltersb();
-        log << MSG::INFO << "*** Gamma Filter ***" << endreq;
-        log << MSG::INFO << "    Status Word: " << std::hex << status << 
-                            ", Summary Byte: " << std::hex << summary << endreq;
+        m_startWallNs = ObfPerfMonitor::wallTimeNs();
+        m_startCpuNs  = ObfPerfMonitor::cpuTimeNs();
     }
 
-    // MIP Filter
-    if ((tdsStatus = obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::MIPFilter)))
+    // Mark the event boundary in the hash
+    hashWord(0xFFFFFFFF);
+
+    m_record.clear();
+
+    SmartDataPtr<Event::EventHeader> header(eventSvc(), EventModel::EventHeader);
+    if (header)
     {
-        unsigned int status  = tdsStatus->getStatusWord();
-        unsigned int summary = tdsStatus->getFiltersb();
-        log << MSG::INFO << "*** MIP Filter ***" << endreq;
-        log << MSG::INFO << "    Status Word: " << std::hex << status << 
-                            ", Summary Byte: " << std::hex << summary << endreq;
+        m_record.run     = header->run();
+        m_record.eventId = header->event();
     }
+    else m_record.eventId = m_count;
+
+    // We do this one by one explicitly for now. Start with the results of the gamma filter
+    processStatus(log, "Gamma", OnboardFilterTds::ObfFilterStatus::GammaFilter, ObfGoldenRecord::Gamma,
+                  obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::GammaFilter));
+
+    // MIP Filter
+    processStatus(log, "MIP", OnboardFilterTds::ObfFilterStatus::MIPFilter, ObfGoldenRecord::MIP,
+                  obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::MIPFilter));
 
     // HIP Filter
-    if ((tdsStatus = obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::HIPFilter)))
+    processStatus(log, "HIP", OnboardFilterTds::ObfFilterStatus::HIPFilter, ObfGoldenRecord::HIP,
+                  obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::HIPFilter));
+
+    // DGN Filter
+    processStatus(log, "DGN", OnboardFilterTds::ObfFilterStatus::DGNFilter, ObfGoldenRecord::DGN,
+                  obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::DGNFilter));
+
+    // The track found from the filter projections, if FilterTrack ran
+    SmartDataPtr<OnboardFilterTds::ObfFilterTrack> filterTrack(eventSvc(), "/Event/Filter/ObfFilterTrack");
+    if (filterTrack)
     {
-        unsigned int status  = tdsStatus->getStatusWord();
-        unsigned int summary = tdsStatus->getFiltersb();
-        log << MSG::INFO << "*** Gamma Filter ***" << endreq;
-        log << MSG::INFO << "    Status Word: " << std::hex << status << 
-                            ", Summary Byte: " << std::hex << summary << endreq;
+        m_record.present |= ObfGoldenRecord::TrackPresent;
+        m_record.nXhits   = filterTrack->get_nXhits();
+        m_record.nYhits   = filterTrack->get_nYhits();
+        m_record.xInt     = filterTrack->get_xInt();
+        m_record.yInt     = filterTrack->get_yInt();
+        m_record.zInt     = filterTrack->get_zInt();
+        m_record.slpXZ    = filterTrack->get_slpXZ();
+        m_record.slpYZ    = filterTrack->get_slpYZ();
     }
 
-    // DGN Filter
-    if ((tdsStatus = obfFilterStatus->getFilterStatus(OnboardFilterTds::ObfFilterStatus::DGNFilter)))
+    if (m_goldenWriter.isOpen() && !m_goldenWriter.write(m_record))
     {
-        unsigned int status  = tdsStatus->getStatusWord();
-        unsigned int summary = tdsStatus->getFiltersb();
-        log << MSG::INFO << "*** DGN Filter ***" << endreq;
-        log << MSG::INFO << "    Status Word: " << std::hex << status << 
-                            ", Summary Byte: " << std::hex << summary << endreq;
+        log << MSG::ERROR << "Error writing golden record" << endreq;
+        return StatusCode::FAILURE;
     }
     
     return sc;
@@ -139,9 +227,105 @@ StatusCode test_OnboardFilter::finalize(){
     StatusCode  sc = StatusCode::SUCCESS;
     MsgStream log(msgSvc(), name());
     //log  << MSG::INFO << m_count << " call(s)." << endreq;
+
+    // The clock starts after the first event, so it measures m_count - 1 events
+    double wallSec = 1.e-9 * (ObfPerfMonitor::wallTimeNs() - m_startWallNs);
+    double cpuNs   = static_cast<double>(ObfPerfMonitor::cpuTimeNs() - m_startCpuNs);
+    double nEvents = m_count > 1 ? static_cast<double>(m_count - 1) : 1.;
+
+    std::stringstream hashString;
+    hashString << std::hex << std::setw(16) << std::setfill('0') << m_hash;
+
+    log << MSG::INFO << m_count << " events, " << m_nResults << " filter results" << endreq;
+    log << MSG::INFO << "Result hash:   " << hashString.str() << endreq;
+    log << MSG::INFO << "Events/second: " << (wallSec > 0. ? nEvents / wallSec : 0.) << endreq;
+    log << MSG::INFO << "CPU ns/event:  " << cpuNs / nEvents << endreq;
+    log << MSG::INFO << "Peak RSS (kB): " << ObfPerfMonitor::peakRssKb() << endreq;
+
+    // Compare to the golden value if we have one
+    if (!m_goldenHash.value().empty())
+    {
+        unsigned long long golden = 0;
+        std::stringstream  goldenString(m_goldenHash.value());
+        goldenString >> std::hex >> golden;
+
+        if (golden != m_hash)
+        {
+            log << MSG::ERROR << "Result hash " << hashString.str() << " does not match golden hash " 
+                << m_goldenHash.value() << endreq;
+            sc = StatusCode::FAILURE;
+        }
+        else log << MSG::INFO << "Result hash matches golden hash" << endreq;
+    }
+    else if (m_requireGoldenHash.value())
+    {
+        log << MSG::ERROR << "No golden hash to compare result hash " << hashString.str()
+            << " with, record the hash of a reference run in goldenHash.txt" << endreq;
+        sc = StatusCode::FAILURE;
+    }
+
+    if (m_goldenWriter.isOpen())
+    {
+        log << MSG::INFO << "Wrote " << m_goldenWriter.getRecords() << " golden records" << endreq;
+        m_goldenWriter.close();
+    }
     
     return sc;
 }
 
+//------------------------------------------------------------------------
+//! FNV-1a, a byte at a time so the result does not depend on the platform
+void test_OnboardFilter::hashWord(unsigned int word)
+{
+    for(int byte = 0; byte < 4; byte++)
+    {
+        m_hash ^= (word >> (8 * byte)) & 0xFF;
+        m_hash *= 1099511628211ULL;
+    }
+}
+
+//------------------------------------------------------------------------
+void test_OnboardFilter::processStatus(MsgStream& log, const std::string& label, unsigned int key, int slot,
+                                       const OnboardFilterTds::IObfStatus* tdsStatus)
+{
+    // A filter which did not run still counts, so a filter dropping out changes the hash
+    hashWord(key);
+
+    if (!tdsStatus)
+    {
+        hashWord(0xDEADBEEF);
+        return;
+    }
+
+    unsigned int status  = tdsStatus->getStatusWord();
+    unsigned int summary = tdsStatus->getFiltersb();
+    unsigned int energy  = 0;
+
+    const OnboardFilterTds::ObfGammaStatus* gammaStatus = dynamic_cast<const OnboardFilterTds::ObfGammaStatus*>(tdsStatus);
+    if (gammaStatus) energy = static_cast<unsigned int>(gammaStatus->getEnergy());
+
+    hashWord(status);
+    hashWord(summary);
+    hashWord(energy);
+    m_nResults++;
+
+    m_record.present     |= 1 << slot;
+    m_record.status[slot] = status;
+    m_record.id[slot]     = static_cast<unsigned char>(tdsStatus->getFilterId());
+    m_record.sb[slot]     = static_cast<unsigned char>(summary);
+
+    // Accepted with no prescale, or rejected and the prescale flips it (as OnboardFilter::execute)
+    unsigned int decision = (summary & (EDS_RSD_SB_M_VETOED | EDS_RSD_SB_M_PRESCALE_OUT)) >> EDS_RSD_SB_V_PRESCALE_OUT;
+    if (decision == 0 || decision == 3) m_record.passed |= 1 << slot;
+    if (gammaStatus) m_record.gammaEnergy = energy;
+
+    if (m_printStatus)
+    {
+        log << MSG::INFO << "*** " << label << " Filter ***" << endreq;
+        log << MSG::INFO << "    Status Word: " << std::hex << status << 
+                            ", Summary Byte: " << std::hex << summary << std::dec << endreq;
+    }
+}
+
 
 
@@ -0,0 +1,555 @@
+/**  @file test_ObfUnits.cxx
+    @brief Unit checks of the OnboardFilter parts with no Gaudi or FSW dependence
+
+    Runs each check in turn, prints the ones which fail and exits with the number of
+    failures. Files are written in the directory given as the first argument, default
+    the current one.
+
+  $Header$
+*/
+
+#include "../../ObfDecisionEngine.h"
+#include "../../ObfAdaptiveOrder.h"
+#include "../../ObfGemPreVeto.h"
+#include "../../ObfResultCache.h"
+#include "../../ObfSampler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <sys/stat.h>
+#include <utime.h>
+
+namespace
+{
+    int s_checks   = 0;
+    int s_failures = 0;
+
+    void check(bool ok, const char* what, const char* file, int line)
+    {
+        s_checks++;
+
+        if (ok) return;
+
+        s_failures++;
+        std::cout << file << ":" << line << ": failed: " << what << std::endl;
+    }
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+    enum {Gamma = 0, HIP = 1, MIP = 2, DGN = 3};
+
+    std::vector<std::string> filterNames()
+    {
+        std::vector<std::string> names;
+
+        names.push_back("Gamma");
+        names.push_back("HIP");
+        names.push_back("MIP");
+        names.push_back("DGN");
+
+        return names;
+    }
+
+    unsigned int passing(int slot, bool pass)
+    {
+        return ObfDecisionEngine::filterBits(slot, true, pass, false, false);
+    }
+
+    void testDecisionEngine()
+    {
+        ObfDecisionEngine engine;
+        std::string       error;
+
+        CHECK(engine.compile("Gamma | (HIP & !DGN)", filterNames(), error));
+        CHECK(engine.nVariables() == 3);
+        CHECK(engine.usesFilter(Gamma) && engine.usesFilter(HIP) && !engine.usesFilter(MIP));
+
+        // Every assignment of the three filters against the expression itself
+        for(int idx = 0; idx < 8; idx++)
+        {
+            bool gamma = idx & 1, hip = idx & 2, dgn = idx & 4;
+
+            unsigned int inputs = passing(Gamma, gamma) | passing(HIP, hip) | passing(DGN, dgn);
+
+            CHECK(engine.accept(inputs) == (gamma || (hip && !dgn)));
+        }
+
+        // Condition keywords and case
+        CHECK(engine.compile("not gamma.vetoed AND hip.RAN", filterNames(), error));
+        CHECK(engine.accept(ObfDecisionEngine::filterBits(HIP, true, false, false, false)));
+        CHECK(!engine.accept(ObfDecisionEngine::filterBits(Gamma, true, false, true, false)
+                           | ObfDecisionEngine::filterBits(HIP,   true, false, false, false)));
+
+        // Batch decisions match single ones
+        CHECK(engine.compile("MIP | DGN", filterNames(), error));
+        unsigned int inputs[4]    = {0, passing(MIP, true), passing(DGN, true), passing(MIP, false) | passing(DGN, false)};
+        bool         decisions[4];
+        engine.accept(inputs, 4, decisions);
+        for(int idx = 0; idx < 4; idx++) CHECK(decisions[idx] == engine.accept(inputs[idx]));
+
+        // Errors
+        CHECK(!engine.compile("Gamma |", filterNames(), error));
+        CHECK(!engine.compile("Gamma & LPF", filterNames(), error));
+        CHECK(!engine.compile("(Gamma", filterNames(), error));
+
+        // An empty expression rejects everything
+        CHECK(engine.compile("", filterNames(), error));
+        CHECK(!engine.accept(passing(Gamma, true)));
+    }
+
+    void testDecidedBy()
+    {
+        ObfDecisionEngine engine;
+        std::string       error;
+        bool              decision = false;
+
+        CHECK(engine.compile("Gamma | (HIP & !DGN)", filterNames(), error));
+
+        // Gamma passing settles it, failing does not
+        CHECK(engine.decidedBy(1 << Gamma, passing(Gamma, true), decision) && decision);
+        CHECK(!engine.decidedBy(1 << Gamma, passing(Gamma, false), decision));
+
+        // Then a failing HIP settles it as a reject, a passing one still needs DGN
+        CHECK(engine.decidedBy(1 << Gamma | 1 << HIP, passing(Gamma, false) | passing(HIP, false), decision) && !decision);
+        CHECK(!engine.decidedBy(1 << Gamma | 1 << HIP, passing(Gamma, false) | passing(HIP, true), decision));
+
+        // Filters the expression does not use settle nothing, the bits of others are ignored
+        CHECK(!engine.decidedBy(1 << MIP, passing(MIP, true), decision));
+        CHECK(engine.decidedBy(1 << Gamma, passing(Gamma, true) | passing(HIP, false), decision) && decision);
+
+        // All filters known always decides, as accept does
+        unsigned int all = 1 << Gamma | 1 << HIP | 1 << MIP | 1 << DGN;
+        for(int idx = 0; idx < 8; idx++)
+        {
+            unsigned int inputs = passing(Gamma, idx & 1) | passing(HIP, idx & 2) | passing(DGN, idx & 4);
+
+            CHECK(engine.decidedBy(all, inputs, decision) && decision == engine.accept(inputs));
+        }
+    }
+
+    void testAdaptiveOrder()
+    {
+        ObfAdaptiveOrder order(3, 2);
+
+        CHECK(order.enabled());
+        CHECK(order.order().size() == 3 && order.order()[0] == 0 && order.order()[2] == 2);
+
+        // The first event is a full one, measuring the filters
+        CHECK(order.startEvent());
+        order.addRun(0, 1000);
+        order.addRun(1, 100);
+        order.addRun(2, 500);
+        order.addFullEvent(1 << 0 | 1 << 2, true);
+
+        // Filter 1 is cheapest but never decisive, so it goes last; 2 is cheaper than 0
+        CHECK(order.order()[0] == 2 && order.order()[1] == 0 && order.order()[2] == 1);
+        CHECK(order.decisive(1) == 0. && order.decisive(2) == 1.);
+        CHECK(order.costNs(0) == 1000.);
+
+        // Then every second event
+        CHECK(!order.startEvent());
+        order.addRun(2, 500);
+        order.addSkipped(0);
+        order.addSkipped(1);
+        CHECK(order.runs(2) == 2 && order.skipped(0) == 1);
+        CHECK(order.startEvent());
+        CHECK(order.fullEvents() == 2);
+
+        // Stopping early changing a decision goes back to full events for good
+        order.addFullEvent(1 << 2, false);
+        CHECK(!order.enabled() && order.mismatches() == 1 && order.reason() != "");
+        CHECK(order.startEvent() && order.startEvent());
+        CHECK(order.fullEvents() == 2);
+
+        // Left out filters are never ordered
+        order.leaveOut(0);
+        CHECK(!order.ordered(0) && order.ordered(1) && order.order().size() == 2);
+
+        // No verification means no adaptive ordering
+        ObfAdaptiveOrder fixed(2, 0);
+        CHECK(!fixed.enabled() && fixed.reason() == "fixed order");
+        CHECK(fixed.startEvent());
+    }
+
+    void testGemPreVeto()
+    {
+        unsigned long long quiet = ObfGemPreVeto::key(0x10, 0,      0,          false);
+        unsigned long long busy  = ObfGemPreVeto::key(0x10, 0x0003, 0x00010000, true);
+
+        CHECK(quiet != busy);
+        CHECK(ObfGemPreVeto::key(0x10, 0x1, 0, false) == ObfGemPreVeto::key(0x10, 0x8000, 0, false));
+
+        // Checked (lossless) mode: once trained, every firing is a check
+        ObfGemPreVeto checked(3);
+        CHECK(!checked.lossy());
+        for(int idx = 0; idx < 3; idx++)
+        {
+            CHECK(checked.decide(quiet) == ObfGemPreVeto::Open);
+            checked.addDecision(quiet, false, ObfGemPreVeto::Open);
+        }
+        CHECK(checked.active() == 1);
+        for(int idx = 0; idx < 5; idx++)
+        {
+            CHECK(checked.decide(quiet) == ObfGemPreVeto::Check);
+            checked.addDecision(quiet, false, ObfGemPreVeto::Check);
+        }
+        CHECK(checked.active() == 1 && checked.disagreed() == 0);
+        CHECK(checked.accepted() == 0 && checked.rejected() == 0 && checked.checked() == 5);
+
+        // A signature seen with both decisions never gets a rule
+        checked.addDecision(busy, true,  ObfGemPreVeto::Open);
+        checked.addDecision(busy, false, ObfGemPreVeto::Open);
+        checked.addDecision(busy, true,  ObfGemPreVeto::Open);
+        CHECK(checked.decide(busy) == ObfGemPreVeto::Open);
+        CHECK(checked.signatures() == 2 && checked.active() == 1);
+
+        // Lossy mode: checks the first firing and every third after it
+        ObfGemPreVeto lossy(3, 3);
+        CHECK(lossy.lossy());
+        for(int idx = 0; idx < 3; idx++) lossy.addDecision(quiet, false, ObfGemPreVeto::Open);
+
+        CHECK(lossy.decide(quiet) == ObfGemPreVeto::Check);
+        lossy.addDecision(quiet, false, ObfGemPreVeto::Check);
+        CHECK(lossy.decide(quiet) == ObfGemPreVeto::Reject);
+        CHECK(lossy.decide(quiet) == ObfGemPreVeto::Reject);
+        CHECK(lossy.decide(quiet) == ObfGemPreVeto::Check);
+        CHECK(lossy.rejected() == 2);
+
+        // A check that disagrees retires the rule for good
+        lossy.addDecision(quiet, true, ObfGemPreVeto::Check);
+        CHECK(lossy.disagreed() == 1 && lossy.retired() == 1 && lossy.active() == 0);
+        CHECK(lossy.decide(quiet) == ObfGemPreVeto::Open);
+
+        // Disabled, nothing is decided
+        lossy.disable("test");
+        CHECK(!lossy.enabled() && lossy.reason() == "test");
+        CHECK(lossy.decide(busy) == ObfGemPreVeto::Open);
+    }
+
+    ObfGoldenRecord result(unsigned int gammaStatus, unsigned char gammaSb)
+    {
+        ObfGoldenRecord record;
+
+        record.present                        = 1 << ObfGoldenRecord::Gamma | ObfGoldenRecord::TrackPresent;
+        record.status[ObfGoldenRecord::Gamma] = gammaStatus;
+        record.sb[ObfGoldenRecord::Gamma]     = gammaSb;
+        record.gammaEnergy                    = 1234;
+        record.nXhits                         = 5;
+        record.slpXZ                          = 0.25;
+        record.run                            = 77;
+        record.eventId                        = 88;
+
+        return record;
+    }
+
+    void testResultCache(const std::string& directory)
+    {
+        const std::string fingerprint = "test_ObfUnits release\nlibGamma.so 1000 1";
+        const std::string fileName    = ObfResultCache::fileName(directory, fingerprint);
+
+        remove(fileName.c_str());
+
+        char event1[] = "event one, some EBF bytes";
+        char event2[] = "event two, other EBF bytes";
+
+        ObfResultCache::Key key1 = ObfResultCache::key(event1, sizeof(event1), 0);
+        ObfResultCache::Key key2 = ObfResultCache::key(event2, sizeof(event2), 0);
+
+        // Same bytes in another mode is another event
+        CHECK(key1 < ObfResultCache::key(event1, sizeof(event1), 1) || ObfResultCache::key(event1, sizeof(event1), 1) < key1);
+
+        std::string     error;
+        ObfGoldenRecord record;
+
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+            CHECK(cache.entries() == 0);
+            CHECK(!cache.find(key1, record));
+            CHECK(cache.store(key1, result(0x1234, 0x2)));
+            CHECK(cache.store(key2, result(0x5678, 0x0)));
+            CHECK(cache.find(key1, record) && record.status[ObfGoldenRecord::Gamma] == 0x1234);
+            CHECK(cache.hits() == 1 && cache.misses() == 1 && cache.stored() == 2);
+        }
+
+        // Read back from the file, without the event identity
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+            CHECK(cache.entries() == 2);
+            CHECK(cache.find(key2, record));
+            CHECK(record.status[ObfGoldenRecord::Gamma] == 0x5678 && record.gammaEnergy == 1234);
+            CHECK(record.nXhits == 5 && record.slpXZ == 0.25f && (record.present & ObfGoldenRecord::TrackPresent));
+            CHECK(record.run == 0 && record.eventId == 0);
+        }
+
+        // A job dying part way through an entry leaves a partial one, which is dropped
+        if (FILE* file = fopen(fileName.c_str(), "ab"))
+        {
+            fwrite("partial", 7, 1, file);
+            fclose(file);
+        }
+
+        char event3[] = "event three";
+        ObfResultCache::Key key3 = ObfResultCache::key(event3, sizeof(event3), 0);
+
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+            CHECK(cache.entries() == 2);
+            CHECK(cache.store(key3, result(0x9, 0x1)));
+        }
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+            CHECK(cache.entries() == 3);
+            CHECK(cache.find(key3, record) && record.status[ObfGoldenRecord::Gamma] == 0x9);
+            CHECK(cache.find(key1, record) && record.sb[ObfGoldenRecord::Gamma] == 0x2);
+        }
+
+        // Another setup has a file of its own, which starts empty
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint + " changed", error));
+            CHECK(cache.fileName() != fileName);
+            CHECK(cache.entries() == 0 && !cache.find(key1, record));
+
+            remove(cache.fileName().c_str());
+        }
+
+        // A file which is not a cache is refused
+        {
+            if (FILE* file = fopen(fileName.c_str(), "wb"))
+            {
+                fwrite("not a result cache at all", 25, 1, file);
+                fclose(file);
+            }
+
+            ObfResultCache cache;
+
+            CHECK(!cache.open(directory, fingerprint, error) && error != "");
+        }
+
+        remove(fileName.c_str());
+    }
+
+    void writeFile(const std::string& fileName, const char* contents)
+    {
+        if (FILE* file = fopen(fileName.c_str(), "wb"))
+        {
+            fwrite(contents, strlen(contents), 1, file);
+            fclose(file);
+        }
+    }
+
+    void testLibraryChange(const std::string& directory)
+    {
+        const std::string library = directory + "/libtest_ObfUnits.so";
+
+        writeFile(library, "filter code, first build");
+
+        struct stat before;
+        stat(library.c_str(), &before);
+
+        std::string print1 = ObfResultCache::fileFingerprint(library);
+
+        CHECK(print1 != "");
+        CHECK(ObfResultCache::fileFingerprint(library) == print1);
+        CHECK(ObfResultCache::fileFingerprint(directory + "/noSuchLibrary.so") == "");
+
+        char                event[] = "an event";
+        ObfResultCache::Key key     = ObfResultCache::key(event, sizeof(event), 0);
+        std::string         error;
+        ObfGoldenRecord     record;
+
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, "release\n" + print1, error));
+            CHECK(cache.store(key, result(0x42, 0x2)));
+        }
+
+        // Rebuilt with the same name, size and (put back) modification time
+        writeFile(library, "filter code, other build");
+
+        struct utimbuf times;
+        times.actime  = before.st_atime;
+        times.modtime = before.st_mtime;
+        utime(library.c_str(), &times);
+
+        std::string print2 = ObfResultCache::fileFingerprint(library);
+
+        CHECK(print2 != "" && print2 != print1);
+
+        // Gives a fresh cache, the results of the old build are not read
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, "release\n" + print2, error));
+            CHECK(cache.entries() == 0 && !cache.find(key, record));
+
+            remove(cache.fileName().c_str());
+        }
+
+        // While the old build still finds them
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, "release\n" + print1, error));
+            CHECK(cache.find(key, record) && record.status[ObfGoldenRecord::Gamma] == 0x42);
+
+            remove(cache.fileName().c_str());
+        }
+
+        remove(library.c_str());
+    }
+
+    void testMixedSequence(const std::string& directory)
+    {
+        const std::string fingerprint = "test_ObfUnits mixed\nlibGamma.so 1000 1";
+
+        // Ten events, each with its own result, the even ones run by an earlier job
+        std::vector<ObfResultCache::Key> keys;
+        char                             event[32];
+
+        for(int idx = 0; idx < 10; idx++)
+        {
+            sprintf(event, "mixed event %d", idx);
+            keys.push_back(ObfResultCache::key(event, strlen(event), 0));
+        }
+
+        std::string     error;
+        ObfGoldenRecord record;
+
+        remove(ObfResultCache::fileName(directory, fingerprint).c_str());
+
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+            for(int idx = 0; idx < 10; idx += 2) CHECK(cache.store(keys[idx], result(0x100 + idx, idx & 0x3)));
+        }
+
+        // The whole sequence, in order: hits give each event its own result, misses are filtered and stored
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+
+            bool hitsRight = true, missesRight = true;
+
+            for(int idx = 0; idx < 10; idx++)
+            {
+                if (cache.find(keys[idx], record))
+                {
+                    if (idx % 2 || record.status[ObfGoldenRecord::Gamma] != (unsigned int)(0x100 + idx)
+                                || record.sb[ObfGoldenRecord::Gamma] != (idx & 0x3)) hitsRight = false;
+                }
+                else
+                {
+                    if (idx % 2 == 0 || !cache.store(keys[idx], result(0x100 + idx, idx & 0x3))) missesRight = false;
+                }
+            }
+
+            CHECK(hitsRight && missesRight);
+            CHECK(cache.hits() == 5 && cache.misses() == 5 && cache.stored() == 5 && cache.entries() == 10);
+
+            // An event repeated after it missed is now a hit
+            CHECK(cache.find(keys[3], record) && record.status[ObfGoldenRecord::Gamma] == 0x103);
+        }
+
+        // The next job hits on every event
+        {
+            ObfResultCache cache;
+
+            CHECK(cache.open(directory, fingerprint, error));
+
+            bool allRight = true;
+
+            for(int idx = 0; idx < 10; idx++)
+            {
+                if (!cache.find(keys[idx], record) || record.status[ObfGoldenRecord::Gamma] != (unsigned int)(0x100 + idx)) allRight = false;
+            }
+
+            CHECK(allRight && cache.hits() == 10 && cache.misses() == 0);
+
+            remove(cache.fileName().c_str());
+        }
+    }
+
+    void testSampler()
+    {
+        // Selections at rates which are multiples of each other nest
+        int nested = 0, at10 = 0, at100 = 0;
+
+        for(unsigned long long event = 0; event < 100000; event++)
+        {
+            bool sel10  = ObfSampler::selected(7, event, 10);
+            bool sel100 = ObfSampler::selected(7, event, 100);
+
+            if (sel10)           at10++;
+            if (sel100)          at100++;
+            if (sel100 && sel10) nested++;
+        }
+
+        CHECK(nested == at100);
+        CHECK(at10 > 9000 && at10 < 11000);
+        CHECK(at100 > 800 && at100 < 1200);
+
+        // Throttling selects a subset of what was selected before, fixed samplers ignore it
+        ObfSampler sampler("test", 4);
+        ObfSampler throttled("test", 4);
+        ObfSampler fixed("test", 4);
+
+        throttled.setThrottle(4);
+        fixed.setFixed(true);
+        fixed.setThrottle(4);
+
+        CHECK(throttled.effectiveRate() == 16 && fixed.effectiveRate() == 4);
+
+        bool subset = true, same = true;
+
+        for(unsigned long long event = 0; event < 10000; event++)
+        {
+            bool selected = sampler.select(3, event);
+
+            if (throttled.select(3, event) && !selected) subset = false;
+            if (fixed.select(3, event) != selected)      same   = false;
+        }
+
+        CHECK(subset && same);
+
+        CHECK(sampler.seen() == 10000 && throttled.nSelected() < sampler.nSelected());
+        CHECK(sampler.weight() > 3. && sampler.weight() < 5.);
+
+        // Rate 1 selects everything
+        CHECK(ObfSampler::selected(1, 12345, 1) && ObfSampler("all").select(1, 1));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string directory = argc > 1 ? argv[1] : ".";
+
+    testDecisionEngine();
+    testDecidedBy();
+    testAdaptiveOrder();
+    testGemPreVeto();
+    testResultCache(directory);
+    testLibraryChange(directory);
+    testMixedSequence(directory);
+    testSampler();
+
+    std::cout << "test_ObfUnits: " << s_checks << " checks, " << s_failures << " failed" << std::endl;
+
+    return s_failures;
+}